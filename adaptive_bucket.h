@@ -0,0 +1,224 @@
+#ifndef ADAPTIVE_BUCKET_H
+#define ADAPTIVE_BUCKET_H
+
+#include <cstdlib>
+#include <cassert>
+#include <algorithm>
+#include "bst_functions.h"
+
+using namespace std;
+
+//A hash table bucket that holds up to INLINE_CAPACITY records in an unsorted inline array,
+// and only promotes to an AVL tree (drawn from the table's shared pool) once it overflows.
+// The keys of the inline records are kept in their own array so a lookup scans one short,
+// contiguous run of ints. A tree that shrinks below INLINE_CAPACITY is demoted back to the
+// array, so the tree is only kept for buckets flooded by colliding keys.
+template <typename T, size_t INLINE_CAPACITY = 3>
+class AdaptiveBucket
+{
+public:
+    typedef tree_pool<T> pool_type;
+
+    //every byte outside the inline array lives in the pool, so the table may release the pool in bulk.
+    static const bool BULK_RELEASE = true;
+
+    AdaptiveBucket(): _count(0), _root(nullptr) {}
+
+    bool insert(const T& entry, pool_type& pool);   //returns true if the record inserted, otherwise false.
+    bool erase(int key, pool_type& pool);           //returns true if the record with the key was removed.
+    T* search(int key, pool_type& pool);            //returns the record with the key, or null.
+    void clear(pool_type& pool);                    //remove every record, the bucket becomes an empty array.
+    void copy(const AdaptiveBucket<T, INLINE_CAPACITY>& from, const pool_type& fromPool, pool_type& pool); //this bucket must be empty.
+    size_t flatten(T* out, const pool_type& pool) const; //copy the records to out, returns the count.
+    void print(ostream& outs, const pool_type& pool) const; //print the records.
+
+    //preconditions: none
+    //postconditions: returns the number of records in the bucket.
+    inline size_t size() const
+    {
+        return (_root) ? _root->_size : _count;
+    }
+
+    //preconditions: none
+    //postconditions: returns true if the bucket holds no record.
+    inline bool empty() const
+    {
+        return size() == 0;
+    }
+
+    //preconditions: none
+    //postconditions: returns true if the records are stored in an AVL tree.
+    inline bool promoted() const
+    {
+        return _root != nullptr;
+    }
+
+    //preconditions: none
+    //postconditions: returns the root of the AVL tree once promoted, so a batched lookup can walk
+    // it a node at a time, otherwise null and the inline array is searched whole.
+    inline tree_node<T>* tree() const
+    {
+        return _root;
+    }
+
+private:
+    int _keys[INLINE_CAPACITY];     //_keys[i] is the key of _items[i], scanned on lookup.
+    size_t _count;                  //number of inline records, 0 once promoted.
+    tree_node<T>* _root;            //root of the AVL tree once promoted, otherwise null.
+    T _items[INLINE_CAPACITY];
+
+    void promote(pool_type& pool);
+    void demote(pool_type& pool);
+
+    //preconditions: the bucket is not promoted.
+    //postconditions: returns the position of the key in the inline array, or _count if it is not there.
+    inline size_t find_inline(int key) const
+    {
+        size_t i = 0;
+        while(i < _count && _keys[i] != key)
+            i++;
+        return i;
+    }
+};
+
+//preconditions: none
+//postconditions: the entry is appended to the inline array, if the array is full the bucket
+// is promoted to an AVL tree first. Returns false if the key is already in the bucket.
+template <typename T, size_t INLINE_CAPACITY>
+bool AdaptiveBucket<T, INLINE_CAPACITY>::insert(const T& entry, pool_type& pool)
+{
+    if(!_root)
+    {
+        if(find_inline(entry.key) < _count)
+            return false;
+
+        if(_count < INLINE_CAPACITY)
+        {
+            _keys[_count] = entry.key;
+            _items[_count] = entry;
+            _count++;
+            return true;
+        }
+
+        promote(pool);
+    }
+
+    return tree_insert(_root, entry, true, &pool);
+}
+
+//preconditions: none
+//postconditions: the record with the key is removed, an inline record is replaced by the last
+// inline record. A tree that drops below INLINE_CAPACITY records is demoted.
+template <typename T, size_t INLINE_CAPACITY>
+bool AdaptiveBucket<T, INLINE_CAPACITY>::erase(int key, pool_type& pool)
+{
+    if(_root)
+    {
+        if(!tree_erase(_root, T(key), true, &pool))
+            return false;
+
+        if(_root && _root->_size < INLINE_CAPACITY)
+            demote(pool);
+        return true;
+    }
+
+    size_t i = find_inline(key);
+    if(i == _count)
+        return false;
+
+    _count--;
+    _keys[i] = _keys[_count];
+    _items[i] = _items[_count];
+    return true;
+}
+
+//preconditions: none
+//postconditions: returns a pointer to the record with the key, or null if it is not in the bucket.
+template <typename T, size_t INLINE_CAPACITY>
+T* AdaptiveBucket<T, INLINE_CAPACITY>::search(int key, pool_type&)
+{
+    if(_root)
+    {
+        tree_node<T>* found_ptr = tree_search(_root, T(key));
+        return (found_ptr) ? &found_ptr->_item : nullptr;
+    }
+
+    size_t i = find_inline(key);
+    return (i < _count) ? &_items[i] : nullptr;
+}
+
+//preconditions: none
+//postconditions: the tree (if any) is returned to the pool, the bucket is an empty array.
+template <typename T, size_t INLINE_CAPACITY>
+void AdaptiveBucket<T, INLINE_CAPACITY>::clear(pool_type& pool)
+{
+    tree_clear(_root, &pool);
+    _count = 0;
+}
+
+//preconditions: this bucket is empty.
+//postconditions: this bucket holds a copy of from, tree nodes are drawn from pool.
+template <typename T, size_t INLINE_CAPACITY>
+void AdaptiveBucket<T, INLINE_CAPACITY>::copy(const AdaptiveBucket<T, INLINE_CAPACITY>& from, const pool_type&, pool_type& pool)
+{
+    assert(size() == 0);
+    _count = from._count;
+    for(size_t i = 0; i < _count; i++)
+    {
+        _keys[i] = from._keys[i];
+        _items[i] = from._items[i];
+    }
+    _root = tree_copy(from._root, &pool);
+}
+
+//preconditions: out has room for size() records.
+//postconditions: the records are copied to out (in key order once promoted), the count is returned.
+template <typename T, size_t INLINE_CAPACITY>
+size_t AdaptiveBucket<T, INLINE_CAPACITY>::flatten(T* out, const pool_type&) const
+{
+    if(_root)
+        return tree_flatten(_root, out);
+
+    for(size_t i = 0; i < _count; i++)
+        out[i] = _items[i];
+    return _count;
+}
+
+//preconditions: none
+//postconditions: a tree is printed with tree_print, inline records are printed one per line.
+template <typename T, size_t INLINE_CAPACITY>
+void AdaptiveBucket<T, INLINE_CAPACITY>::print(ostream& outs, const pool_type&) const
+{
+    if(_root)
+    {
+        tree_print(_root, 0, outs);
+    }
+    else
+    {
+        for(size_t i = 0; i < _count; i++)
+            outs << "|" << _items[i] << "|" << endl;
+    }
+}
+
+//preconditions: the bucket is not promoted.
+//postconditions: the inline records are sorted and moved into a balanced AVL tree.
+template <typename T, size_t INLINE_CAPACITY>
+void AdaptiveBucket<T, INLINE_CAPACITY>::promote(pool_type& pool)
+{
+    sort(_items, _items + _count);
+    _root = tree_from_sorted_list(_items, int(_count), &pool);
+    _count = 0;
+}
+
+//preconditions: the bucket is promoted and holds less than INLINE_CAPACITY records.
+//postconditions: the records are moved back into the inline array, the tree is returned to the pool.
+template <typename T, size_t INLINE_CAPACITY>
+void AdaptiveBucket<T, INLINE_CAPACITY>::demote(pool_type& pool)
+{
+    _count = tree_flatten(_root, _items);
+    for(size_t i = 0; i < _count; i++)
+        _keys[i] = _items[i].key;
+    tree_clear(_root, &pool);
+}
+
+#endif // ADAPTIVE_BUCKET_H
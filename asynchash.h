@@ -0,0 +1,311 @@
+#ifndef ASYNCHASH_H
+#define ASYNCHASH_H
+
+#include <cstdlib>
+#include <cstdint>
+#include <cassert>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <record.h>
+#include "doublehash.h"
+
+using namespace std;
+
+//A table behind a queue of operations that one worker thread runs in batches. Any thread may
+// submit an insert, remove or find and get its result through a callback or a future. The worker
+// takes every operation queued so far with one lock, groups the batch by the region of the table
+// holding the home slot (or bucket) of each key, runs it against the table region by region and
+// then calls back in the order the operations were submitted.
+// Operations on the same key share a home, and the grouping is stable, so they always run in the
+// order they were submitted. Operations on different keys may run in another order, which only
+// changes a result when an insert fails on a full table or a cache evicts. So a batch whose
+// inserts exceed the room the table has left runs in submission order. Every result is therefore
+// the one running the operations one at a time in submission order gives. Table is OpenHash,
+// DoubleHash or ChainedHash, anything with insert, remove, find, home(key) and room().
+template <typename T, typename Table = DoubleHash<T> >
+class AsyncHash
+{
+public:
+    //called with the result of the operation (and the record found by a find) on the worker thread.
+    typedef function<void(bool ok, const T& record)> callback;
+
+    AsyncHash(size_t capacity);                         //start the worker over a table of capacity.
+    ~AsyncHash();                                       //run every operation submitted, then stop the worker.
+
+    //the worker owns the table.
+    AsyncHash(const AsyncHash<T, Table>&) = delete;
+    AsyncHash<T, Table>& operator=(const AsyncHash<T, Table>&) = delete;
+
+    void insert(const T& entry, callback done);         //done(inserted, entry) once the record is inserted.
+    void remove(int key, callback done);                //done(removed, record with key) once the key is removed.
+    void find(int key, callback done);                  //done(found, result) once the key is searched for.
+    future<bool> insert(const T& entry);                //a future of the result of insert.
+    future<bool> remove(int key);                       //a future of the result of remove.
+    future<pair<bool, T> > find(int key);               //a future of found and the record.
+    void drain();                                       //wait until every operation submitted has run.
+    size_t size() const;                                //the records of the table, after drain.
+
+    //preconditions: none
+    //postconditions: returns the number of batches the worker has run.
+    inline size_t batches() const
+    {
+        lock_guard<mutex> guard(_mutex);
+        return _batches;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of operations the worker has run.
+    inline size_t completed() const
+    {
+        lock_guard<mutex> guard(_mutex);
+        return _completed;
+    }
+
+private:
+    static const int INSERT = 1;
+    static const int REMOVE = 2;
+    static const int FIND = 3;
+    static const size_t MIN_REGION = 64;    //the fewest slots (or buckets) a group of a batch spans.
+
+    struct operation
+    {
+        int op;
+        T record;           //only the key is used by REMOVE and FIND.
+        callback done;
+    };
+
+    Table _table;               //only touched by the worker.
+    mutable mutex _mutex;       //guards the queue and the counters.
+    condition_variable _queued; //signals the worker that the queue is not empty, or to stop.
+    condition_variable _ran;    //signals drain that a batch has run.
+    vector<operation> _queue;
+    size_t _submitted;
+    size_t _completed;
+    size_t _batches;
+    bool _stop;
+    thread _worker;
+
+    vector<size_t> _group;      //the group of every operation of the batch being run.
+    vector<size_t> _start;      //where every group begins in _order.
+    vector<size_t> _order;      //the batch positions in the order they run.
+    vector<char> _results;      //the result of every operation of the batch.
+
+    void submit(int op, const T& record, callback done);   //queue an operation and wake the worker.
+    void work();                                            //the loop of the worker.
+    void run(vector<operation>& batch);                     //run a batch region by region, then call back.
+};
+
+//preconditions: capacity is valid for Table.
+//postconditions: the table is empty and the worker waits for operations.
+template <typename T, typename Table>
+AsyncHash<T, Table>::AsyncHash(size_t capacity): _table(capacity)
+{
+    _submitted = 0;
+    _completed = 0;
+    _batches = 0;
+    _stop = false;
+    _worker = thread(&AsyncHash<T, Table>::work, this);
+}
+
+//preconditions: no thread submits any more operations.
+//postconditions: the operations still queued are run and called back, the worker stops.
+template <typename T, typename Table>
+AsyncHash<T, Table>::~AsyncHash()
+{
+    {
+        lock_guard<mutex> guard(_mutex);
+        _stop = true;
+    }
+    _queued.notify_one();
+    _worker.join();
+}
+
+//preconditions: none
+//postconditions: the insert is queued, done is called with its result once the worker runs it.
+template <typename T, typename Table>
+void AsyncHash<T, Table>::insert(const T& entry, callback done)
+{
+    submit(INSERT, entry, move(done));
+}
+
+//preconditions: key must be a non-negative integer.
+//postconditions: the remove is queued, done is called with its result once the worker runs it.
+template <typename T, typename Table>
+void AsyncHash<T, Table>::remove(int key, callback done)
+{
+    assert(key >= 0);
+    T record;
+    record.key = key;
+    submit(REMOVE, record, move(done));
+}
+
+//preconditions: none
+//postconditions: the find is queued, done is called with found and the record once the worker runs it.
+template <typename T, typename Table>
+void AsyncHash<T, Table>::find(int key, callback done)
+{
+    T record;
+    record.key = key;
+    submit(FIND, record, move(done));
+}
+
+//preconditions: none
+//postconditions: the insert is queued, the future holds true once the record was inserted.
+template <typename T, typename Table>
+future<bool> AsyncHash<T, Table>::insert(const T& entry)
+{
+    shared_ptr<promise<bool> > result = make_shared<promise<bool> >();
+    insert(entry, [result](bool ok, const T&) { result->set_value(ok); });
+    return result->get_future();
+}
+
+//preconditions: key must be a non-negative integer.
+//postconditions: the remove is queued, the future holds true once the key was removed.
+template <typename T, typename Table>
+future<bool> AsyncHash<T, Table>::remove(int key)
+{
+    shared_ptr<promise<bool> > result = make_shared<promise<bool> >();
+    remove(key, [result](bool ok, const T&) { result->set_value(ok); });
+    return result->get_future();
+}
+
+//preconditions: none
+//postconditions: the find is queued, the future holds found and the record once it has run.
+template <typename T, typename Table>
+future<pair<bool, T> > AsyncHash<T, Table>::find(int key)
+{
+    shared_ptr<promise<pair<bool, T> > > result = make_shared<promise<pair<bool, T> > >();
+    find(key, [result](bool ok, const T& record) { result->set_value(make_pair(ok, record)); });
+    return result->get_future();
+}
+
+//preconditions: not called from a callback.
+//postconditions: returns once every operation submitted before the call has run and been called back.
+template <typename T, typename Table>
+void AsyncHash<T, Table>::drain()
+{
+    unique_lock<mutex> lock(_mutex);
+    size_t target = _submitted;
+    _ran.wait(lock, [this, target]() { return _completed >= target; });
+}
+
+//preconditions: drain returned after the last operation was submitted.
+//postconditions: returns the number of records in the table.
+template <typename T, typename Table>
+size_t AsyncHash<T, Table>::size() const
+{
+    lock_guard<mutex> guard(_mutex);
+    assert(_completed == _submitted);
+    return _table.size();
+}
+
+//preconditions: none
+//postconditions: the operation is at the back of the queue, the worker is woken if it waits.
+template <typename T, typename Table>
+void AsyncHash<T, Table>::submit(int op, const T& record, callback done)
+{
+    bool wake;
+    {
+        lock_guard<mutex> guard(_mutex);
+        wake = _queue.empty();
+        _queue.push_back(operation());
+        _queue.back().op = op;
+        _queue.back().record = record;
+        _queue.back().done = move(done);
+        _submitted++;
+    }
+    if(wake)
+        _queued.notify_one();
+}
+
+//preconditions: runs on the worker thread.
+//postconditions: the worker swaps the whole queue out with one lock and runs it as a batch while
+// new operations queue up behind it. It stops once asked to and the queue is empty.
+template <typename T, typename Table>
+void AsyncHash<T, Table>::work()
+{
+    vector<operation> batch;
+    while(true)
+    {
+        {
+            unique_lock<mutex> lock(_mutex);
+            _queued.wait(lock, [this]() { return !_queue.empty() || _stop; });
+            if(_queue.empty())
+                return;
+            batch.swap(_queue);
+        }
+
+        run(batch);
+
+        {
+            lock_guard<mutex> guard(_mutex);
+            _completed += batch.size();
+            _batches++;
+        }
+        _ran.notify_all();
+        batch.clear();
+    }
+}
+
+//preconditions: runs on the worker thread.
+//postconditions: the operations are grouped by the region of the table their home falls in with
+// a counting sort, which keeps the order they were submitted in within a group, and run group by
+// group so the neighbouring slots of a region are brought into the cache once per batch. The
+// batch has at most one group per operation and every group spans at least MIN_REGION slots.
+// A batch with more inserts than the table has room for is one group, it runs in submission
+// order since which insert fails or evicts depends on the order. The callbacks are called
+// afterwards in the order the operations were submitted.
+template <typename T, typename Table>
+void AsyncHash<T, Table>::run(vector<operation>& batch)
+{
+    size_t inserts = 0;
+    for(size_t i = 0; i < batch.size(); i++)
+        if(batch[i].op == INSERT)
+            inserts++;
+
+    size_t capacity = _table.capacity();
+    size_t groups = capacity / MIN_REGION + 1;
+    if(groups > batch.size())
+        groups = batch.size();
+    if(inserts > _table.room())
+        groups = 1;
+
+    _group.resize(batch.size());
+    _start.assign(groups + 1, 0);
+    for(size_t i = 0; i < batch.size(); i++)
+    {
+        _group[i] = size_t(uint64_t(_table.home(batch[i].record.key)) * groups / capacity);
+        _start[_group[i] + 1]++;
+    }
+    for(size_t g = 0; g < groups; g++)
+        _start[g + 1] += _start[g];
+    _order.resize(batch.size());
+    for(size_t i = 0; i < batch.size(); i++)
+        _order[_start[_group[i]]++] = i;
+
+    _results.resize(batch.size());
+    for(size_t i = 0; i < _order.size(); i++)
+    {
+        operation& o = batch[_order[i]];
+        bool ok;
+        if(o.op == INSERT)
+            ok = _table.insert(o.record);
+        else if(o.op == REMOVE)
+            ok = _table.remove(o.record.key);
+        else
+            _table.find(o.record.key, ok, o.record);
+        _results[_order[i]] = ok;
+    }
+
+    for(size_t i = 0; i < batch.size(); i++)
+        if(batch[i].done)
+            batch[i].done(_results[i], batch[i].record);
+}
+
+#endif // ASYNCHASH_H
@@ -1,6 +1,8 @@
 #ifndef AVL_H
 #define AVL_H
+#include <type_traits>
 #include "bst_functions.h"
+#include "frozen_tree.h"
 
 template <typename T>
 class AVL
@@ -17,6 +19,7 @@ class AVL
 
 public:
     AVL();
+    AVL(tree_pool<T>* pool);                //construct an empty avl that draws its nodes from the shared pool.
     AVL(const T* sorted_list, int size=-1); //construct an avl from the sorted list using tree_from_sorted_List.
     AVL(const AVL<T>& copy_me);             //construct an avl that contains the same values as copy_me.
     ~AVL();
@@ -24,11 +27,26 @@ public:
     AVL<T>& operator =(const AVL<T>& rhs);  //assign this avl the contents of rhs.
     AVL<T>& operator +=(const AVL<T>& rhs); //add each node from rhs to this avl.
 
+    //set operations, this avl is replaced by the result. If parallelDepth > 0, the
+    // join based algorithm is used and the top parallelDepth levels run on their own threads.
+    AVL<T>& unite(const AVL<T>& rhs, int parallelDepth = 0);     //keep the items in either avl.
+    AVL<T>& intersect(const AVL<T>& rhs, int parallelDepth = 0); //keep the items in both avls.
+    AVL<T>& subtract(const AVL<T>& rhs, int parallelDepth = 0);  //keep the items that are not in rhs.
+
     bool insert(const T& insert_me);        //insert the value into this avl.
     bool erase(const T& target);            //remove the value into this avl.
     bool search(const T& target, tree_node<T>* & found_ptr); //find the value in this avl.
 
+    size_t rank(const T& key) const;                        //number of items less than key.
+    bool select(size_t k, T& result) const;                 //the k-th smallest item (k starts at 0).
+    size_t count_range(const T& lo, const T& hi) const;     //number of items in [lo, hi].
+    template <typename Visitor>
+    void range(const T& lo, const T& hi, Visitor visit) const; //visit the items in [lo, hi] in order.
+
+    FrozenTree<T> freeze() const;           //a read-only copy in one contiguous Eytzinger array.
+
     bool isBalanced(); //non-recursive caller for verifyBalance.
+    void abandon();    //forget the nodes without visiting them, the shared pool will release them in bulk.
 
     size_t size() const
     {
@@ -38,16 +56,36 @@ public:
 private:
      //traverse the tree and verify the balance factor is < 2 and > -2 at each node.
     void verifyBalance(tree_node<T>* root, bool &balance);
+    AVL<T>& setOperation(const AVL<T>& rhs, tree_set_op op, int parallelDepth);
     tree_node<T>* root;
+
+    //rhs is merged by split / join instead of a linear merge when it is this many times smaller.
+    static const size_t JOIN_RATIO = 8;
+
+    static const size_t SLAB_SIZE = 64;   //nodes per slab of a private pool.
+    tree_pool<T> _ownPool; //used when no shared pool is provided, no memory is reserved until the first insert.
+    tree_pool<T>* _pool;   //the pool every node of this tree is drawn from.
 };
 
 //preconditions: none.
 //postconditions: a new, empty AVL object is constructed.
 // root is initialized to null.
 template <typename T>
-AVL<T>::AVL()
+AVL<T>::AVL(): _ownPool(SLAB_SIZE)
+{
+    root = nullptr;
+    _pool = &_ownPool;
+}
+
+//preconditions: pool must outlive this AVL.
+//postconditions: a new, empty AVL object is constructed, nodes will be drawn from pool
+// so that several trees (the buckets of a hash table) share one arena.
+template <typename T>
+AVL<T>::AVL(tree_pool<T>* pool): _ownPool(SLAB_SIZE)
 {
+    assert(pool);
     root = nullptr;
+    _pool = pool;
 }
 
 //preconditions: size >= 0, list must be sorted.
@@ -57,19 +95,21 @@ AVL<T>::AVL()
 // the right subarray will be distributed to the right subtree, and the left subarray to the left subarray by
 // making recursive calls that reduce the size and change the starting position of the arary.
 template <typename T>
-AVL<T>::AVL(const T* sorted_list, int size)
+AVL<T>::AVL(const T* sorted_list, int size): _ownPool(SLAB_SIZE)
 {
     assert(size >=0);
-    root = tree_from_sorted_list(sorted_list, size);
+    _pool = &_ownPool;
+    root = tree_from_sorted_list(sorted_list, size, _pool);
 }
 
 //preconditions: none.
 //postconditions: a new AVL object is constructed with its
 // contents equal to those of the recieved AVL
 template <typename T>
-AVL<T>::AVL(const AVL<T>& copy_me)
+AVL<T>::AVL(const AVL<T>& copy_me): _ownPool(SLAB_SIZE)
 {
-    root = tree_copy(copy_me.root);
+    _pool = &_ownPool;
+    root = tree_copy(copy_me.root, _pool);
 }
 
 //preconditions: self-assignment is not allowed.
@@ -79,18 +119,31 @@ template <typename T>
 AVL<T>& AVL<T>::operator =(const AVL<T>& rhs)
 {
     assert(&rhs != this);
-    tree_clear(root);
-    root = tree_copy(rhs.root);
+    tree_clear(root, _pool);
+    root = tree_copy(rhs.root, _pool);
     return *this;
 }
 
 //preconditions: none
 //postconditions: call tree_clear to traverse the tree and deallocate all nodes,
-// starting from the leftmost leaves.
+// starting from the leftmost leaves. When the nodes live in the private pool and
+// need no destructor, the walk is skipped and the pool releases its slabs in bulk.
 template <typename T>
 AVL<T>::~AVL()
 {
-    tree_clear(root);
+    if(_pool == &_ownPool && is_trivially_destructible<T>::value)
+        root = nullptr;
+    else
+        tree_clear(root, _pool);
+}
+
+//preconditions: the nodes need no destructor and the pool they were drawn from is about to be released.
+//postconditions: root is set to null without visiting or deallocating the nodes.
+template <typename T>
+void AVL<T>::abandon()
+{
+    assert(is_trivially_destructible<T>::value);
+    root = nullptr;
 }
 
 //preconditions: none
@@ -99,7 +152,7 @@ AVL<T>::~AVL()
 template <typename T>
 bool AVL<T>::insert(const T& insert_me)
 {
-    return tree_insert(root,insert_me,true);
+    return tree_insert(root,insert_me,true,_pool);
 }
 
 //preconditions: none
@@ -108,7 +161,7 @@ bool AVL<T>::insert(const T& insert_me)
 template <typename T>
 bool AVL<T>::erase(const T& target)
 {
-    return tree_erase(root,target,true);
+    return tree_erase(root,target,true,_pool);
 }
 
 //preconditions: none
@@ -120,14 +173,108 @@ bool AVL<T>::search(const T& target, tree_node<T>* & found_ptr)
     return tree_search(root,target,found_ptr);
 }
 
+//preconditions: none
+//postconditions: returns the number of items less than key, using tree_rank.
+template <typename T>
+size_t AVL<T>::rank(const T& key) const
+{
+    return tree_rank(root, key);
+}
+
+//preconditions: none
+//postconditions: if k < size(), the k-th smallest item (k starts at 0) is returned by ref
+// and true is returned, otherwise false. Uses tree_select.
+template <typename T>
+bool AVL<T>::select(size_t k, T& result) const
+{
+    tree_node<T>* found_ptr = tree_select(root, k);
+    if(found_ptr)
+        result = found_ptr->_item;
+    return found_ptr != nullptr;
+}
+
+//preconditions: none
+//postconditions: returns the number of items in [lo, hi], using tree_count_range.
+template <typename T>
+size_t AVL<T>::count_range(const T& lo, const T& hi) const
+{
+    return tree_count_range(root, lo, hi);
+}
+
+//preconditions: none
+//postconditions: visit(item) is called on every item in [lo, hi] in ascending order, using tree_range.
+template <typename T>
+template <typename Visitor>
+void AVL<T>::range(const T& lo, const T& hi, Visitor visit) const
+{
+    tree_range(root, lo, hi, visit);
+}
+
+//preconditions: none
+//postconditions: returns a FrozenTree holding the items of this avl. The items are flattened
+// in order and laid out in Eytzinger order, this avl is not modified.
+template <typename T>
+FrozenTree<T> AVL<T>::freeze() const
+{
+    T* sorted = new T[size()];
+    size_t count = tree_flatten(root, sorted);
+    FrozenTree<T> frozen(sorted, count);
+    delete [] sorted;
+    return frozen;
+}
+
 //preconditions: self-assignment is not allowed.
-//postconditions: add the rhs to this tree, using tree_insert,
+//postconditions: add the rhs to this tree, using unite,
 // return the AVL pointed to by this.
 template <typename T>
 AVL<T>& AVL<T>::operator +=(const AVL<T>& rhs)
+{
+    return unite(rhs);
+}
+
+//preconditions: rhs is not this avl.
+//postconditions: this avl holds the items of either avl, the item of this avl is kept for duplicates.
+template <typename T>
+AVL<T>& AVL<T>::unite(const AVL<T>& rhs, int parallelDepth)
+{
+    return setOperation(rhs, TREE_UNION, parallelDepth);
+}
+
+//preconditions: rhs is not this avl.
+//postconditions: this avl holds the items found in both avls.
+template <typename T>
+AVL<T>& AVL<T>::intersect(const AVL<T>& rhs, int parallelDepth)
+{
+    return setOperation(rhs, TREE_INTERSECTION, parallelDepth);
+}
+
+//preconditions: rhs is not this avl.
+//postconditions: this avl holds its items that are not found in rhs.
+template <typename T>
+AVL<T>& AVL<T>::subtract(const AVL<T>& rhs, int parallelDepth)
+{
+    return setOperation(rhs, TREE_DIFFERENCE, parallelDepth);
+}
+
+//preconditions: rhs is not this avl.
+//postconditions: root is replaced by root (op) rhs. When rhs is much smaller (or threads are
+// requested) a copy of rhs is merged in with tree_set_join in O(m log(n/m + 1)), otherwise
+// both trees are merged as sorted lists by tree_set_operation in O(n + m).
+template <typename T>
+AVL<T>& AVL<T>::setOperation(const AVL<T>& rhs, tree_set_op op, int parallelDepth)
 {
     assert(&rhs != this);
-    tree_add(this->root,rhs.root,true);
+
+    if(parallelDepth > 0 || rhs.size() * JOIN_RATIO < size())
+    {
+        root = tree_set_join(root, tree_copy(rhs.root, _pool), op, _pool, parallelDepth);
+    }
+    else
+    {
+        tree_node<T>* result = tree_set_operation(root, rhs.root, op, _pool);
+        tree_clear(root, _pool);
+        root = result;
+    }
     return *this;
 }
 
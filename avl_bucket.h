@@ -0,0 +1,99 @@
+#ifndef AVL_BUCKET_H
+#define AVL_BUCKET_H
+
+#include <cstdlib>
+#include <cassert>
+#include "bst_functions.h"
+
+using namespace std;
+
+//A hash table bucket that is just the root of an AVL tree drawn from the table's shared pool.
+// An empty bucket is a null pointer, every record costs one tree_node.
+template <typename T>
+class AVLBucket
+{
+public:
+    typedef tree_pool<T> pool_type;
+
+    //every byte of the bucket lives in the pool, so the table may release the pool in bulk.
+    static const bool BULK_RELEASE = true;
+
+    AVLBucket(): _root(nullptr) {}
+
+    //preconditions: none
+    //postconditions: returns true if the record inserted, otherwise false.
+    bool insert(const T& entry, pool_type& pool)
+    {
+        return tree_insert(_root, entry, true, &pool);
+    }
+
+    //preconditions: none
+    //postconditions: returns true if the record with the key was removed, otherwise false.
+    bool erase(int key, pool_type& pool)
+    {
+        return tree_erase(_root, T(key), true, &pool);
+    }
+
+    //preconditions: none
+    //postconditions: returns the record with the key, or null.
+    T* search(int key, pool_type&)
+    {
+        tree_node<T>* found_ptr = tree_search(_root, T(key));
+        return (found_ptr) ? &found_ptr->_item : nullptr;
+    }
+
+    //preconditions: none
+    //postconditions: every node is returned to the pool.
+    void clear(pool_type& pool)
+    {
+        tree_clear(_root, &pool);
+    }
+
+    //preconditions: this bucket is empty.
+    //postconditions: this bucket holds a copy of from, nodes are drawn from pool.
+    void copy(const AVLBucket<T>& from, const pool_type&, pool_type& pool)
+    {
+        assert(!_root);
+        _root = tree_copy(from._root, &pool);
+    }
+
+    //preconditions: out has room for size() records.
+    //postconditions: the records are copied to out in key order, the count is returned.
+    size_t flatten(T* out, const pool_type&) const
+    {
+        return tree_flatten(_root, out);
+    }
+
+    //preconditions: none
+    //postconditions: the tree is printed with tree_print.
+    void print(ostream& outs, const pool_type&) const
+    {
+        tree_print(_root, 0, outs);
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of records in the bucket.
+    inline size_t size() const
+    {
+        return (_root) ? _root->_size : 0;
+    }
+
+    //preconditions: none
+    //postconditions: returns true if the bucket holds no record.
+    inline bool empty() const
+    {
+        return _root == nullptr;
+    }
+
+    //preconditions: none
+    //postconditions: returns the root of the tree, so a batched lookup can walk it a node at a time.
+    inline tree_node<T>* tree() const
+    {
+        return _root;
+    }
+
+private:
+    tree_node<T>* _root;
+};
+
+#endif // AVL_BUCKET_H
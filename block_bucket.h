@@ -0,0 +1,343 @@
+#ifndef BLOCK_BUCKET_H
+#define BLOCK_BUCKET_H
+
+#include <cstdlib>
+#include <cassert>
+#include <iostream>
+#include "bst_functions.h"
+#include "node_pool.h"
+
+using namespace std;
+
+//A block of records sorted by key. The keys are kept apart from the records so the
+// 16 keys of a block fill exactly one 64 byte cache line.
+template <typename T>
+struct record_block
+{
+    static const int CAPACITY = 16;
+
+    int _keys[CAPACITY];
+    int _count;
+    T _items[CAPACITY];
+
+    record_block(): _count(0) {}
+
+    //preconditions: none
+    //postconditions: returns the position of the first key >= key (binary search of the key line).
+    int lower_bound(int key) const
+    {
+        int lo = 0, hi = _count;
+        while(lo < hi)
+        {
+            int mid = (lo + hi) / 2;
+            if(_keys[mid] < key)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+};
+
+//A hash table bucket for workloads with legitimately large buckets: a sorted list of
+// cache line sized record_blocks, a two level B+ tree. The first key of every block is kept
+// in a contiguous directory that is searched by galloping from the front, the block is then
+// binary searched, so a lookup touches the directory and one block instead of a pointer per
+// tree level. Full blocks split in half, sparse blocks merge with a neighbour.
+template <typename T>
+class BlockBucket
+{
+public:
+    typedef record_block<T> block_type;
+    typedef NodePool<block_type> pool_type;
+
+    //the directory is allocated on the heap, so the table must clear every bucket.
+    static const bool BULK_RELEASE = false;
+
+    BlockBucket(): _blocks(nullptr), _firstKeys(nullptr), _blockCount(0), _blockCapacity(0) {}
+
+    bool insert(const T& entry, pool_type& pool);   //returns true if the record inserted, otherwise false.
+    bool erase(int key, pool_type& pool);           //returns true if the record with the key was removed.
+    T* search(int key, pool_type& pool);            //returns the record with the key, or null.
+    void clear(pool_type& pool);                    //remove every record and the directory.
+    void copy(const BlockBucket<T>& from, const pool_type& fromPool, pool_type& pool); //this bucket must be empty.
+    size_t flatten(T* out, const pool_type& pool) const; //copy the records to out in key order, returns the count.
+    void print(ostream& outs, const pool_type& pool) const; //print the records in key order.
+
+    //preconditions: none
+    //postconditions: returns true if the bucket holds no record.
+    inline bool empty() const
+    {
+        return _blockCount == 0;
+    }
+
+    //preconditions: none
+    //postconditions: returns null, the records are not in a tree_node tree, so a batched lookup
+    // searches the bucket whole.
+    inline tree_node<T>* tree() const
+    {
+        return nullptr;
+    }
+
+private:
+    block_type** _blocks;   //the blocks in key order.
+    int* _firstKeys;        //_firstKeys[i] is the smallest key of _blocks[i].
+    size_t _blockCount;
+    size_t _blockCapacity;
+
+    size_t find_block(int key) const;
+    void insert_block(size_t position, block_type* block);
+    void remove_block(size_t position, pool_type& pool);
+    void merge_blocks(size_t position, pool_type& pool);
+};
+
+//preconditions: _blockCount > 0
+//postconditions: returns the position of the last block whose first key is <= key (0 if none is).
+// The directory is probed at 1, 2, 4, ... until a first key above key is found, then the
+// last stride is binary searched, so keys near the front of the bucket are found quickly.
+template <typename T>
+size_t BlockBucket<T>::find_block(int key) const
+{
+    size_t bound = 1;
+    while(bound < _blockCount && _firstKeys[bound] <= key)
+        bound *= 2;
+
+    size_t lo = bound / 2;
+    size_t hi = (bound < _blockCount) ? bound : _blockCount;
+    //invariant: _firstKeys[lo] <= key (or lo == 0), every block at or after hi starts above key.
+    while(hi - lo > 1)
+    {
+        size_t mid = (lo + hi) / 2;
+        if(_firstKeys[mid] <= key)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+//preconditions: none
+//postconditions: the entry is inserted into the block that covers its key, a full block is
+// split in half first. Returns false if the key is already in the bucket.
+template <typename T>
+bool BlockBucket<T>::insert(const T& entry, pool_type& pool)
+{
+    if(_blockCount == 0)
+        insert_block(0, new (pool.allocate()) block_type());
+
+    size_t b = find_block(entry.key);
+    block_type* block = _blocks[b];
+    int position = block->lower_bound(entry.key);
+
+    if(position < block->_count && block->_keys[position] == entry.key)
+        return false;
+
+    if(block->_count == block_type::CAPACITY)
+    {
+        //move the upper half into a new block that follows this one.
+        block_type* upper = new (pool.allocate()) block_type();
+        int half = block_type::CAPACITY / 2;
+        for(int i = half; i < block->_count; i++)
+        {
+            upper->_keys[i - half] = block->_keys[i];
+            upper->_items[i - half] = block->_items[i];
+        }
+        upper->_count = block->_count - half;
+        block->_count = half;
+        insert_block(b + 1, upper);
+
+        if(position > half)
+        {
+            b++;
+            block = upper;
+            position -= half;
+        }
+    }
+
+    for(int i = block->_count; i > position; i--)
+    {
+        block->_keys[i] = block->_keys[i-1];
+        block->_items[i] = block->_items[i-1];
+    }
+    block->_keys[position] = entry.key;
+    block->_items[position] = entry;
+    block->_count++;
+
+    if(position == 0)
+        _firstKeys[b] = entry.key;
+    return true;
+}
+
+//preconditions: none
+//postconditions: the record with the key is removed. An empty block is released, a block that
+// falls below a quarter full is merged with a neighbour if both fit in one block.
+template <typename T>
+bool BlockBucket<T>::erase(int key, pool_type& pool)
+{
+    if(_blockCount == 0)
+        return false;
+
+    size_t b = find_block(key);
+    block_type* block = _blocks[b];
+    int position = block->lower_bound(key);
+
+    if(position == block->_count || block->_keys[position] != key)
+        return false;
+
+    block->_count--;
+    for(int i = position; i < block->_count; i++)
+    {
+        block->_keys[i] = block->_keys[i+1];
+        block->_items[i] = block->_items[i+1];
+    }
+
+    if(block->_count == 0)
+    {
+        remove_block(b, pool);
+    }
+    else
+    {
+        _firstKeys[b] = block->_keys[0];
+        if(block->_count < block_type::CAPACITY / 4)
+        {
+            if(b + 1 < _blockCount && block->_count + _blocks[b+1]->_count <= block_type::CAPACITY)
+                merge_blocks(b, pool);
+            else if(b > 0 && block->_count + _blocks[b-1]->_count <= block_type::CAPACITY)
+                merge_blocks(b - 1, pool);
+        }
+    }
+    return true;
+}
+
+//preconditions: none
+//postconditions: returns a pointer to the record with the key, or null if it is not in the bucket.
+template <typename T>
+T* BlockBucket<T>::search(int key, pool_type&)
+{
+    if(_blockCount == 0)
+        return nullptr;
+
+    block_type* block = _blocks[find_block(key)];
+    int position = block->lower_bound(key);
+    return (position < block->_count && block->_keys[position] == key) ? &block->_items[position] : nullptr;
+}
+
+//preconditions: none
+//postconditions: every block is returned to the pool and the directory is deallocated.
+template <typename T>
+void BlockBucket<T>::clear(pool_type& pool)
+{
+    for(size_t i = 0; i < _blockCount; i++)
+    {
+        _blocks[i]->~block_type();
+        pool.deallocate(_blocks[i]);
+    }
+    delete [] _blocks;
+    delete [] _firstKeys;
+    _blocks = nullptr;
+    _firstKeys = nullptr;
+    _blockCount = 0;
+    _blockCapacity = 0;
+}
+
+//preconditions: this bucket is empty.
+//postconditions: this bucket holds a copy of from, blocks are drawn from pool.
+template <typename T>
+void BlockBucket<T>::copy(const BlockBucket<T>& from, const pool_type&, pool_type& pool)
+{
+    assert(_blockCount == 0);
+    for(size_t i = 0; i < from._blockCount; i++)
+        insert_block(i, new (pool.allocate()) block_type(*from._blocks[i]));
+}
+
+//preconditions: out has room for every record of the bucket.
+//postconditions: the records are copied to out in key order, the count is returned.
+template <typename T>
+size_t BlockBucket<T>::flatten(T* out, const pool_type&) const
+{
+    size_t count = 0;
+    for(size_t b = 0; b < _blockCount; b++)
+        for(int i = 0; i < _blocks[b]->_count; i++)
+            out[count++] = _blocks[b]->_items[i];
+    return count;
+}
+
+//preconditions: none
+//postconditions: every record is printed on its own line, one block after another.
+template <typename T>
+void BlockBucket<T>::print(ostream& outs, const pool_type&) const
+{
+    for(size_t b = 0; b < _blockCount; b++)
+        for(int i = 0; i < _blocks[b]->_count; i++)
+            outs << "|" << _blocks[b]->_items[i] << "|" << endl;
+}
+
+//preconditions: block holds at least one record, position <= _blockCount.
+//postconditions: block is inserted into the directory at position, the directory doubles when full.
+template <typename T>
+void BlockBucket<T>::insert_block(size_t position, block_type* block)
+{
+    if(_blockCount == _blockCapacity)
+    {
+        size_t newCapacity = (_blockCapacity) ? _blockCapacity * 2 : 4;
+        block_type** blocks = new block_type*[newCapacity];
+        int* firstKeys = new int[newCapacity];
+        for(size_t i = 0; i < _blockCount; i++)
+        {
+            blocks[i] = _blocks[i];
+            firstKeys[i] = _firstKeys[i];
+        }
+        delete [] _blocks;
+        delete [] _firstKeys;
+        _blocks = blocks;
+        _firstKeys = firstKeys;
+        _blockCapacity = newCapacity;
+    }
+
+    for(size_t i = _blockCount; i > position; i--)
+    {
+        _blocks[i] = _blocks[i-1];
+        _firstKeys[i] = _firstKeys[i-1];
+    }
+    _blocks[position] = block;
+    _firstKeys[position] = (block->_count) ? block->_keys[0] : 0;
+    _blockCount++;
+}
+
+//preconditions: position < _blockCount
+//postconditions: the block is returned to the pool and removed from the directory,
+// the directory is deallocated once the bucket is empty.
+template <typename T>
+void BlockBucket<T>::remove_block(size_t position, pool_type& pool)
+{
+    _blocks[position]->~block_type();
+    pool.deallocate(_blocks[position]);
+    _blockCount--;
+    for(size_t i = position; i < _blockCount; i++)
+    {
+        _blocks[i] = _blocks[i+1];
+        _firstKeys[i] = _firstKeys[i+1];
+    }
+
+    if(_blockCount == 0)
+        clear(pool);
+}
+
+//preconditions: position + 1 < _blockCount, both blocks fit in one block.
+//postconditions: the records of the block after position are appended to the block at position,
+// the emptied block is removed.
+template <typename T>
+void BlockBucket<T>::merge_blocks(size_t position, pool_type& pool)
+{
+    block_type* into = _blocks[position];
+    block_type* from = _blocks[position + 1];
+    for(int i = 0; i < from->_count; i++)
+    {
+        into->_keys[into->_count] = from->_keys[i];
+        into->_items[into->_count] = from->_items[i];
+        into->_count++;
+    }
+    remove_block(position + 1, pool);
+}
+
+#endif // BLOCK_BUCKET_H
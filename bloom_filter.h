@@ -0,0 +1,167 @@
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+#include <cstdlib>
+#include <cassert>
+#include <cstdint>
+#include "hash_functions.h"
+
+using namespace std;
+
+//A counting, blocked Bloom filter over int keys. Every key maps to one 64 byte block (one
+// cache line) and sets one 4 bit counter in each of the 8 words of that block, so a query
+// touches a single cache line and tests the 8 words without a data dependent branch.
+// Counters make remove possible, a counter that saturates at 15 is never decremented again
+// (the filter stays conservative, a key may be reported present but never missing).
+class BlockedBloomFilter
+{
+public:
+    BlockedBloomFilter(size_t expectedKeys = 1024);    //sized for about 1% false positives at expectedKeys.
+    ~BlockedBloomFilter();
+
+    BlockedBloomFilter& operator=(const BlockedBloomFilter& other);
+    BlockedBloomFilter(const BlockedBloomFilter& other);
+
+    void insert(int key);                   //count the key.
+    void remove(int key);                   //uncount a key that was inserted.
+    bool may_contain(int key) const;        //false means the key was never inserted (or was removed).
+    void clear();                           //forget every key.
+
+    //preconditions: none
+    //postconditions: returns the number of bytes used by the counters.
+    inline size_t bytes() const
+    {
+        return _blockCount * sizeof(block);
+    }
+
+private:
+    static const int WORDS = 8;             //words per block, one counter is used in each.
+    static const uint64_t COUNTER_MASK = 0xF;
+    static const size_t KEYS_PER_BLOCK = 12;
+
+    struct alignas(64) block
+    {
+        uint64_t _words[WORDS];             //16 counters of 4 bits per word.
+    };
+
+    block* _blocks;
+    size_t _blockCount;
+
+    //preconditions: none
+    //postconditions: returns a well mixed 64 bit hash of the key (the splitmix64 finalizer).
+    static inline uint64_t mix(int key)
+    {
+        return hash_mix(key);
+    }
+
+    //preconditions: none
+    //postconditions: returns the block of the hash, the high 32 bits are mapped onto
+    // [0, _blockCount) with a multiply instead of a modulo.
+    inline block& block_of(uint64_t h) const
+    {
+        return _blocks[((h >> 32) * _blockCount) >> 32];
+    }
+
+    //preconditions: 0 <= word < WORDS
+    //postconditions: returns the shift of the counter used in the word, 4 bits of the
+    // low half of the hash select one of its 16 counters.
+    static inline int shift_of(uint64_t h, int word)
+    {
+        return int((h >> (4 * word)) & 0xF) * 4;
+    }
+};
+
+//preconditions: none
+//postconditions: allocate one block per KEYS_PER_BLOCK expected keys, every counter is 0.
+inline BlockedBloomFilter::BlockedBloomFilter(size_t expectedKeys)
+{
+    _blockCount = expectedKeys / KEYS_PER_BLOCK + 1;
+    _blocks = new block[_blockCount];
+    clear();
+}
+
+//preconditions: none
+//postconditions: deallocate the blocks.
+inline BlockedBloomFilter::~BlockedBloomFilter()
+{
+    delete [] _blocks;
+}
+
+//preconditions: none
+//postconditions: this filter holds a copy of the counters of other.
+inline BlockedBloomFilter& BlockedBloomFilter::operator=(const BlockedBloomFilter& other)
+{
+    if(&other == this)
+        return *this;
+
+    delete [] _blocks;
+    _blockCount = other._blockCount;
+    _blocks = new block[_blockCount];
+    for(size_t i = 0; i < _blockCount; i++)
+        _blocks[i] = other._blocks[i];
+    return *this;
+}
+
+//preconditions: none
+//postconditions: construct this filter with a copy of the counters of other.
+inline BlockedBloomFilter::BlockedBloomFilter(const BlockedBloomFilter& other)
+{
+    _blockCount = other._blockCount;
+    _blocks = new block[_blockCount];
+    for(size_t i = 0; i < _blockCount; i++)
+        _blocks[i] = other._blocks[i];
+}
+
+//preconditions: none
+//postconditions: one counter in each word of the key's block is incremented, unless saturated.
+inline void BlockedBloomFilter::insert(int key)
+{
+    uint64_t h = mix(key);
+    block& b = block_of(h);
+    for(int w = 0; w < WORDS; w++)
+    {
+        int shift = shift_of(h, w);
+        if(((b._words[w] >> shift) & COUNTER_MASK) != COUNTER_MASK)
+            b._words[w] += uint64_t(1) << shift;
+    }
+}
+
+//preconditions: the key was inserted and has not been removed since.
+//postconditions: the counters of the key are decremented, saturated counters are left alone.
+inline void BlockedBloomFilter::remove(int key)
+{
+    uint64_t h = mix(key);
+    block& b = block_of(h);
+    for(int w = 0; w < WORDS; w++)
+    {
+        int shift = shift_of(h, w);
+        uint64_t counter = (b._words[w] >> shift) & COUNTER_MASK;
+        assert(counter > 0);
+        if(counter != COUNTER_MASK && counter > 0)
+            b._words[w] -= uint64_t(1) << shift;
+    }
+}
+
+//preconditions: none
+//postconditions: returns false if any counter of the key is 0. The 8 counters are combined
+// with a bitwise and, so the loop has no branch and is unrolled / vectorized by the compiler.
+inline bool BlockedBloomFilter::may_contain(int key) const
+{
+    uint64_t h = mix(key);
+    const block& b = block_of(h);
+    uint64_t present = 1;
+    for(int w = 0; w < WORDS; w++)
+        present &= uint64_t(((b._words[w] >> shift_of(h, w)) & COUNTER_MASK) != 0);
+    return present != 0;
+}
+
+//preconditions: none
+//postconditions: every counter is 0.
+inline void BlockedBloomFilter::clear()
+{
+    for(size_t i = 0; i < _blockCount; i++)
+        for(int w = 0; w < WORDS; w++)
+            _blocks[i]._words[w] = 0;
+}
+
+#endif // BLOOM_FILTER_H
@@ -5,6 +5,10 @@
 #include <cmath>
 #include <cstdlib>
 #include <cassert>
+#include <vector>
+#include <thread>
+#include <memory>
+#include "node_pool.h"
 
 using namespace std;
 
@@ -56,25 +60,47 @@ struct tree_node
     }
 };
 
+//The arena the tree functions draw their nodes from. When a null pool is passed,
+// nodes are allocated with new and freed with delete.
+template <typename T>
+using tree_pool = NodePool<tree_node<T> >;
+
+//preconditions: none
+//postconditions: returns a new node holding item, its storage is drawn from pool
+// if one is provided, otherwise from the heap.
+template <typename T>
+tree_node<T>* tree_new_node(tree_pool<T>* pool, const T& item, tree_node<T>* left=NULL, tree_node<T>* right=NULL);
+
+//preconditions: node was created by tree_new_node with the same pool.
+//postconditions: the node is destroyed and its storage returned to pool (or the heap).
+template <typename T>
+void tree_delete_node(tree_pool<T>* pool, tree_node<T>* node);
+
 //preconditions: none
-//postconditions: A new node is created with the value: insert_me, and added to the tree when root is null.
-// Recursive calls are made to this function with root->_left or root->_right depending on if our value to
-// insert is less than or greater than the value of the node pointed to by the current root.
-// If insertion is successful, return true, otherwise return false. Insertion can fail if a duplicate is found.
-// When returning, update the height and size of all nodes that the newly inserted node is a decendent of,
+//postconditions: A new node is created with the value: insert_me, and added to the tree where the
+// iterative binary search for insert_me falls off the tree. The link to every node visited on the way
+// down is pushed onto a tree_path. If insertion is successful, return true, otherwise return false.
+// Insertion can fail if a duplicate is found. The path is then retraced (tree_retrace) to update
+// the height and size of all nodes that the newly inserted node is a decendent of,
 //   if the AVL flag is true, call rotate also.
 template <typename T>
-bool tree_insert(tree_node<T>* &root, const T& insert_me, bool avl = false);
+bool tree_insert(tree_node<T>* &root, const T& insert_me, bool avl = false, tree_pool<T>* pool = nullptr);
 
 //preconditions: none
-//postconditions: a recursive binary search is conducted until the target or null is encountered.
-// recursively call tree_search with our left / right child, if root's value is greater / less than the target, respectively.
+//postconditions: an iterative binary search is conducted until the target or null is encountered.
+// move to our left / right child, if root's value is greater / less than the target, respectively.
 // return a pointer to the node with the target value or null if it was not found.
 template <typename T>
 tree_node<T>* tree_search(tree_node<T>* root, const T& target);
 
+//preconditions: root is not null.
+//postconditions: one step of tree_search. Returns true if root holds the target, otherwise root
+// moves to the child the target would be under, possibly null, and false is returned.
+template <typename T>
+bool tree_search_step(tree_node<T>* &root, const T& target);
+
 //preconditions: none
-//postconditions: a recursive binary search is conducted until the target or null is encountered.
+//postconditions: an iterative binary search is conducted until the target or null is encountered.
 // If null is found, return false as the target does not exist in the tree. Otherwise, return true,
 // return a pointer to the node by reference.
 template <typename T>
@@ -93,42 +119,155 @@ template<typename T>
 void tree_print_debug(tree_node<T>* root, int level=0, ostream& outs=cout);
 
 //preconditions: none
-//postconditions: The memory reserved by the tree poined to by root is deallocated.
-// Use recursion to delete leftmost node first, then that node's sibling and finally its parent.
+//postconditions: The memory reserved by the tree poined to by root is deallocated, root is set to null.
+// No recursion or stack is used: while root has a left child, rotate right, otherwise delete root
+// and continue with its right child.
 template <typename T>
-void tree_clear(tree_node<T>* &root);
+void tree_clear(tree_node<T>* &root, tree_pool<T>* pool = nullptr);
 
+//preconditions: none
+//postconditions: removes the target from the tree (if it exists) and returns true, otherwise returns false.
+// The search is iterative and pushes every visited link onto a tree_path, which is retraced afterwards.
 template <typename T>
-bool tree_erase(tree_node<T>*& root, const T& target, bool avl = false);
+bool tree_erase(tree_node<T>*& root, const T& target, bool avl = false, tree_pool<T>* pool = nullptr);
 
 //preconditions: none
 //postconditions: erase rightmost node from the tree,  store the item in max_value
 template <typename T>
-void tree_remove_max(tree_node<T>* &root, T& max_value, bool avl = false);
+void tree_remove_max(tree_node<T>* &root, T& max_value, bool avl = false, tree_pool<T>* pool = nullptr);
 
 //preconditions: none
 //postconditions: wrapper function for remove_max, returns the value removed by remove max
 // that is returned by reference. If this is called on an empty tree, returns
 // whatever is provided by the default constructor for type T.
 template <typename T>
-T tree_remove_max(tree_node<T>* &root, bool avl = false);
+T tree_remove_max(tree_node<T>* &root, bool avl = false, tree_pool<T>* pool = nullptr);
 
 //preconditions: none
 //postconditions: a new tree is constructed with the contents of the tree pointed to by root.
 // Recursive calls are made to tree_copy, and the leftmost leaf nodes are constructed first.
 template <typename T>
-tree_node<T>* tree_copy(tree_node<T>* root);
+tree_node<T>* tree_copy(tree_node<T>* root, tree_pool<T>* pool = nullptr);
 
 //preconditions: none
 //postconditions: the contents of src are copied to dest using recursive calls
 // to traverse src and tree_insert to add items to dest.
 template <typename T>
-void tree_add(tree_node<T>* & dest, const tree_node<T>* src, bool avl = true);
+void tree_add(tree_node<T>* & dest, const tree_node<T>* src, bool avl = true, tree_pool<T>* pool = nullptr);
 
 //preconditions: a must be sorted.
 //postconditions: a BST is constructed with the contents of a, the root is returned.
 template <typename T>
-tree_node<T>* tree_from_sorted_list(const T* a, int size);
+tree_node<T>* tree_from_sorted_list(const T* a, int size, tree_pool<T>* pool = nullptr);
+
+//preconditions: none
+//postconditions: returns the number of items in the tree that are less than key
+// (less than or equal to key if inclusive is true). The _size of the left subtree is
+// added every time the search moves right, so only one root to leaf path is visited.
+template <typename T>
+size_t tree_rank(const tree_node<T>* root, const T& key, bool inclusive = false);
+
+//preconditions: none
+//postconditions: returns the node holding the k-th smallest item (k starts at 0),
+// or null if k >= the size of the tree. The _size of the left subtree decides which way to go.
+template <typename T>
+tree_node<T>* tree_select(tree_node<T>* root, size_t k);
+
+//preconditions: none
+//postconditions: returns the number of items in the range [lo, hi] using two calls to tree_rank.
+template <typename T>
+size_t tree_count_range(const tree_node<T>* root, const T& lo, const T& hi);
+
+//preconditions: none
+//postconditions: visit(item) is called on every item in the range [lo, hi] in ascending order.
+// Subtrees entirely below lo are skipped, the walk stops at the first item above hi.
+template <typename T, typename Visitor>
+void tree_range(tree_node<T>* root, const T& lo, const T& hi, Visitor visit);
+
+//The set operations supported by tree_set_operation and tree_set_join.
+enum tree_set_op
+{
+    TREE_UNION,         //items in either tree (the first tree's item is kept for duplicates).
+    TREE_INTERSECTION,  //items in both trees (the first tree's item is kept).
+    TREE_DIFFERENCE     //items in the first tree but not in the second.
+};
+
+//preconditions: out has room for the size of the tree.
+//postconditions: the items of the tree are copied to out in ascending order, the count is returned.
+template <typename T>
+size_t tree_flatten(tree_node<T>* root, T* out);
+
+//preconditions: none
+//postconditions: returns a new tree holding a (op) b, the inputs are not modified.
+// Both trees are flattened in order, merged in O(n+m) and the result is built
+// with tree_from_sorted_list, so no rotation is ever needed.
+template <typename T>
+tree_node<T>* tree_set_operation(tree_node<T>* a, tree_node<T>* b, tree_set_op op, tree_pool<T>* pool = nullptr);
+
+//preconditions: left and right are AVL trees, every item of left < mid->_item < every item of right.
+//postconditions: mid is used as the root of a joined AVL tree holding left, mid and right,
+// the new root is returned. Costs O(|height(left) - height(right)|).
+template <typename T>
+tree_node<T>* tree_join(tree_node<T>* left, tree_node<T>* mid, tree_node<T>* right);
+
+//preconditions: root is an AVL tree.
+//postconditions: root is split into the AVL trees left (items < key) and right (items > key).
+// The node equal to key is detached and returned, or null is returned if key is not in the tree.
+// Costs O(log n), no node is allocated or freed.
+template <typename T>
+tree_node<T>* tree_split(tree_node<T>* root, const T& key, tree_node<T>* &left, tree_node<T>* &right);
+
+//preconditions: a and b are AVL trees drawn from pool.
+//postconditions: returns a (op) b built by splitting a around the root of b and joining
+// the results of the two halves, which costs O(m log(n/m + 1)) for m = the smaller size.
+// Both trees are consumed, discarded nodes are returned to pool. If parallelDepth > 0, the
+// left halves of the top parallelDepth levels are processed by their own threads.
+template <typename T>
+tree_node<T>* tree_set_join(tree_node<T>* a, tree_node<T>* b, tree_set_op op, tree_pool<T>* pool = nullptr, int parallelDepth = 0);
+
+//An immutable node of a persistent AVL tree. Children are shared between every version of
+// the tree that contains them, a node is freed when the last version (root) holding it is released.
+template <typename T>
+struct persistent_node
+{
+    typedef shared_ptr<const persistent_node<T> > ptr;
+
+    T _item;
+    ptr _left;
+    ptr _right;
+    int _height;
+    size_t _size;
+
+    persistent_node(const T& item, const ptr& left, const ptr& right): _item(item), _left(left), _right(right)
+    {
+        _height = 1 + std::max((_left) ? _left->_height : -1, (_right) ? _right->_height : -1);
+        _size = 1 + ((_left) ? _left->_size : 0) + ((_right) ? _right->_size : 0);
+    }
+};
+
+//preconditions: none
+//postconditions: returns a new version of the tree holding insert_me. Only the nodes on the
+// search path (and the nodes a rotation touches) are copied, every other node is shared with
+// root, which is not modified. inserted is false (and root is returned) if a duplicate is found.
+template <typename T>
+typename persistent_node<T>::ptr tree_persistent_insert(const typename persistent_node<T>::ptr& root, const T& insert_me, bool& inserted);
+
+//preconditions: none
+//postconditions: returns a new version of the tree without target, copying only the path to
+// it (and to its successor). erased is false (and root is returned) if target is not found.
+template <typename T>
+typename persistent_node<T>::ptr tree_persistent_erase(const typename persistent_node<T>::ptr& root, const T& target, bool& erased);
+
+//preconditions: none
+//postconditions: returns a pointer to the item equal to target, or null. The pointer is valid
+// while a version of the tree holding it is referenced.
+template <typename T>
+const T* tree_persistent_search(const persistent_node<T>* root, const T& target);
+
+//preconditions: none
+//postconditions: visit(item) is called on every item in [lo, hi] in ascending order.
+template <typename T, typename Visitor>
+void tree_persistent_range(const persistent_node<T>* root, const T& lo, const T& hi, Visitor visit);
 
 //preconditions: none
 //postconditions: if a is less than b, return b, otherwise return a.
@@ -140,6 +279,76 @@ T max(const T & a, const T & b);
 template<typename T>
 void updateNode(tree_node<T>* & root);
 
+//A stack of the links (the parent's child pointer) visited on the way down the tree.
+// It is used to retrace the path back to the root without recursion. Paths up to
+// INLINE_DEPTH deep (every AVL with less than 2^44 nodes) never touch the heap.
+template <typename T>
+class tree_path
+{
+public:
+    tree_path(): _links(_inline), _count(0), _capacity(INLINE_DEPTH) {}
+    ~tree_path()
+    {
+        if(_links != _inline)
+            delete [] _links;
+    }
+
+    //preconditions: none
+    //postconditions: link is pushed onto the path, the path grows if it is full.
+    void push(tree_node<T>** link)
+    {
+        if(_count == _capacity)
+            grow();
+        _links[_count++] = link;
+    }
+
+    //preconditions: the path is not empty.
+    //postconditions: the most recently pushed link is removed and returned.
+    tree_node<T>** pop()
+    {
+        assert(_count > 0);
+        return _links[--_count];
+    }
+
+    bool empty() const
+    {
+        return _count == 0;
+    }
+
+private:
+    static const size_t INLINE_DEPTH = 64;
+    tree_node<T>** _inline[INLINE_DEPTH];
+    tree_node<T>*** _links;
+    size_t _count;
+    size_t _capacity;
+
+    //preconditions: none
+    //postconditions: the capacity of the path is doubled.
+    void grow()
+    {
+        tree_node<T>*** bigger = new tree_node<T>**[_capacity * 2];
+        for(size_t i = 0; i < _count; i++)
+            bigger[i] = _links[i];
+        if(_links != _inline)
+            delete [] _links;
+        _links = bigger;
+        _capacity *= 2;
+    }
+
+    //not copyable.
+    tree_path(const tree_path<T>& other);
+    tree_path<T>& operator=(const tree_path<T>& other);
+};
+
+//preconditions: path holds the links from the root down to the parent of a node that
+// was just inserted (delta = 1) or removed (delta = -1).
+//postconditions: the path is popped back to the root. While the height of the subtree
+// below the current link keeps changing, its height and size are recomputed and, if the
+// AVL flag is true, it is rotated. Once a subtree's height is unchanged no ancestor's
+// height or balance can change, so only the sizes of the remaining ancestors are adjusted.
+template <typename T>
+void tree_retrace(tree_path<T>& path, int delta, bool avl);
+
 
 //----------------      AVL       ----------------
 // ---------------- ROTATIONS --------------------------
@@ -164,91 +373,97 @@ tree_node<T>* rotate_left(tree_node<T>* &root);
 // Case 2) Rotate right, then left: If the balance factor is 2 and our right child's balance factor is -1
 // Case 3) Rotate right: If the balance factor is 2 and our right child's balance factor is NOT -1
 // Case 4) Rotate left: If the balance factor is -2 and our left child's balance factor is NOT 1
+// Only the nodes moved by a rotation are updated, the height and size of root must be current.
 template <typename T>
 tree_node<T>* rotate(tree_node<T>* & root);
 
 
 //preconditions: none
-//postconditions: A new node is created with the value: insert_me, and added to the tree when root is null.
-// Recursive calls are made to this function with root->_left or root->_right depending on if our value to
-// insert is less than or greater than the value of the node pointed to by the current root.
-// If insertion is successful, return true, otherwise return false. Insertion can fail if a duplicate is found.
-// When returning, update the height and size of all nodes that the newly inserted node is a decendent of,
+//postconditions: A new node is created with the value: insert_me, and added to the tree where the
+// iterative binary search for insert_me falls off the tree. The link to every node visited on the way
+// down is pushed onto a tree_path. If insertion is successful, return true, otherwise return false.
+// Insertion can fail if a duplicate is found. The path is then retraced (tree_retrace) to update
+// the height and size of all nodes that the newly inserted node is a decendent of,
 //   if the AVL flag is true, call rotate also.
 template <typename T>
-bool tree_insert(tree_node<T>* &root, const T& insert_me, bool avl)
+bool tree_insert(tree_node<T>* &root, const T& insert_me, bool avl, tree_pool<T>* pool)
 {
-    bool itemInserted = false;
-    if(!root)
-    {
-        root = new tree_node<T>(insert_me);
-        return true;
-    }
-    else if(root->_item < insert_me)
-    {
-        itemInserted = tree_insert(root->_right,insert_me,avl);
-    }
-    else if(root->_item > insert_me)
-    {
-        itemInserted = tree_insert(root->_left,insert_me,avl);
-    }
-    else
-    {
-        return false;
-    }
+    tree_path<T> path;
+    tree_node<T>** link = &root;
 
-    if(root && itemInserted)
+    while(*link)
     {
-        root->update_height();
-        root->update_size();
+        if((*link)->_item < insert_me)
+        {
+            path.push(link);
+            link = &(*link)->_right;
+        }
+        else if((*link)->_item > insert_me)
+        {
+            path.push(link);
+            link = &(*link)->_left;
+        }
+        else
+        {
+            return false;
+        }
     }
 
-    if(avl)
-        root = rotate(root);
-
-    return itemInserted;
+    *link = tree_new_node(pool, insert_me);
+    tree_retrace(path, 1, avl);
+    return true;
 }
 
 //preconditions: none
-//postconditions: a recursive binary search is conducted until the target or null is encountered.
-// recursively call tree_search with our left / right child, if root's value is greater / less than the target, respectively.
+//postconditions: an iterative binary search is conducted until the target or null is encountered.
+// move to our left / right child, if root's value is greater / less than the target, respectively.
 // return a pointer to the node with the target value or null if it was not found.
 template <typename T>
 tree_node<T>* tree_search(tree_node<T>* root, const T& target)
 {
-    if(root->_item == target || !root)
-        return root;
-    else if(root->_item < target)
-        return tree_search(root->_right, target);
-    else
-        return tree_search(root->_left, target);
+    while(root && root->_item != target)
+        root = (root->_item < target) ? root->_right : root->_left;
+    return root;
+}
+
+//preconditions: root is not null.
+//postconditions: one step of tree_search. Returns true if root holds the target, otherwise root
+// moves to the child the target would be under, possibly null, and false is returned.
+template <typename T>
+bool tree_search_step(tree_node<T>* &root, const T& target)
+{
+    if(root->_item == target)
+        return true;
+    root = (root->_item < target) ? root->_right : root->_left;
+    return false;
 }
 
 //preconditions: none
-//postconditions: a recursive binary search is conducted until the target or null is encountered.
+//postconditions: an iterative binary search is conducted until the target or null is encountered.
 // If null is found, return false as the target does not exist in the tree. Otherwise, return true,
 // return a pointer to the node by reference.
 template <typename T>
 bool tree_search(tree_node<T>* root, const T& target, tree_node<T>* &found_ptr)
 {
-    if(!root)
-    {
-        found_ptr = nullptr; //if our target does not exist in the bst.
-        return false;
-    }
-    else if(root->_item == target)
-    {
-        found_ptr = root; //if we have found our target.
-        return true;
-    }
-    else if(root->_item < target)
-    {
-        return tree_search(root->_right, target,found_ptr); //if our target is more than the current root, search the right subtree
-    }
-    else
+    while(root)
     {
-        return tree_search(root->_left, target,found_ptr); //if our target is less than the current root, search the left subtree.
+        if(root->_item == target)
+        {
+            found_ptr = root; //if we have found our target.
+            return true;
+        }
+        else if(root->_item < target)
+        {
+            root = root->_right; //if our target is more than the current root, search the right subtree
+        }
+        else
+        {
+            root = root->_left; //if our target is less than the current root, search the left subtree.
+        }
     }
+
+    found_ptr = nullptr; //if our target does not exist in the bst.
+    return false;
 }
 
 //preconditions: none
@@ -281,109 +496,114 @@ void tree_print_debug(tree_node<T>* root, int level, ostream& outs)
 }
 
 //preconditions: none
-//postconditions: The memory reserved by the tree poined to by root is deallocated.
-// Use recursion to delete leftmost node first, then that node's sibling and finally its parent.
+//postconditions: The memory reserved by the tree poined to by root is deallocated, root is set to null.
+// No recursion or stack is used: while root has a left child, rotate right, otherwise delete root
+// and continue with its right child.
 template <typename T>
-void tree_clear(tree_node<T>* &root)
+void tree_clear(tree_node<T>* &root, tree_pool<T>* pool)
 {
-    if(root)
+    while(root)
     {
-        tree_clear(root->_left);
-        tree_clear(root->_right);
-        delete root;
+        if(root->_left)
+        {
+            tree_node<T>* left = root->_left;
+            root->_left = left->_right;
+            left->_right = root;
+            root = left;
+        }
+        else
+        {
+            tree_node<T>* right = root->_right;
+            tree_delete_node(pool,root);
+            root = right;
+        }
     }
 }
 
 //preconditions: none
 //postconditions: removes the target from the tree (if it exists) and returns true, otherwise returns false.
-// case 1) We know that the item is not in the tree if this function is called with root = null.
-// case 2) If the value of the node pointed to by root is larger than our target, make a recursive call with root = root->_left
-// case 3) If the value of the node pointed to by root is smaller than our target, make a recursive call with root = root->_right
-// case 4) If root points to the node containing the target, we have found the node to remove, consider 2 different subcases:
+// Every link visited is pushed onto a tree_path, the path is retraced once the node is removed.
+// case 1) We know that the item is not in the tree if the search reaches null.
+// case 2) If the value of the node pointed to by link is larger than our target, continue with link->_left
+// case 3) If the value of the node pointed to by link is smaller than our target, continue with link->_right
+// case 4) If link points to the node containing the target, we have found the node to remove, consider 2 different subcases:
 //          a) We don't have a left subtree, simply bypass the node and delete it.
 //          b) We do have a left subtree, replace the target node with the largest value in its left subtree
-//            (calling remove_max, which will delete the largest valued node)
+//            (continue down the rightmost path of the left subtree and delete the largest valued node)
 template <typename T>
-bool tree_erase(tree_node<T>*& root, const T& target, bool avl)
+bool tree_erase(tree_node<T>*& root, const T& target, bool avl, tree_pool<T>* pool)
 {
-    bool itemRemoved = false;
+    tree_path<T> path;
+    tree_node<T>** link = &root;
 
-    //case 1: item is not in the tree.
-    if(!root)
-    {
-        itemRemoved = false;
-    }
-    //case 4: we have found the item.
-    else if (root->_item == target)
+    while(*link && (*link)->_item != target)
     {
-        //case 4a: no left subtree.
-        if(!root->_left)
-        {
-            tree_node<T> * temp = root->_right;
-            delete root;
-            root = temp;
-        }
-        //case 4b: left subtree.
+        path.push(link);
+
+        //case 3: target is larger than current node
+        if((*link)->_item < target)
+            link = &(*link)->_right;
+        //case 2: target is smaller than current node
         else
-        {
-            //find the largest node in the left subtree.
-            root->_item = tree_remove_max(root->_left,avl);
-        }
-        itemRemoved = true;
+            link = &(*link)->_left;
     }
-    //case 3: target is larger than current root
-    else if (root->_item < target)
+
+    //case 1: item is not in the tree.
+    if(!*link)
+        return false;
+
+    //case 4: we have found the item.
+    tree_node<T>* found = *link;
+
+    //case 4a: no left subtree.
+    if(!found->_left)
     {
-        itemRemoved = tree_erase(root->_right, target,avl);
+        *link = found->_right;
+        tree_delete_node(pool,found);
     }
-    //case 2: target is smaller than current root
+    //case 4b: left subtree, find the largest node in the left subtree.
     else
     {
-        itemRemoved = tree_erase(root->_left, target,avl);
-    }
-
-    if(root && itemRemoved)
-        updateNode(root);
+        path.push(link);
+        link = &found->_left;
+        while((*link)->_right)
+        {
+            path.push(link);
+            link = &(*link)->_right;
+        }
 
-    if(avl)
-        root = rotate(root);
+        tree_node<T>* max = *link;
+        found->_item = max->_item;
+        *link = max->_left;
+        tree_delete_node(pool,max);
+    }
 
-    return itemRemoved;
+    tree_retrace(path, -1, avl);
+    return true;
 }
 
 //preconditions: none
 //postconditions: erase rightmost node from the tree,  store the item in max_value
 template <typename T>
-void tree_remove_max(tree_node<T>* &root, T& max_value, bool avl)
+void tree_remove_max(tree_node<T>* &root, T& max_value, bool avl, tree_pool<T>* pool)
 {
     if(!root)
-    {
         return;
-    }
-    else if(root->_right)
-    {
-        tree_remove_max(root->_right,max_value,avl);
-        //decrement the _size member and update the height of the current root when returning.
-        root->update_height();
-        root->_size--;
-    }
-    else
+
+    tree_path<T> path;
+    tree_node<T>** link = &root;
+    while((*link)->_right)
     {
-        max_value = root->_item;
-        if(root->_left)
-        {
-            tree_node<T>* temp = root->_left;
-            delete root;
-            root = temp;
-        }
-        else
-        {
-            delete root;
-            root = nullptr;
-        }
+        path.push(link);
+        link = &(*link)->_right;
     }
-    if(avl)
-        root = rotate(root);
+
+    tree_node<T>* max = *link;
+    max_value = max->_item;
+    *link = max->_left;
+    tree_delete_node(pool,max);
+
+    tree_retrace(path, -1, avl);
 }
 
 //preconditions: none
@@ -391,10 +611,10 @@ void tree_remove_max(tree_node<T>* &root, T& max_value, bool avl)
 // that is returned by reference. If this is called on an empty tree, returns
 // whatever is provided by the default constructor for type T.
 template <typename T>
-T tree_remove_max(tree_node<T>* &root,bool avl)
+T tree_remove_max(tree_node<T>* &root,bool avl, tree_pool<T>* pool)
 {
     T itemRemoved = T();
-    tree_remove_max(root,itemRemoved,avl);
+    tree_remove_max(root,itemRemoved,avl,pool);
     return itemRemoved;
 }
 
@@ -402,22 +622,22 @@ T tree_remove_max(tree_node<T>* &root,bool avl)
 //postconditions: a new tree is constructed with the contents of the tree pointed to by root.
 // Recursive calls are made to tree_copy, and the leftmost leaf nodes are constructed first.
 template <typename T>
-tree_node<T>* tree_copy(tree_node<T>* root)
+tree_node<T>* tree_copy(tree_node<T>* root, tree_pool<T>* pool)
 {
-    return (root) ? new tree_node<T>(root->_item, tree_copy(root->_left), tree_copy(root->_right)) : nullptr;
+    return (root) ? tree_new_node(pool, root->_item, tree_copy(root->_left,pool), tree_copy(root->_right,pool)) : nullptr;
 }
 
 //preconditions: none
 //postconditions: the contents of src are copied to dest using recursive calls
 // to traverse src and tree_insert to add items to dest.
 template <typename T>
-void tree_add(tree_node<T>* & dest, const tree_node<T>* src, bool avl)
+void tree_add(tree_node<T>* & dest, const tree_node<T>* src, bool avl, tree_pool<T>* pool)
 {
     if(src)
     {
-        tree_add(dest,src->_left,avl);
-        tree_insert(dest, src->_item,avl);
-        tree_add(dest,src->_right,avl);
+        tree_add(dest,src->_left,avl,pool);
+        tree_insert(dest, src->_item,avl,pool);
+        tree_add(dest,src->_right,avl,pool);
     }
 }
 
@@ -428,12 +648,12 @@ void tree_add(tree_node<T>* & dest, const tree_node<T>* src, bool avl)
 // the right subarray will be distributed to the right subtree, and the left subarray to the left subarray by
 // making recursive calls that reduce the size and change the starting position of the arary.
 template <typename T>
-tree_node<T>* tree_from_sorted_list(const T* a, int size)
+tree_node<T>* tree_from_sorted_list(const T* a, int size, tree_pool<T>* pool)
 {
     if(size < 1)
         return nullptr;
 
-    return new tree_node<T>(a[size/2], tree_from_sorted_list(a,size/2), tree_from_sorted_list(a+(size/2)+1,(size-1)/2));
+    return tree_new_node(pool, a[size/2], tree_from_sorted_list(a,size/2,pool), tree_from_sorted_list(a+(size/2)+1,(size-1)/2,pool));
 }
 
 //preconditions: root != null, root->_left != null,
@@ -472,9 +692,12 @@ tree_node<T>* rotate_left(tree_node<T>* &root)
 // Case 2) Rotate right, then left: If the balance factor is 2 and our right child's balance factor is -1
 // Case 3) Rotate right: If the balance factor is 2 and our right child's balance factor is NOT -1
 // Case 4) Rotate left: If the balance factor is -2 and our left child's balance factor is NOT 1
+// Only the nodes moved by a rotation are updated, the height and size of root must be current.
 template <typename T>
 tree_node<T>* rotate(tree_node<T>* & root)
 {
+    bool rotated = false;
+
     if(root && root->_left && root->balance_factor() == -2)
     {
         //Rotate left on left child
@@ -483,6 +706,7 @@ tree_node<T>* rotate(tree_node<T>* & root)
 
         //Rotate right on root only.
         root = rotate_right(root);
+        rotated = true;
     }
     else if(root && root->_right&& root->balance_factor() == 2)
     {
@@ -492,10 +716,12 @@ tree_node<T>* rotate(tree_node<T>* & root)
 
         //Rotate left on root only.
         root = rotate_left(root);
+        rotated = true;
     }
 
-    //update the size and height of affected nodes.
-    if(root)
+    //update the size and height of the nodes moved by the rotation,
+    // an unrotated root has already been updated by the caller.
+    if(rotated)
     {
         updateNode(root->_right);
         updateNode(root->_left);
@@ -505,6 +731,34 @@ tree_node<T>* rotate(tree_node<T>* & root)
     return root;
 }
 
+//preconditions: none
+//postconditions: returns a new node holding item, its storage is drawn from pool
+// if one is provided, otherwise from the heap.
+template <typename T>
+tree_node<T>* tree_new_node(tree_pool<T>* pool, const T& item, tree_node<T>* left, tree_node<T>* right)
+{
+    if(pool)
+        return new (pool->allocate()) tree_node<T>(item, left, right);
+    else
+        return new tree_node<T>(item, left, right);
+}
+
+//preconditions: node was created by tree_new_node with the same pool.
+//postconditions: the node is destroyed and its storage returned to pool (or the heap).
+template <typename T>
+void tree_delete_node(tree_pool<T>* pool, tree_node<T>* node)
+{
+    if(pool)
+    {
+        node->~tree_node<T>();
+        pool->deallocate(node);
+    }
+    else
+    {
+        delete node;
+    }
+}
+
 //preconditions: none
 //postconditions: calls update_height() and update_size() on the node if it is not null.
 template <typename T>
@@ -517,4 +771,556 @@ void updateNode(tree_node<T>* & root)
     }
 }
 
+//preconditions: path holds the links from the root down to the parent of a node that
+// was just inserted (delta = 1) or removed (delta = -1).
+//postconditions: the path is popped back to the root. While the height of the subtree
+// below the current link keeps changing, its height and size are recomputed and, if the
+// AVL flag is true, it is rotated. Once a subtree's height is unchanged no ancestor's
+// height or balance can change, so only the sizes of the remaining ancestors are adjusted.
+template <typename T>
+void tree_retrace(tree_path<T>& path, int delta, bool avl)
+{
+    bool heightChanged = true;
+
+    while(!path.empty())
+    {
+        tree_node<T>** link = path.pop();
+
+        if(heightChanged)
+        {
+            int oldHeight = (*link)->_height;
+            updateNode(*link);
+
+            if(avl)
+                rotate(*link);
+
+            heightChanged = ((*link)->_height != oldHeight);
+        }
+        else
+        {
+            (*link)->_size += delta;
+        }
+    }
+}
+
+//preconditions: none
+//postconditions: returns the number of items in the tree that are less than key
+// (less than or equal to key if inclusive is true). The _size of the left subtree is
+// added every time the search moves right, so only one root to leaf path is visited.
+template <typename T>
+size_t tree_rank(const tree_node<T>* root, const T& key, bool inclusive)
+{
+    size_t rank = 0;
+    while(root)
+    {
+        if(root->_item < key || (inclusive && root->_item == key))
+        {
+            rank += 1 + ((root->_left) ? root->_left->_size : 0);
+            root = root->_right;
+        }
+        else
+        {
+            root = root->_left;
+        }
+    }
+    return rank;
+}
+
+//preconditions: none
+//postconditions: returns the node holding the k-th smallest item (k starts at 0),
+// or null if k >= the size of the tree. The _size of the left subtree decides which way to go.
+template <typename T>
+tree_node<T>* tree_select(tree_node<T>* root, size_t k)
+{
+    while(root)
+    {
+        size_t leftSize = (root->_left) ? root->_left->_size : 0;
+        if(k < leftSize)
+        {
+            root = root->_left;
+        }
+        else if(k == leftSize)
+        {
+            return root;
+        }
+        else
+        {
+            k -= leftSize + 1;
+            root = root->_right;
+        }
+    }
+    return nullptr;
+}
+
+//preconditions: none
+//postconditions: returns the number of items in the range [lo, hi] using two calls to tree_rank.
+template <typename T>
+size_t tree_count_range(const tree_node<T>* root, const T& lo, const T& hi)
+{
+    if(hi < lo)
+        return 0;
+    return tree_rank(root, hi, true) - tree_rank(root, lo);
+}
+
+//preconditions: none
+//postconditions: visit(item) is called on every item in the range [lo, hi] in ascending order.
+// Subtrees entirely below lo are skipped, the walk stops at the first item above hi.
+// The links of the nodes still to be visited are kept on a tree_path instead of the call stack.
+template <typename T, typename Visitor>
+void tree_range(tree_node<T>* root, const T& lo, const T& hi, Visitor visit)
+{
+    tree_path<T> path;
+    tree_node<T>** link = &root;
+
+    while(*link || !path.empty())
+    {
+        while(*link)
+        {
+            if((*link)->_item < lo)
+            {
+                link = &(*link)->_right;
+            }
+            else
+            {
+                path.push(link);
+                link = &(*link)->_left;
+            }
+        }
+
+        if(path.empty())
+            return;
+
+        tree_node<T>* node = *path.pop();
+        if(hi < node->_item)
+            return;
+        visit(node->_item);
+        link = &node->_right;
+    }
+}
+
+//preconditions: out has room for the size of the tree.
+//postconditions: the items of the tree are copied to out in ascending order, the count is returned.
+template <typename T>
+size_t tree_flatten(tree_node<T>* root, T* out)
+{
+    size_t count = 0;
+    tree_path<T> path;
+    tree_node<T>** link = &root;
+
+    while(*link || !path.empty())
+    {
+        while(*link)
+        {
+            path.push(link);
+            link = &(*link)->_left;
+        }
+        tree_node<T>* node = *path.pop();
+        out[count++] = node->_item;
+        link = &node->_right;
+    }
+    return count;
+}
+
+//preconditions: none
+//postconditions: returns a new tree holding a (op) b, the inputs are not modified.
+// Both trees are flattened in order, merged in O(n+m) and the result is built
+// with tree_from_sorted_list, so no rotation is ever needed.
+template <typename T>
+tree_node<T>* tree_set_operation(tree_node<T>* a, tree_node<T>* b, tree_set_op op, tree_pool<T>* pool)
+{
+    size_t n = (a) ? a->_size : 0;
+    size_t m = (b) ? b->_size : 0;
+    T* x = new T[n];
+    T* y = new T[m];
+    T* merged = new T[n + m];
+    size_t i = 0, j = 0, k = 0;
+
+    tree_flatten(a, x);
+    tree_flatten(b, y);
+
+    while(i < n && j < m)
+    {
+        if(x[i] < y[j])
+        {
+            if(op != TREE_INTERSECTION)
+                merged[k++] = x[i];
+            i++;
+        }
+        else if(y[j] < x[i])
+        {
+            if(op == TREE_UNION)
+                merged[k++] = y[j];
+            j++;
+        }
+        else
+        {
+            if(op != TREE_DIFFERENCE)
+                merged[k++] = x[i];
+            i++;
+            j++;
+        }
+    }
+    if(op != TREE_INTERSECTION)
+        while(i < n)
+            merged[k++] = x[i++];
+    if(op == TREE_UNION)
+        while(j < m)
+            merged[k++] = y[j++];
+
+    tree_node<T>* result = tree_from_sorted_list(merged, int(k), pool);
+    delete [] x;
+    delete [] y;
+    delete [] merged;
+    return result;
+}
+
+//preconditions: left and right are AVL trees, every item of left < mid->_item < every item of right.
+//postconditions: mid is used as the root of a joined AVL tree holding left, mid and right,
+// the new root is returned. The spine of the taller tree is followed down to a subtree whose
+// height is within one of the shorter tree, mid is placed there and the spine is rotated on the way back.
+template <typename T>
+tree_node<T>* tree_join(tree_node<T>* left, tree_node<T>* mid, tree_node<T>* right)
+{
+    int leftHeight = (left) ? left->_height : -1;
+    int rightHeight = (right) ? right->_height : -1;
+
+    if(leftHeight > rightHeight + 1)
+    {
+        left->_right = tree_join(left->_right, mid, right);
+        updateNode(left);
+        return rotate(left);
+    }
+    else if(rightHeight > leftHeight + 1)
+    {
+        right->_left = tree_join(left, mid, right->_left);
+        updateNode(right);
+        return rotate(right);
+    }
+
+    mid->_left = left;
+    mid->_right = right;
+    updateNode(mid);
+    return mid;
+}
+
+//preconditions: root is an AVL tree.
+//postconditions: root is split into the AVL trees left (items < key) and right (items > key).
+// The node equal to key is detached and returned, or null is returned if key is not in the tree.
+// The side of the root away from key is joined back with the root as the middle node.
+template <typename T>
+tree_node<T>* tree_split(tree_node<T>* root, const T& key, tree_node<T>* &left, tree_node<T>* &right)
+{
+    if(!root)
+    {
+        left = right = nullptr;
+        return nullptr;
+    }
+
+    tree_node<T>* rootLeft = root->_left;
+    tree_node<T>* rootRight = root->_right;
+    tree_node<T>* found;
+
+    if(key < root->_item)
+    {
+        tree_node<T>* splitRight;
+        found = tree_split(rootLeft, key, left, splitRight);
+        right = tree_join(splitRight, root, rootRight);
+    }
+    else if(root->_item < key)
+    {
+        tree_node<T>* splitLeft;
+        found = tree_split(rootRight, key, splitLeft, right);
+        left = tree_join(rootLeft, root, splitLeft);
+    }
+    else
+    {
+        left = rootLeft;
+        right = rootRight;
+        root->_left = root->_right = nullptr;
+        updateNode(root);
+        found = root;
+    }
+    return found;
+}
+
+//preconditions: root is a non-empty AVL tree.
+//postconditions: the rightmost node is detached and returned by ref as last,
+// the rebalanced remainder of the tree is returned.
+template <typename T>
+tree_node<T>* tree_split_last(tree_node<T>* root, tree_node<T>* &last)
+{
+    if(!root->_right)
+    {
+        last = root;
+        tree_node<T>* rest = root->_left;
+        root->_left = nullptr;
+        updateNode(root);
+        return rest;
+    }
+    root->_right = tree_split_last(root->_right, last);
+    updateNode(root);
+    return rotate(root);
+}
+
+//preconditions: left and right are AVL trees, every item of left < every item of right.
+//postconditions: returns an AVL tree holding both, the largest node of left is used as the middle node.
+template <typename T>
+tree_node<T>* tree_join(tree_node<T>* left, tree_node<T>* right)
+{
+    if(!left)
+        return right;
+
+    tree_node<T>* last;
+    left = tree_split_last(left, last);
+    return tree_join(left, last, right);
+}
+
+//preconditions: see tree_set_join.
+//postconditions: returns a (op) b, every subtree or node that is dropped is pushed onto garbage
+// instead of being freed, so no thread touches the pool.
+template <typename T>
+tree_node<T>* tree_set_join(tree_node<T>* a, tree_node<T>* b, tree_set_op op, vector<tree_node<T>*>& garbage, int parallelDepth)
+{
+    if(!a || !b)
+    {
+        if(op == TREE_UNION)
+            return (a) ? a : b;
+        if(b)
+            garbage.push_back(b);
+        if(op == TREE_INTERSECTION && a)
+        {
+            garbage.push_back(a);
+            return nullptr;
+        }
+        return a;
+    }
+
+    tree_node<T>* bLeft = b->_left;
+    tree_node<T>* bRight = b->_right;
+    tree_node<T>* aLeft;
+    tree_node<T>* aRight;
+    tree_node<T>* found = tree_split(a, b->_item, aLeft, aRight);
+    tree_node<T>* left;
+    tree_node<T>* right;
+
+    b->_left = b->_right = nullptr;
+    updateNode(b);
+
+    //the two halves share no nodes, so they can be processed independently.
+    if(parallelDepth > 0)
+    {
+        vector<tree_node<T>*> leftGarbage;
+        thread worker([&]() { left = tree_set_join(aLeft, bLeft, op, leftGarbage, parallelDepth - 1); });
+        right = tree_set_join(aRight, bRight, op, garbage, parallelDepth - 1);
+        worker.join();
+        garbage.insert(garbage.end(), leftGarbage.begin(), leftGarbage.end());
+    }
+    else
+    {
+        left = tree_set_join(aLeft, bLeft, op, garbage, 0);
+        right = tree_set_join(aRight, bRight, op, garbage, 0);
+    }
+
+    if(op == TREE_UNION)
+    {
+        if(found)
+        {
+            garbage.push_back(b);
+            return tree_join(left, found, right);
+        }
+        return tree_join(left, b, right);
+    }
+
+    garbage.push_back(b);
+    if(op == TREE_INTERSECTION && found)
+        return tree_join(left, found, right);
+
+    if(found)
+        garbage.push_back(found);
+    return tree_join(left, right);
+}
+
+//preconditions: a and b are AVL trees drawn from pool.
+//postconditions: returns a (op) b built by splitting a around the root of b and joining
+// the results of the two halves, which costs O(m log(n/m + 1)) for m = the smaller size.
+// Both trees are consumed, discarded nodes are returned to pool. If parallelDepth > 0, the
+// left halves of the top parallelDepth levels are processed by their own threads.
+template <typename T>
+tree_node<T>* tree_set_join(tree_node<T>* a, tree_node<T>* b, tree_set_op op, tree_pool<T>* pool, int parallelDepth)
+{
+    vector<tree_node<T>*> garbage;
+    tree_node<T>* result = tree_set_join(a, b, op, garbage, parallelDepth);
+
+    for(size_t i = 0; i < garbage.size(); i++)
+        tree_clear(garbage[i], pool);
+    return result;
+}
+
+//preconditions: the heights of left and right differ by at most 2.
+//postconditions: returns a new node holding item over left and right, rotated once or twice
+// (building new nodes instead of relinking old ones) if the heights differ by 2.
+template <typename T>
+typename persistent_node<T>::ptr tree_persistent_balance(const T& item, const typename persistent_node<T>::ptr& left, const typename persistent_node<T>::ptr& right)
+{
+    typedef persistent_node<T> node;
+    typedef typename node::ptr ptr;
+
+    int leftHeight = (left) ? left->_height : -1;
+    int rightHeight = (right) ? right->_height : -1;
+
+    if(leftHeight > rightHeight + 1)
+    {
+        int outer = (left->_left) ? left->_left->_height : -1;
+        int inner = (left->_right) ? left->_right->_height : -1;
+        if(outer >= inner)
+            return make_shared<const node>(left->_item, left->_left, make_shared<const node>(item, left->_right, right));
+
+        const ptr& pivot = left->_right;
+        return make_shared<const node>(pivot->_item,
+                                       make_shared<const node>(left->_item, left->_left, pivot->_left),
+                                       make_shared<const node>(item, pivot->_right, right));
+    }
+
+    if(rightHeight > leftHeight + 1)
+    {
+        int outer = (right->_right) ? right->_right->_height : -1;
+        int inner = (right->_left) ? right->_left->_height : -1;
+        if(outer >= inner)
+            return make_shared<const node>(right->_item, make_shared<const node>(item, left, right->_left), right->_right);
+
+        const ptr& pivot = right->_left;
+        return make_shared<const node>(pivot->_item,
+                                       make_shared<const node>(item, left, pivot->_left),
+                                       make_shared<const node>(right->_item, pivot->_right, right->_right));
+    }
+
+    return make_shared<const node>(item, left, right);
+}
+
+//preconditions: none
+//postconditions: the recursion descends to the insertion point, then every node on the way
+// back up is rebuilt by tree_persistent_balance over the new child and the shared sibling.
+template <typename T>
+typename persistent_node<T>::ptr tree_persistent_insert(const typename persistent_node<T>::ptr& root, const T& insert_me, bool& inserted)
+{
+    typedef typename persistent_node<T>::ptr ptr;
+
+    if(!root)
+    {
+        inserted = true;
+        return make_shared<const persistent_node<T> >(insert_me, ptr(), ptr());
+    }
+
+    if(insert_me < root->_item)
+    {
+        ptr left = tree_persistent_insert(root->_left, insert_me, inserted);
+        return (inserted) ? tree_persistent_balance(root->_item, left, root->_right) : root;
+    }
+    if(root->_item < insert_me)
+    {
+        ptr right = tree_persistent_insert(root->_right, insert_me, inserted);
+        return (inserted) ? tree_persistent_balance(root->_item, root->_left, right) : root;
+    }
+
+    inserted = false;
+    return root;
+}
+
+//preconditions: root is not null.
+//postconditions: returns root without its smallest item, which is returned by reference.
+template <typename T>
+typename persistent_node<T>::ptr tree_persistent_remove_min(const typename persistent_node<T>::ptr& root, T& min_value)
+{
+    if(!root->_left)
+    {
+        min_value = root->_item;
+        return root->_right;
+    }
+    return tree_persistent_balance(root->_item, tree_persistent_remove_min(root->_left, min_value), root->_right);
+}
+
+//preconditions: none
+//postconditions: the node holding target is replaced by its right subtree without its
+// successor (the successor takes its place), the path back up is rebuilt and rebalanced.
+template <typename T>
+typename persistent_node<T>::ptr tree_persistent_erase(const typename persistent_node<T>::ptr& root, const T& target, bool& erased)
+{
+    typedef typename persistent_node<T>::ptr ptr;
+
+    if(!root)
+    {
+        erased = false;
+        return root;
+    }
+
+    if(target < root->_item)
+    {
+        ptr left = tree_persistent_erase(root->_left, target, erased);
+        return (erased) ? tree_persistent_balance(root->_item, left, root->_right) : root;
+    }
+    if(root->_item < target)
+    {
+        ptr right = tree_persistent_erase(root->_right, target, erased);
+        return (erased) ? tree_persistent_balance(root->_item, root->_left, right) : root;
+    }
+
+    erased = true;
+    if(!root->_left)
+        return root->_right;
+    if(!root->_right)
+        return root->_left;
+
+    T successor;
+    ptr right = tree_persistent_remove_min(root->_right, successor);
+    return tree_persistent_balance(successor, root->_left, right);
+}
+
+//preconditions: none
+//postconditions: an iterative binary search, returns the item equal to target or null.
+template <typename T>
+const T* tree_persistent_search(const persistent_node<T>* root, const T& target)
+{
+    while(root)
+    {
+        if(target < root->_item)
+            root = root->_left.get();
+        else if(root->_item < target)
+            root = root->_right.get();
+        else
+            return &root->_item;
+    }
+    return nullptr;
+}
+
+//preconditions: none
+//postconditions: an iterative in order walk that skips the subtrees below lo and stops at the
+// first item above hi, visit is called on the items in between.
+template <typename T, typename Visitor>
+void tree_persistent_range(const persistent_node<T>* root, const T& lo, const T& hi, Visitor visit)
+{
+    vector<const persistent_node<T>*> path;
+    while(root || !path.empty())
+    {
+        while(root)
+        {
+            if(root->_item < lo)
+            {
+                root = root->_right.get();
+            }
+            else
+            {
+                path.push_back(root);
+                root = root->_left.get();
+            }
+        }
+
+        const persistent_node<T>* next = path.back();
+        path.pop_back();
+        if(hi < next->_item)
+            return;
+        visit(next->_item);
+        root = next->_right.get();
+    }
+}
+
 #endif // BST_FUNCTIONS_H
@@ -0,0 +1,302 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <cstdlib>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+//A buffer pool over a file of fixed size pages. A fixed number of frames cache pages in memory,
+// a page is pinned while it is used and a pinned frame is never evicted. When a page is missing
+// the CLOCK hand sweeps the frames: a referenced frame gets a second chance (its bit is cleared),
+// the first unpinned frame without the bit is the victim, and it is written back only if dirty.
+// A read or write of the file that fails is reported to the caller: pin and allocate return null
+// and flush returns false. A frame whose write back failed stays dirty and resident, so its page
+// is never dropped, and the next eviction or flush tries it again.
+class BufferPool
+{
+public:
+    BufferPool(const string& path, size_t pageBytes, size_t frames); //the file is created or truncated.
+    ~BufferPool();                                                     //flush and close the file.
+
+    //the pool owns a file and the frames that cache it.
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    void* pin(uint64_t page);               //the frame holding the page, read from the file if needed, null on failure.
+    void unpin(uint64_t page, bool dirty);  //release a pin, dirty if the frame was modified.
+    void* allocate(uint64_t& page);         //append a zeroed page to the file and pin it, null on failure.
+    bool flush();                           //write back every dirty frame, false if a write failed.
+
+    //preconditions: none
+    //postconditions: returns true if the file was opened.
+    inline bool is_open() const
+    {
+        return _file.is_open();
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of pages in the file.
+    inline uint64_t pages() const
+    {
+        return _pageCount;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of frames.
+    inline size_t frames() const
+    {
+        return _frames.size();
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of pins that found their page in a frame.
+    inline size_t hits() const
+    {
+        return _hits;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of pages read from the file.
+    inline size_t reads() const
+    {
+        return _reads;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of pages written to the file.
+    inline size_t writes() const
+    {
+        return _writes;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of reads and writes of the file that failed.
+    inline size_t failures() const
+    {
+        return _failures;
+    }
+
+private:
+    static const size_t NO_FRAME = ~size_t(0);     //returned by victim when no frame could be freed.
+
+    struct frame
+    {
+        uint64_t _page;
+        uint32_t _pins;
+        bool _valid;        //the frame holds a page.
+        bool _dirty;        //the frame differs from the file.
+        bool _referenced;   //used since the hand last passed.
+    };
+
+    fstream _file;
+    size_t _pageBytes;
+    vector<frame> _frames;
+    uint64_t* _memory;                          //frame i starts at byte i * _pageBytes.
+    unordered_map<uint64_t, size_t> _resident;  //page to frame.
+    size_t _hand;
+    uint64_t _pageCount;
+    size_t _hits;
+    size_t _reads;
+    size_t _writes;
+    size_t _failures;
+
+    size_t victim();                    //a free or evicted frame chosen by CLOCK, NO_FRAME on failure.
+    bool write_back(size_t f);          //write the frame to its page, false if the write failed.
+
+    //preconditions: f < frames()
+    //postconditions: returns the memory of frame f.
+    inline char* data(size_t f) const
+    {
+        return reinterpret_cast<char*>(_memory) + f * _pageBytes;
+    }
+};
+
+//preconditions: frames > 0
+//postconditions: an empty file is opened, every frame is free. Pages are rounded up to 8 bytes
+// so every frame is aligned for the records stored in it. If the file could not be created
+// is_open() is false, and every page that has to be written or read back fails.
+inline BufferPool::BufferPool(const string& path, size_t pageBytes, size_t frames)
+{
+    assert(frames > 0);
+    //unbuffered, so a page write reaches the file before its frame counts as clean, and a failed
+    // write is reported for that page rather than for a later one that flushes the buffer.
+    _file.rdbuf()->pubsetbuf(nullptr, 0);
+    _file.open(path, ios::in | ios::out | ios::binary | ios::trunc);
+
+    _pageBytes = (pageBytes + 7) & ~size_t(7);
+    _frames.resize(frames);
+    for(size_t i = 0; i < frames; i++)
+    {
+        _frames[i]._pins = 0;
+        _frames[i]._valid = false;
+        _frames[i]._dirty = false;
+        _frames[i]._referenced = false;
+    }
+    _memory = new uint64_t[frames * _pageBytes / 8];
+    _hand = 0;
+    _pageCount = 0;
+    _hits = 0;
+    _reads = 0;
+    _writes = 0;
+    _failures = 0;
+}
+
+//preconditions: no page is pinned.
+//postconditions: every dirty frame is written back, the file is closed and the frames deallocated.
+// Call flush first to learn whether the writes succeeded.
+inline BufferPool::~BufferPool()
+{
+    flush();
+    _file.close();
+    delete [] _memory;
+}
+
+//preconditions: page < pages()
+//postconditions: the page is pinned and its frame returned, a missing page is read into the frame
+// chosen by victim(). The frame stays valid until the matching unpin. Returns null, with nothing
+// pinned, if no frame could be freed or the page could not be read in full.
+inline void* BufferPool::pin(uint64_t page)
+{
+    assert(page < _pageCount);
+    unordered_map<uint64_t, size_t>::iterator it = _resident.find(page);
+    if(it != _resident.end())
+    {
+        frame& f = _frames[it->second];
+        f._pins++;
+        f._referenced = true;
+        _hits++;
+        return data(it->second);
+    }
+
+    size_t f = victim();
+    if(f == NO_FRAME)
+        return nullptr;
+    _file.seekg(streamoff(page * _pageBytes));
+    _file.read(data(f), streamsize(_pageBytes));
+    if(!_file)
+    {
+        _file.clear();      //the frame stays free, later pins may still succeed.
+        _failures++;
+        return nullptr;
+    }
+    _reads++;
+
+    _frames[f]._page = page;
+    _frames[f]._pins = 1;
+    _frames[f]._valid = true;
+    _frames[f]._dirty = false;
+    _frames[f]._referenced = true;
+    _resident[page] = f;
+    return data(f);
+}
+
+//preconditions: the page is pinned.
+//postconditions: one pin is released, the frame is marked dirty if the caller modified it.
+inline void BufferPool::unpin(uint64_t page, bool dirty)
+{
+    unordered_map<uint64_t, size_t>::iterator it = _resident.find(page);
+    assert(it != _resident.end());
+    frame& f = _frames[it->second];
+    assert(f._pins > 0);
+    f._pins--;
+    f._dirty = f._dirty || dirty;
+}
+
+//preconditions: none
+//postconditions: a new page is appended to the file and pinned in a zeroed, dirty frame, its number
+// is returned by ref and the frame is returned. It reaches the file when it is evicted or flushed,
+// it is never read before that. Returns null, without adding a page, if no frame could be freed.
+inline void* BufferPool::allocate(uint64_t& page)
+{
+    size_t f = victim();
+    if(f == NO_FRAME)
+        return nullptr;
+    page = _pageCount++;
+    memset(data(f), 0, _pageBytes);
+
+    _frames[f]._page = page;
+    _frames[f]._pins = 1;
+    _frames[f]._valid = true;
+    _frames[f]._dirty = true;
+    _frames[f]._referenced = true;
+    _resident[page] = f;
+    return data(f);
+}
+
+//preconditions: none
+//postconditions: every dirty frame is written back and becomes clean. Returns false if a write
+// failed, the frames it could not write stay dirty.
+inline bool BufferPool::flush()
+{
+    bool written = true;
+    for(size_t f = 0; f < _frames.size(); f++)
+        if(_frames[f]._valid && _frames[f]._dirty && !write_back(f))
+            written = false;
+    if(!_file.flush())
+    {
+        _file.clear();
+        _failures++;
+        written = false;
+    }
+    return written;
+}
+
+//preconditions: at least one frame is unpinned.
+//postconditions: returns a free frame, or evicts the page of the first unpinned frame the hand
+// reaches without its referenced bit (clearing the bits it passes), writing it back if dirty.
+// Returns NO_FRAME, evicting nothing, if that write back failed.
+inline size_t BufferPool::victim()
+{
+    for(size_t sweep = 0; sweep < 2 * _frames.size() + 1; sweep++)
+    {
+        size_t f = _hand;
+        _hand = (_hand + 1 == _frames.size()) ? 0 : _hand + 1;
+
+        frame& candidate = _frames[f];
+        if(!candidate._valid)
+            return f;
+        if(candidate._pins > 0)
+            continue;
+        if(candidate._referenced)
+        {
+            candidate._referenced = false;
+            continue;
+        }
+
+        if(candidate._dirty && !write_back(f))
+            return NO_FRAME;
+        _resident.erase(candidate._page);
+        candidate._valid = false;
+        return f;
+    }
+
+    assert(false && "every frame of the buffer pool is pinned");
+    return NO_FRAME;
+}
+
+//preconditions: frame f is valid.
+//postconditions: the frame is written to its page in the file and is clean, true is returned.
+// If the write failed the frame stays dirty and false is returned.
+inline bool BufferPool::write_back(size_t f)
+{
+    _file.seekp(streamoff(_frames[f]._page * _pageBytes));
+    _file.write(data(f), streamsize(_pageBytes));
+    if(!_file)
+    {
+        _file.clear();
+        _failures++;
+        return false;
+    }
+    _frames[f]._dirty = false;
+    _writes++;
+    return true;
+}
+
+#endif // BUFFER_POOL_H
@@ -3,32 +3,77 @@
 
 #include <cstdlib>
 #include <cassert>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
 #include <record.h>
+#include "prefetch.h"
+#include "hash_functions.h"
 #include "avl.h"
+#include "adaptive_bucket.h"
+#include "avl_bucket.h"
+#include "compact_bucket.h"
+#include "block_bucket.h"
+#include "frozen_bucket.h"
+#include "perfecthash.h"
 
 using namespace std;
 
-template <typename T>
+//The bucket container is a policy: AdaptiveBucket (default), AVLBucket, CompactBucket or BlockBucket.
+// A policy provides a pool_type shared by every bucket of the table, BULK_RELEASE, and
+// insert / erase / search / clear / copy / flatten / print / empty, each taking the pool, and tree,
+// the root of a tree_node tree holding the records or null.
+template <typename T, typename Bucket = AdaptiveBucket<T> >
 class ChainedHash
 {
     //note: this typename is different so that the definition and implementation can be seperated.
-    template <typename TT>
-    friend ostream& operator<<(ostream& outs, const ChainedHash<TT>& table);
+    template <typename TT, typename BB>
+    friend ostream& operator<<(ostream& outs, const ChainedHash<TT, BB>& table);
+
+    //a table builds the frozen copy of itself.
+    template <typename TT, typename BB>
+    friend class ChainedHash;
 
 public:
     ChainedHash();                                          // cstr: set _capacity to 17
-    ChainedHash(size_t maxCapacity);                        // cstr : set _capacity to maxCapacity
+    ChainedHash(size_t maxCapacity, bool twoChoices = false); // cstr : set _capacity to maxCapacity
 
     //big 3
     ~ChainedHash();
-    ChainedHash<T>& operator=(const ChainedHash<T>& other);
-    ChainedHash(const ChainedHash<T>& other);
+    ChainedHash<T, Bucket>& operator=(const ChainedHash<T, Bucket>& other);
+    ChainedHash(const ChainedHash<T, Bucket>& other);
 
     bool insert(const T& entry);                //returns true if the record inserted, otherwise false.
     bool remove(int key);                       //returns true if the record with the key was removed, otherwise false.
     bool is_present(int key);                   //returns true if the key exists, otherwise false.
+    void is_present(const int* keys, size_t count, bool* present); //look up a batch of keys, interleaving their walks.
     void find(int key, bool& found, T& result); //returns found = true, result = record with key if the key exists.
 
+    void enable_sorted_index();                 //maintain a sorted index of every record from now on.
+    size_t count_range(int lo, int hi) const;   //returns the number of keys in [lo, hi], requires the sorted index.
+    template <typename Visitor>
+    void range(int lo, int hi, Visitor visit) const; //visit the records with keys in [lo, hi] in key order.
+
+    void enable_linear_hashing(double maxLoad = 1.0); //grow one bucket at a time past maxLoad records per bucket.
+
+    ChainedHash<T, FrozenBucket<T> > freeze() const; //a read-only copy whose buckets are Eytzinger arrays.
+    PerfectHash<T> freeze_perfect() const;      //a read-only copy over a minimal perfect hash.
+    size_t longest_bucket() const;              //returns the number of records in the fullest bucket.
+
+    //preconditions: none
+    //postconditions: returns true if the sorted index is maintained.
+    inline bool has_sorted_index() const
+    {
+        return _indexed;
+    }
+
+    //preconditions: none
+    //postconditions: returns true if the table grows by linear hashing.
+    inline bool linear_hashing() const
+    {
+        return _linear;
+    }
+
     //preconditions: none
     //postconditions: returns the current _size.
     inline size_t size() const
@@ -37,135 +82,414 @@ public:
     }
 
     //preconditions: none
-    //postconditions: returns the _capacity
+    //postconditions: returns the number of buckets, _capacity until linear hashing splits a bucket.
     inline size_t capacity() const
     {
-        return _capacity;
+        return bucket_count(_table);
+    }
+
+    //preconditions: none
+    //postconditions: returns the bucket of the key in the current buckets, so operations can be
+    // ordered by the part of the table they touch.
+    inline size_t home(int key) const
+    {
+        return hash(_table, key);
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of new keys the table accepts before an insert fails,
+    // chains grow without bound so there is no such limit.
+    inline size_t room() const
+    {
+        return ~size_t(0);
+    }
+
+    //preconditions: none
+    //postconditions: returns true if every key has two candidate buckets.
+    inline bool two_choices() const
+    {
+        return _twoChoices;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of times flooding was detected and the table reseeded.
+    inline size_t reseeds() const
+    {
+        return _reseeds;
+    }
+
+    //preconditions: none
+    //postconditions: returns the bytes the shared pool of the buckets has reserved.
+    inline size_t pool_bytes() const
+    {
+        return _pool.reserved();
     }
 
 private:
-    AVL<T> **_data; //dynamic array of avls.
+    typedef Bucket bucket_type;
+    typedef typename Bucket::pool_type pool_type;
+
+    //The buckets of one hash function and their loads. They are stored in a directory of equal
+    // segments, so growing appends a segment and never moves a bucket. Buckets are addressed by
+    // linear hashing: there are (_capacity << level) + split of them, a key whose address modulo
+    // _capacity << level falls below split has been split and uses _capacity << (level + 1).
+    struct bucket_array
+    {
+        vector<bucket_type*> segments;
+        vector<uint32_t*> loads;    //number of records per bucket, segmented like the buckets.
+        table_hash hash;
+        size_t level;
+        size_t split;               //the next bucket to split.
+    };
+
     size_t _size;
-    size_t _capacity;
+    size_t _capacity;       //the number of buckets before any split.
+    size_t _segmentShift;   //a segment holds 1 << _segmentShift buckets.
+    bucket_array _table;
+
+    static const size_t SLAB_SIZE = 1024; //nodes per slab of the index pool.
+    static const size_t MAX_SEGMENT_SHIFT = 10;
+    pool_type _pool;        //one arena shared by every bucket.
+    tree_pool<T> _indexPool;//the arena of the sorted index.
+    tree_node<T>* _index;   //root of the sorted secondary index over every record.
+    bool _indexed;          //true if _index is maintained.
+    bool _twoChoices;       //true if a key is placed in the less loaded of hash and hash2.
+    bool _linear;           //true if a bucket is split whenever the load exceeds _maxLoad.
+    double _maxLoad;
+
+    static const size_t MIGRATE_STEP = 16;  //records (or empty buckets) of _old moved per insert and remove.
+    bool _rehashing;        //true while _old holds the buckets left behind by a reseed.
+    bucket_array _old;
+    size_t _migrated;       //buckets of _old already moved to _table.
+    vector<T> _moving;      //records of bucket _migrated of _old not moved yet, they are still in that bucket.
+    size_t _reseeds;
+
+    //helper function to be used by constructors, destructor and assignment operator.
+    void allocateArray();
+    void clearArray(bool clearBuckets);
+    void copyArray(const ChainedHash<T, Bucket>& other);
+
+    void shape(bucket_array& a, size_t level, size_t split);    //allocate the segments of that many buckets.
+    void release(bucket_array& a, bool clearBuckets);           //deallocate every segment.
+
+    //preconditions: none
+    //postconditions: returns the number of buckets of a.
+    inline size_t bucket_count(const bucket_array& a) const
+    {
+        return (_capacity << a.level) + a.split;
+    }
+
+    //preconditions: i < bucket_count(a)
+    //postconditions: returns bucket i of a.
+    inline bucket_type& bucket(const bucket_array& a, size_t i) const
+    {
+        return a.segments[i >> _segmentShift][i & ((size_t(1) << _segmentShift) - 1)];
+    }
+
+    //preconditions: i < bucket_count(a)
+    //postconditions: returns the number of records in bucket i of a.
+    inline uint32_t& load(const bucket_array& a, size_t i) const
+    {
+        return a.loads[i >> _segmentShift][i & ((size_t(1) << _segmentShift) - 1)];
+    }
 
-    //helper function to be used by copy constructor and assignment operator.
-    void copyArray(const AVL<T> ** copyFrom, AVL<T> **& copyTo, const size_t & copyFromSize);
+    //preconditions: none
+    //postconditions: returns the bucket of a 32 bit hash in a by linear hashing.
+    inline size_t address(const bucket_array& a, uint32_t h) const
+    {
+        size_t index = h % (_capacity << a.level);
+        if(index < a.split)
+            index = h % (_capacity << (a.level + 1));
+        return index;
+    }
+
+    //preconditions: none
+    //postconditions: returns the bucket of the key in a, key % _capacity until the table is seeded
+    // or split.
+    inline size_t hash(const bucket_array& a, int key) const
+    {
+        return address(a, (a.hash.seeded()) ? uint32_t(a.hash.keyed(key)) : uint32_t(key));
+    }
 
-    inline size_t hash(int key) const
+    //preconditions: none
+    //postconditions: returns the second candidate bucket in a, a multiplicative (Fibonacci) hash
+    // that is independent of key % _capacity, or the high half of the keyed hash once seeded.
+    inline size_t hash2(const bucket_array& a, int key) const
     {
-        return key % _capacity;
+        if(a.hash.seeded())
+            return address(a, uint32_t(a.hash.keyed(key) >> 32));
+        return address(a, uint32_t((uint64_t(uint32_t(key)) * 0x9E3779B97F4A7C15ULL) >> 32));
     }
+
+    //preconditions: none
+    //postconditions: returns the record with the key from the current buckets, or from the buckets
+    // being rehashed, or null.
+    T* search(int key);
+
+    //preconditions: none
+    //postconditions: returns the record with the key from its bucket of a (or from either of its two
+    // candidate buckets), or null. Both candidate buckets are prefetched before either is read.
+    T* search_in(const bucket_array& a, int key);
+
+    static const size_t IN_FLIGHT = 16;     //lookups of a batch whose bucket walks are interleaved.
+
+    //a lookup of a batch, waiting for the bucket or tree node it prefetched.
+    struct in_flight
+    {
+        size_t _at;             //the position of the key in the batch.
+        size_t _stage;          //the next candidate bucket, see candidate.
+        bucket_type* _bucket;   //the bucket visited next, when _node is null.
+        tree_node<T>* _node;    //the tree node visited next.
+    };
+    bucket_type* candidate(int key, size_t& stage) const;      //the next bucket a lookup searches, or null.
+    void start_lookup(in_flight& l, int key) const;             //prefetch the first bucket of the key.
+    bool visit(in_flight& l, int key, bool* present);           //one step, returns true once the lookup is over.
+
+    bool erase_in(bucket_array& a, int key);    //true if the key was erased.
+    size_t place_index(int key) const;          //the bucket of _table a new key goes to.
+    void split_bucket();                        //split the bucket at the split pointer of _table.
+    void reseed();                              //switch to a new seeded hash and start rehashing.
+    void migrate_step();                        //move the next MIGRATE_STEP records of _old.
 };
 
 //preconditions: none
 //postconditions: the hash table will be printed to the recieved output stream.
-template <typename TT>
-ostream& operator<<(ostream& outs, const ChainedHash<TT>& table)
+template <typename TT, typename BB>
+ostream& operator<<(ostream& outs, const ChainedHash<TT, BB>& table)
 {
-    for(size_t i = 0; i < table._capacity; i++)
+    for(size_t i = 0; i < table.bucket_count(table._table); i++)
     {
         outs << "[" << setfill('0') << setw(3) << i << "] " << setfill(' ') << endl;
 
-        //print the AVL if at least one item is stored there
-        if(table._data[i]->size() > 0)
+        //print the bucket if at least one item is stored there
+        if(!table.bucket(table._table, i).empty())
         {
-            outs << *table._data[i]  << endl;
+            table.bucket(table._table, i).print(outs, table._pool);
+            outs << endl << endl;
         }
         outs << endl << endl;
     }
 
+    //records still waiting in the buckets being rehashed.
+    if(table._rehashing)
+    {
+        outs << "rehashing:" << endl;
+        for(size_t i = table._migrated; i < table.bucket_count(table._old); i++)
+            if(!table.bucket(table._old, i).empty())
+            {
+                table.bucket(table._old, i).print(outs, table._pool);
+                outs << endl << endl;
+            }
+    }
+
     return outs;
 }
 
 //preconditions: none
 //postconditions: constructs a new ChainedHash object with the default _capacity (17)
-// initialize _data to be an array of AVL pointers, then allocate each AVL.
-template<typename T>
-ChainedHash<T>::ChainedHash()
+// initialize _table to hold _capacity empty buckets, no bucket allocates anything until it overflows.
+// every bucket draws its nodes from the shared pool.
+template<typename T, typename Bucket>
+ChainedHash<T, Bucket>::ChainedHash(): _indexPool(SLAB_SIZE)
 {
     _size = 0;
     _capacity = 17;
-    _data = new AVL<T>*[_capacity]; //allocate an array of AVL pointers.
-
-    for(size_t i = 0; i < _capacity; i++)
-        _data[i] = new AVL<T>();
+    _twoChoices = false;
+    allocateArray();
 }
 
 //preconditions: none
 //postconditions: constructs a new ChainedHash object with the recieved capacity.
-// initialize _data to be an array of AVL pointers, then allocate each AVL.
-template<typename T>
-ChainedHash<T>::ChainedHash(size_t maxCapacity)
+// initialize _table to hold _capacity empty buckets, no bucket allocates anything until it overflows.
+// every bucket draws its nodes from the shared pool. If twoChoices is true, every key may live in
+// hash(key) or hash2(key) and is inserted into the less loaded one, which bounds the deepest
+// bucket by O(log log n) instead of the O(log n / log log n) of a single choice.
+template<typename T, typename Bucket>
+ChainedHash<T, Bucket>::ChainedHash(size_t maxCapacity, bool twoChoices): _indexPool(SLAB_SIZE)
 {
     _size = 0;
     _capacity = maxCapacity;
-    _data = new AVL<T>*[_capacity]; //allocate an array of AVL pointers.
-
-    for(size_t i = 0; i < _capacity; i++)
-        _data[i] = new AVL<T>();
+    _twoChoices = twoChoices;
+    allocateArray();
 }
 
 //preconditions: none
 //postconditions: deallocate dynamic memory.
-template<typename T>
-ChainedHash<T>::~ChainedHash()
+template<typename T, typename Bucket>
+ChainedHash<T, Bucket>::~ChainedHash()
 {
-    for(size_t i = 0; i < _capacity; i++)
-        delete _data[i];
+    clearArray(!(Bucket::BULK_RELEASE && is_trivially_destructible<T>::value));
 }
 
 //preconditions: none
 //postconditions: deallocate this ChainedHash object
 // and reassign it the contents of other.
-template<typename T>
-ChainedHash<T>& ChainedHash<T>::operator=(const ChainedHash<T>& other)
+template<typename T, typename Bucket>
+ChainedHash<T, Bucket>& ChainedHash<T, Bucket>::operator=(const ChainedHash<T, Bucket>& other)
 {
-    _capacity() = other._capacity;
-    _size = other._size;
+    if(&other == this)
+        return *this;
 
-    for(size_t i = 0; i < _capacity; i++)
-        delete _data[i];
+    clearArray(true);
 
-    _data = new AVL<T>*[_capacity];
+    _capacity = other._capacity;
+    _size = other._size;
+    _twoChoices = other._twoChoices;
+    allocateArray();
 
-    copyArray(other._data,_data,_capacity);
+    copyArray(other);
+    return *this;
 }
 
 //preconditions: none
 //postconditions: construct this ChainedHash with the contents of other.
-template<typename T>
-ChainedHash<T>::ChainedHash(const ChainedHash<T>& other)
+template<typename T, typename Bucket>
+ChainedHash<T, Bucket>::ChainedHash(const ChainedHash<T, Bucket>& other): _indexPool(SLAB_SIZE)
 {
-    _capacity = other.capacity;
+    _capacity = other._capacity;
     _size = other._size;
-    _data = new AVL<T>*[_capacity];
+    _twoChoices = other._twoChoices;
+    allocateArray();
+
+    copyArray(other);
+}
+
+//preconditions: _capacity and _twoChoices are set.
+//postconditions: _table holds _capacity empty buckets with zeroed loads, the index and linear
+// hashing are off and the hash is key % _capacity. A segment is the smallest power of two
+// that holds _capacity buckets, capped at 1 << MAX_SEGMENT_SHIFT.
+template<typename T, typename Bucket>
+void ChainedHash<T, Bucket>::allocateArray()
+{
+    _segmentShift = 0;
+    while(_segmentShift < MAX_SEGMENT_SHIFT && (size_t(1) << _segmentShift) < _capacity)
+        _segmentShift++;
+
+    _table.hash = table_hash();
+    shape(_table, 0, 0);
+    _index = nullptr;
+    _indexed = false;
+    _linear = false;
+    _maxLoad = 1.0;
+    _rehashing = false;
+    _migrated = 0;
+    _reseeds = 0;
+}
+
+//preconditions: none
+//postconditions: the buckets are deallocated. The buckets and the index are only cleared when
+// clearBuckets is true, the destructor skips the walk when the pools can release
+// every record in bulk.
+template<typename T, typename Bucket>
+void ChainedHash<T, Bucket>::clearArray(bool clearBuckets)
+{
+    release(_table, clearBuckets);
+    if(_rehashing)
+        release(_old, clearBuckets);
+    if(clearBuckets)
+        tree_clear(_index, &_indexPool);
+    _rehashing = false;
+    _moving.clear();
+    _index = nullptr;
+}
+
+//preconditions: _table holds other._capacity empty buckets.
+//postconditions: every bucket of other (and of its rehashing buckets) and its sorted index
+// are deep copied, the copies are drawn from this table's pools.
+template<typename T, typename Bucket>
+void ChainedHash<T, Bucket>::copyArray(const ChainedHash<T, Bucket>& other)
+{
+    _table.hash = other._table.hash;
+    shape(_table, other._table.level, other._table.split);
+    for(size_t i = 0; i < bucket_count(_table); i++)
+    {
+        bucket(_table, i).copy(bucket(other._table, i), other._pool, _pool);
+        load(_table, i) = other.load(other._table, i);
+    }
+    _linear = other._linear;
+    _maxLoad = other._maxLoad;
+    _reseeds = other._reseeds;
+
+    if(other._rehashing)
+    {
+        _old.hash = other._old.hash;
+        shape(_old, other._old.level, other._old.split);
+        for(size_t i = 0; i < bucket_count(_old); i++)
+        {
+            bucket(_old, i).copy(bucket(other._old, i), other._pool, _pool);
+            load(_old, i) = other.load(other._old, i);
+        }
+        _rehashing = true;
+        _migrated = other._migrated;
+        _moving = other._moving;
+    }
 
-    copyArray(other._data,_data,_capacity);
+    _indexed = other._indexed;
+    _index = tree_copy(other._index, &_indexPool);
 }
 
-//preconditions: copyFrom and copyTo must be initialized.
-//postconditions: range: [0, copyFromSize) in copyFrom is coppied to copyTo,
-// copyTo is returned by ref.
-template<typename T>
-void ChainedHash<T>::copyArray(const AVL<T> ** copyFrom, AVL<T> **& copyTo, const size_t & copyFromSize)
+//preconditions: a holds no more than (_capacity << level) + split buckets.
+//postconditions: a is addressed with level and split, segments of empty buckets and zeroed
+// loads are appended until every bucket is allocated.
+template<typename T, typename Bucket>
+void ChainedHash<T, Bucket>::shape(bucket_array& a, size_t level, size_t split)
 {
-    for(size_t i = 0; i < copyFromSize; i++)
-        copyTo[i] = copyFrom[i];
+    a.level = level;
+    a.split = split;
+    size_t segmentSize = size_t(1) << _segmentShift;
+    while(a.segments.size() * segmentSize < bucket_count(a))
+    {
+        a.segments.push_back(new bucket_type[segmentSize]);
+        a.loads.push_back(new uint32_t[segmentSize]());
+    }
+}
+
+//preconditions: none
+//postconditions: every segment of a is deallocated, the buckets are cleared first if clearBuckets.
+template<typename T, typename Bucket>
+void ChainedHash<T, Bucket>::release(bucket_array& a, bool clearBuckets)
+{
+    if(clearBuckets)
+        for(size_t i = 0; i < bucket_count(a); i++)
+            bucket(a, i).clear(_pool);
+    for(size_t i = 0; i < a.segments.size(); i++)
+    {
+        delete [] a.segments[i];
+        delete [] a.loads[i];
+    }
+    a.segments.clear();
+    a.loads.clear();
 }
 
 //preconditions: none
-//postconditions: the entry will be inserted into the table at the hash of its key,
-// if that position is already taken, the second hash function will be applied
-// to the key until an index is found that is available. If the entry was inserted return true,
-// otherwise if an entry with the same key already exists in the table, or the table is full, return false.
-template<typename T>
-bool ChainedHash<T>::insert(const T &entry)
+//postconditions: the entry will be inserted into the bucket at the hash of its key.
+// If the entry was inserted return true, otherwise if an entry with the same key
+// already exists in the table, return false. A bucket that grows far deeper than
+// the average load reseeds the table. With linear hashing, an insert that takes the
+// load past _maxLoad splits one bucket.
+template<typename T, typename Bucket>
+bool ChainedHash<T, Bucket>::insert(const T &entry)
 {
-    size_t index = hash(entry.key);
-    bool inserted = _data[index]->insert(entry);
+    migrate_step();
+
+    //the key may already be in the other candidate bucket or in the buckets being rehashed.
+    if((_twoChoices || _rehashing) && search(entry.key))
+        return false;
+
+    size_t index = place_index(entry.key);
+    bool inserted = bucket(_table, index).insert(entry, _pool);
 
     if(inserted)
+    {
         _size++;
+        load(_table, index)++;
+        if(_indexed)
+            tree_insert(_index, entry, true, &_indexPool);
+        if(!_rehashing && chain_flooded(load(_table, index), _size, bucket_count(_table)))
+            reseed();
+        if(_linear && double(_size) > _maxLoad * double(bucket_count(_table)))
+            split_bucket();
+    }
 
     return inserted;
 }
@@ -173,15 +497,20 @@ bool ChainedHash<T>::insert(const T &entry)
 //preconditions: key must be a non-negative integer.
 //postconditions: first, obtain the index of the item to be removed, if it exists in the hashtable.
 // returns true if the item with the key found and removed, otherwise false.
-template<typename T>
-bool ChainedHash<T>::remove(int key)
+template<typename T, typename Bucket>
+bool ChainedHash<T, Bucket>::remove(int key)
 {
     assert(key >= 0);
-    size_t index = hash(key);
-    bool removed = _data[index]->erase(T(key));
+    migrate_step();
+
+    bool removed = erase_in(_table, key) || (_rehashing && erase_in(_old, key));
 
     if(removed)
+    {
         _size--;
+        if(_indexed)
+            tree_erase(_index, T(key), true, &_indexPool);
+    }
 
     return removed;
 }
@@ -189,33 +518,452 @@ bool ChainedHash<T>::remove(int key)
 //preconditions: none
 //postconditions: if the record with the recieved key exists in the table,
 // returns true, otherwise returns false.
-template<typename T>
-bool ChainedHash<T>::is_present(int key)
+template<typename T, typename Bucket>
+bool ChainedHash<T, Bucket>::is_present(int key)
 {
     assert(key >= 0);
 
-    size_t index = hash(key);
-    tree_node<T>* found_ptr = nullptr;
-    return _data[index]->search(T(key),found_ptr);
+    return search(key) != nullptr;
+}
+
+//preconditions: keys are non-negative integers, present has room for count results.
+//postconditions: present[i] = is_present(keys[i]) for every key. Up to IN_FLIGHT lookups are in
+// flight at once: a visit reads the bucket or tree node its lookup prefetched on the previous
+// round, then prefetches the next one and yields to the next lookup, so the cache misses of deep
+// tree walks overlap instead of being paid one node after another.
+template<typename T, typename Bucket>
+void ChainedHash<T, Bucket>::is_present(const int* keys, size_t count, bool* present)
+{
+    in_flight flight[IN_FLIGHT];
+    size_t active = 0;
+    size_t next = 0;
+    while(active < IN_FLIGHT && next < count)
+    {
+        flight[active]._at = next;
+        start_lookup(flight[active++], keys[next++]);
+    }
+
+    while(active > 0)
+        for(size_t i = 0; i < active; )
+        {
+            in_flight& l = flight[i];
+            if(!visit(l, keys[l._at], present))
+                i++;
+            else if(next < count)
+            {
+                l._at = next;
+                start_lookup(l, keys[next++]);
+                i++;
+            }
+            else
+                l = flight[--active];   //the last lookup takes the place and is visited next.
+        }
 }
 
 //preconditions: key must be a non-negative interger.
 //postconditions: if the record with the recieved key exists in the table,
 // found will be true and the record will be returned by ref.
-template<typename T>
-void ChainedHash<T>::find(int key, bool& found, T& result)
+template<typename T, typename Bucket>
+void ChainedHash<T, Bucket>::find(int key, bool& found, T& result)
 {
     assert(key >= 0);
 
-    size_t index = hash(key);
-    tree_node<T>* found_ptr = nullptr;
-    T tempRecord(key);
-    found = _data[index]->search(tempRecord,found_ptr);
+    T* found_ptr = search(key);
+    found = (found_ptr != nullptr);
 
     if(found)
     {
-        result = found_ptr->_item;
+        result = *found_ptr;
     }
 }
 
+//preconditions: none
+//postconditions: the current buckets are searched, then the buckets being rehashed if there are any.
+template<typename T, typename Bucket>
+T* ChainedHash<T, Bucket>::search(int key)
+{
+    T* found_ptr = search_in(_table, key);
+    if(!found_ptr && _rehashing)
+        found_ptr = search_in(_old, key);
+    return found_ptr;
+}
+
+//preconditions: none
+//postconditions: with one choice the bucket at hash(a, key) is searched. With two choices both
+// candidate buckets are prefetched first so their cache misses overlap, then searched in turn.
+template<typename T, typename Bucket>
+T* ChainedHash<T, Bucket>::search_in(const bucket_array& a, int key)
+{
+    size_t index = hash(a, key);
+    if(!_twoChoices)
+        return bucket(a, index).search(key, _pool);
+
+    size_t other = hash2(a, key);
+    PREFETCH(&bucket(a, index));
+    PREFETCH(&bucket(a, other));
+    T* found_ptr = bucket(a, index).search(key, _pool);
+    if(!found_ptr && other != index)
+        found_ptr = bucket(a, other).search(key, _pool);
+    return found_ptr;
+}
+
+//preconditions: stage was 0 for the first call of the lookup, then left as the last call set it.
+//postconditions: returns the buckets search would search for the key in turn: its bucket of
+// _table, the other candidate of _table with two choices, then the same of _old while rehashing.
+// stage moves past the bucket returned, null is returned once every bucket was searched.
+template<typename T, typename Bucket>
+typename ChainedHash<T, Bucket>::bucket_type* ChainedHash<T, Bucket>::candidate(int key, size_t& stage) const
+{
+    for(; stage < 4; stage++)
+    {
+        if(stage >= 2 && !_rehashing)
+            return nullptr;
+
+        const bucket_array& a = (stage < 2) ? _table : _old;
+        size_t index = hash(a, key);
+        if(stage % 2 == 0)
+        {
+            stage++;
+            return &bucket(a, index);
+        }
+
+        size_t other = (_twoChoices) ? hash2(a, key) : index;
+        if(other != index)
+        {
+            stage++;
+            return &bucket(a, other);
+        }
+    }
+    return nullptr;
+}
+
+//preconditions: key must be a non-negative integer.
+//postconditions: the lookup is at the bucket of the key in _table, which is prefetched.
+template<typename T, typename Bucket>
+void ChainedHash<T, Bucket>::start_lookup(in_flight& l, int key) const
+{
+    assert(key >= 0);
+    l._stage = 0;
+    l._node = nullptr;
+    l._bucket = candidate(key, l._stage);
+    PREFETCH(l._bucket);
+}
+
+//preconditions: the bucket or the tree node of the lookup was prefetched.
+//postconditions: a bucket that is a tree gives its root, which is prefetched for the next visit,
+// any other bucket is searched whole. A tree node is compared with the key and the walk moves to
+// the child, prefetching it. A bucket or tree that does not hold the key moves the lookup to its
+// next candidate bucket. Returns true once the lookup is over, with present[l._at] set.
+template<typename T, typename Bucket>
+bool ChainedHash<T, Bucket>::visit(in_flight& l, int key, bool* present)
+{
+    if(!l._node)
+    {
+        l._node = l._bucket->tree();
+        if(l._node)
+        {
+            PREFETCH(l._node);
+            return false;
+        }
+
+        if(l._bucket->search(key, _pool))
+        {
+            present[l._at] = true;
+            return true;
+        }
+    }
+    else if(tree_search_step(l._node, T(key)))
+    {
+        present[l._at] = true;
+        return true;
+    }
+    else if(l._node)
+    {
+        PREFETCH(l._node);
+        return false;
+    }
+
+    l._bucket = candidate(key, l._stage);
+    if(!l._bucket)
+    {
+        present[l._at] = false;
+        return true;
+    }
+    PREFETCH(l._bucket);
+    return false;
+}
+
+//preconditions: none
+//postconditions: the key is erased from its bucket of a (or from either of its two candidate
+// buckets) and the load of that bucket is decremented, returns false if it is not there.
+template<typename T, typename Bucket>
+bool ChainedHash<T, Bucket>::erase_in(bucket_array& a, int key)
+{
+    size_t index = hash(a, key);
+    bool removed = bucket(a, index).erase(key, _pool);
+    if(!removed && _twoChoices)
+    {
+        index = hash2(a, key);
+        removed = bucket(a, index).erase(key, _pool);
+    }
+
+    if(removed)
+        load(a, index)--;
+    return removed;
+}
+
+//preconditions: none
+//postconditions: returns hash(key), or with two choices the less loaded of hash(key) and hash2(key).
+template<typename T, typename Bucket>
+size_t ChainedHash<T, Bucket>::place_index(int key) const
+{
+    size_t index = hash(_table, key);
+    if(_twoChoices)
+    {
+        size_t other = hash2(_table, key);
+        if(load(_table, other) < load(_table, index))
+            index = other;
+    }
+    return index;
+}
+
+//preconditions: none
+//postconditions: from now on, whenever an insert takes the average load past maxLoad records
+// per bucket, the bucket at the split pointer is split in two. The table grows by one bucket
+// at a time and never rehashes every bucket at once.
+template<typename T, typename Bucket>
+void ChainedHash<T, Bucket>::enable_linear_hashing(double maxLoad)
+{
+    assert(maxLoad > 0);
+    _linear = true;
+    _maxLoad = maxLoad;
+}
+
+//preconditions: none
+//postconditions: bucket split of _table becomes two buckets, split and split + (_capacity << level),
+// and the split pointer advances (a full round doubles _capacity << level). Only the records whose
+// address moved to the new bucket are erased and reinserted, with two choices a record stays if
+// either of its candidates is still the old bucket.
+template<typename T, typename Bucket>
+void ChainedHash<T, Bucket>::split_bucket()
+{
+    size_t from = _table.split;
+    size_t to = bucket_count(_table);
+    if(_table.split + 1 == (_capacity << _table.level))
+        shape(_table, _table.level + 1, 0);
+    else
+        shape(_table, _table.level, _table.split + 1);
+
+    if(load(_table, from) == 0)
+        return;
+
+    vector<T> records(load(_table, from));
+    records.resize(bucket(_table, from).flatten(records.data(), _pool));
+    for(size_t i = 0; i < records.size(); i++)
+    {
+        int key = records[i].key;
+        if(hash(_table, key) == from || (_twoChoices && hash2(_table, key) == from))
+            continue;
+
+        bucket(_table, from).erase(key, _pool);
+        bucket(_table, to).insert(records[i], _pool);
+        load(_table, from)--;
+        load(_table, to)++;
+    }
+}
+
+//preconditions: the table is not rehashing.
+//postconditions: the buckets become _old and a new set of empty buckets of the same shape is
+// hashed with a fresh random seed. Records move over a few at a time in migrate_step, lookups
+// search both sets until then, so no single operation pays for the whole rehash.
+template<typename T, typename Bucket>
+void ChainedHash<T, Bucket>::reseed()
+{
+    assert(!_rehashing);
+    swap(_old.segments, _table.segments);
+    swap(_old.loads, _table.loads);
+    _old.hash = _table.hash;
+    _old.level = _table.level;
+    _old.split = _table.split;
+    _rehashing = true;
+    _migrated = 0;
+
+    _table.hash = table_hash::random();
+    shape(_table, _old.level, _old.split);
+    _reseeds++;
+}
+
+//preconditions: none
+//postconditions: up to MIGRATE_STEP records of _old are moved to their buckets under the new
+// hash (an empty bucket passed over counts as one). The records of a bucket are flattened into
+// _moving once, and each is erased from the old bucket as it moves, a record that was removed
+// meanwhile is skipped. _old is released once every bucket has been moved.
+template<typename T, typename Bucket>
+void ChainedHash<T, Bucket>::migrate_step()
+{
+    for(size_t moved = 0; _rehashing && moved < MIGRATE_STEP; moved++)
+    {
+        if(_migrated == bucket_count(_old))
+        {
+            release(_old, false);
+            _rehashing = false;
+            break;
+        }
+
+        if(_moving.empty())
+        {
+            if(load(_old, _migrated) == 0)
+            {
+                _migrated++;
+                continue;
+            }
+            _moving.resize(load(_old, _migrated));
+            _moving.resize(bucket(_old, _migrated).flatten(_moving.data(), _pool));
+            if(_moving.empty())
+            {
+                _migrated++;
+                continue;
+            }
+        }
+
+        T record = _moving.back();
+        _moving.pop_back();
+        if(bucket(_old, _migrated).erase(record.key, _pool))
+        {
+            load(_old, _migrated)--;
+            size_t index = place_index(record.key);
+            bucket(_table, index).insert(record, _pool);
+            load(_table, index)++;
+        }
+        if(_moving.empty())
+            _migrated++;
+    }
+}
+
+//preconditions: none
+//postconditions: a sorted index over every record is built (the buckets are flattened,
+// sorted and passed to tree_from_sorted_list) and kept up to date by insert and remove,
+// so range queries do not scan the table.
+template<typename T, typename Bucket>
+void ChainedHash<T, Bucket>::enable_sorted_index()
+{
+    if(_indexed)
+        return;
+
+    T* records = new T[_size];
+    size_t count = 0;
+    for(size_t i = 0; i < bucket_count(_table); i++)
+        count += bucket(_table, i).flatten(records + count, _pool);
+    if(_rehashing)
+        for(size_t i = 0; i < bucket_count(_old); i++)
+            count += bucket(_old, i).flatten(records + count, _pool);
+    sort(records, records + count);
+
+    _index = tree_from_sorted_list(records, int(count), &_indexPool);
+    _indexed = true;
+    delete [] records;
+}
+
+//preconditions: the sorted index is enabled.
+//postconditions: returns the number of records with a key in [lo, hi], in O(log n).
+template<typename T, typename Bucket>
+size_t ChainedHash<T, Bucket>::count_range(int lo, int hi) const
+{
+    assert(_indexed);
+    return tree_count_range(_index, T(lo), T(hi));
+}
+
+//preconditions: the sorted index is enabled.
+//postconditions: visit(record) is called on every record with a key in [lo, hi] in key order.
+template<typename T, typename Bucket>
+template <typename Visitor>
+void ChainedHash<T, Bucket>::range(int lo, int hi, Visitor visit) const
+{
+    assert(_indexed);
+    tree_range(_index, T(lo), T(hi), visit);
+}
+
+//preconditions: none
+//postconditions: returns a read-only table with the same buckets, hash, records and sorted index.
+// Every bucket is flattened, sorted and laid out in Eytzinger order, all buckets share one
+// contiguous frozen_pool. Insert and remove on the returned table always fail. A table that is
+// rehashing is copied and the copy finishes rehashing first.
+template<typename T, typename Bucket>
+ChainedHash<T, FrozenBucket<T> > ChainedHash<T, Bucket>::freeze() const
+{
+    if(_rehashing)
+    {
+        ChainedHash<T, Bucket> settled(*this);
+        while(settled._rehashing)
+            settled.migrate_step();
+        return settled.freeze();
+    }
+
+    ChainedHash<T, FrozenBucket<T> > frozen(_capacity, _twoChoices);
+    frozen._table.hash = _table.hash;
+    frozen.shape(frozen._table, _table.level, _table.split);
+    frozen._pool.reserve(uint32_t(_size));
+
+    T* records = new T[_size];
+    for(size_t i = 0; i < bucket_count(_table); i++)
+    {
+        size_t count = bucket(_table, i).flatten(records, _pool);
+        sort(records, records + count);
+        frozen.bucket(frozen._table, i).build(records, uint32_t(count), frozen._pool);
+        frozen.load(frozen._table, i) = load(_table, i);
+    }
+    delete [] records;
+
+    frozen._size = _size;
+    frozen._reseeds = _reseeds;
+    frozen._indexed = _indexed;
+    frozen._index = tree_copy(_index, &frozen._indexPool);
+    return frozen;
+}
+
+//preconditions: none
+//postconditions: returns a read-only PerfectHash of every record, which drops the buckets: a
+// lookup reads one pilot and one slot instead of searching a bucket. Unlike freeze() it keeps
+// neither the sorted index nor the bucket layout.
+template<typename T, typename Bucket>
+PerfectHash<T> ChainedHash<T, Bucket>::freeze_perfect() const
+{
+    T* records = new T[_size];
+    size_t count = 0;
+    for(size_t i = 0; i < bucket_count(_table); i++)
+        count += bucket(_table, i).flatten(records + count, _pool);
+    if(_rehashing)
+        for(size_t i = 0; i < bucket_count(_old); i++)
+            count += bucket(_old, i).flatten(records + count, _pool);
+
+    PerfectHash<T> frozen(records, count);
+    delete [] records;
+    return frozen;
+}
+
+//preconditions: none
+//postconditions: returns the number of records in the fullest bucket of the current buckets and,
+// while rehashing, of the buckets left behind. The buckets keep no size, each one is flattened.
+template<typename T, typename Bucket>
+size_t ChainedHash<T, Bucket>::longest_bucket() const
+{
+    T* records = new T[_size];
+    size_t longest = 0;
+    for(size_t i = 0; i < bucket_count(_table); i++)
+    {
+        size_t count = bucket(_table, i).flatten(records, _pool);
+        if(count > longest)
+            longest = count;
+    }
+    if(_rehashing)
+        for(size_t i = 0; i < bucket_count(_old); i++)
+        {
+            size_t count = bucket(_old, i).flatten(records, _pool);
+            if(count > longest)
+                longest = count;
+        }
+    delete [] records;
+    return longest;
+}
+
 #endif // CHAINEDHASH_H
@@ -0,0 +1,706 @@
+#ifndef COMPACT_AVL_H
+#define COMPACT_AVL_H
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cassert>
+#include <stdint.h>
+
+using namespace std;
+
+//The subtree size of a compact node, only stored when order statistics are requested.
+template <bool ORDER_STATS>
+struct compact_size
+{
+    uint32_t _size;
+    uint32_t size() const { return _size; }
+    void set_size(uint32_t size) { _size = size; }
+};
+
+template <>
+struct compact_size<false>
+{
+    uint32_t size() const { return 0; }
+    void set_size(uint32_t) {}
+};
+
+//A node of a CompactAVL. Children are 32 bit indices into a compact_pool (0 is null)
+// instead of 64 bit pointers, and the node stores a 2 bit balance factor packed into
+// the top bits of _left instead of a height. For a Record<int> the node is 16 bytes
+// (20 with ORDER_STATS) where a tree_node is 40.
+template <typename T, bool ORDER_STATS = false>
+struct compact_node : public compact_size<ORDER_STATS>
+{
+    T _item;
+    uint32_t _left;     //bits 0-29: index of the left child, bits 30-31: balance factor + 1.
+    uint32_t _right;    //index of the right child.
+
+    static const uint32_t INDEX_MASK = 0x3FFFFFFF;
+    static const uint32_t MAX_INDEX = INDEX_MASK;
+
+    uint32_t left() const { return _left & INDEX_MASK; }
+    uint32_t right() const { return _right; }
+    void set_left(uint32_t index) { _left = (_left & ~INDEX_MASK) | index; }
+    void set_right(uint32_t index) { _right = index; }
+
+    //balance factor: height of the right subtree - height of the left subtree (-1, 0 or 1).
+    int balance_factor() const { return int(_left >> 30) - 1; }
+    void set_balance_factor(int bf) { _left = (_left & INDEX_MASK) | (uint32_t(bf + 1) << 30); }
+};
+
+//An index addressed arena of compact nodes. Nodes live in one growable array so a
+// 32 bit index is enough to address them, freed nodes are kept on a free list
+// linked through _right. Index 0 is reserved as the null index.
+template <typename N>
+class compact_pool
+{
+public:
+    compact_pool(uint32_t initialCapacity = 64);
+    ~compact_pool();
+
+    uint32_t allocate();                //returns the index of an unused node.
+    void deallocate(uint32_t index);    //return the node to the free list.
+
+    //preconditions: 0 < index < _used
+    //postconditions: returns the node at the index, references are invalidated by allocate().
+    inline N& operator[](uint32_t index)
+    {
+        assert(index > 0 && index < _used);
+        return _nodes[index];
+    }
+
+    inline const N& operator[](uint32_t index) const
+    {
+        assert(index > 0 && index < _used);
+        return _nodes[index];
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of nodes currently handed out.
+    inline size_t live() const
+    {
+        return _live;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of bytes reserved by the node array.
+    inline size_t reserved() const
+    {
+        return size_t(_capacity) * sizeof(N);
+    }
+
+private:
+    N* _nodes;
+    uint32_t _capacity;
+    uint32_t _used;     //nodes [1, _used) have been handed out at least once.
+    uint32_t _free;     //head of the free list, 0 if it is empty.
+    size_t _live;
+
+    //not copyable, indices are only meaningful inside one pool.
+    compact_pool(const compact_pool<N>& other);
+    compact_pool<N>& operator=(const compact_pool<N>& other);
+};
+
+//preconditions: initialCapacity > 1
+//postconditions: an empty pool is constructed, the array is allocated on the first allocate().
+template <typename N>
+compact_pool<N>::compact_pool(uint32_t initialCapacity)
+{
+    assert(initialCapacity > 1);
+    _nodes = nullptr;
+    _capacity = initialCapacity;
+    _used = 1;
+    _free = 0;
+    _live = 0;
+}
+
+//preconditions: none
+//postconditions: the node array is deallocated.
+template <typename N>
+compact_pool<N>::~compact_pool()
+{
+    delete [] _nodes;
+}
+
+//preconditions: less than 2^30 nodes are live.
+//postconditions: a node is popped from the free list, or the next unused node is
+// handed out, doubling the array when it is full. Returns its index.
+template <typename N>
+uint32_t compact_pool<N>::allocate()
+{
+    uint32_t index;
+
+    if(_free)
+    {
+        index = _free;
+        _free = _nodes[index]._right;
+    }
+    else
+    {
+        if(!_nodes || _used == _capacity)
+        {
+            uint32_t newCapacity = (_nodes) ? _capacity * 2 : _capacity;
+            assert(newCapacity - 1 <= N::MAX_INDEX);
+            N* bigger = new N[newCapacity];
+            for(uint32_t i = 1; i < _used; i++)
+                bigger[i] = _nodes[i];
+            delete [] _nodes;
+            _nodes = bigger;
+            _capacity = newCapacity;
+        }
+        index = _used++;
+    }
+
+    _live++;
+    return index;
+}
+
+//preconditions: index was returned by allocate() and has not been deallocated.
+//postconditions: the node is pushed onto the free list.
+template <typename N>
+void compact_pool<N>::deallocate(uint32_t index)
+{
+    assert(index > 0 && index < _used);
+    _nodes[index]._right = _free;
+    _free = index;
+    _live--;
+}
+
+//An AVL tree built from compact_nodes. Several trees can share one compact_pool,
+// so the head of a tree is a single 32 bit root index. Subtree sizes are only
+// maintained when ORDER_STATS is true. The algorithms are static functions on a
+// (root, pool) pair, so a hash table bucket can hold nothing but the root index.
+template <typename T, bool ORDER_STATS = false>
+class CompactAVL
+{
+public:
+    typedef compact_node<T, ORDER_STATS> node_type;
+    typedef compact_pool<node_type> pool_type;
+
+    //preconditions: none
+    //postconditions: print the tree from right to left.
+    friend ostream& operator<<(ostream& outs, const CompactAVL<T, ORDER_STATS>& tree)
+    {
+        print(tree._root, *tree._pool, 0, outs);
+        outs << endl;
+        return outs;
+    }
+
+    CompactAVL();
+    CompactAVL(pool_type* pool);                        //construct an empty tree that draws its nodes from the shared pool.
+    CompactAVL(const CompactAVL<T, ORDER_STATS>& copy_me);
+    ~CompactAVL();
+
+    CompactAVL<T, ORDER_STATS>& operator =(const CompactAVL<T, ORDER_STATS>& rhs);
+
+    bool insert(const T& insert_me);                    //insert the value into this tree.
+    bool erase(const T& target);                        //remove the value from this tree.
+    bool search(const T& target, T* & found_ptr);       //find the value in this tree.
+    void clear();                                       //remove every value.
+
+    bool isBalanced() const;                            //verify the stored balance factors against the heights.
+
+    //preconditions: none
+    //postconditions: returns the number of items in the tree.
+    size_t size() const
+    {
+        return _count;
+    }
+
+    //the tree algorithms on a root index and the pool its nodes live in.
+    static bool insert(uint32_t& root, const T& insert_me, pool_type& pool);
+    static bool erase(uint32_t& root, const T& target, pool_type& pool);
+    static T* search(uint32_t root, const T& target, pool_type& pool);
+    static void clear(uint32_t& root, pool_type& pool);
+    static uint32_t copy(uint32_t root, const pool_type& from, pool_type& to);
+    static size_t flatten(uint32_t root, const pool_type& pool, T* out);
+    static void print(uint32_t root, const pool_type& pool, int level, ostream& outs);
+
+private:
+    //The deepest path of an AVL tree with less than 2^30 nodes is 1.44 * 30 < MAX_DEPTH.
+    static const int MAX_DEPTH = 64;
+
+    uint32_t _root;
+    size_t _count;
+    pool_type _ownPool;     //used when no shared pool is provided.
+    pool_type* _pool;
+
+    static uint32_t subtree_size(uint32_t index, const pool_type& pool) { return (index) ? pool[index].size() : 0; }
+    static void update_size(uint32_t index, pool_type& pool);
+    static uint32_t rotate_left(uint32_t x, pool_type& pool);
+    static uint32_t rotate_right(uint32_t x, pool_type& pool);
+    static void set_child(uint32_t parent, bool right, uint32_t child, pool_type& pool);
+    static int verify(uint32_t index, const pool_type& pool, bool& balanced);
+};
+
+//preconditions: none
+//postconditions: an empty tree with its own pool is constructed.
+template <typename T, bool ORDER_STATS>
+CompactAVL<T, ORDER_STATS>::CompactAVL()
+{
+    _root = 0;
+    _count = 0;
+    _pool = &_ownPool;
+}
+
+//preconditions: pool must outlive this tree.
+//postconditions: an empty tree is constructed, nodes will be drawn from pool.
+template <typename T, bool ORDER_STATS>
+CompactAVL<T, ORDER_STATS>::CompactAVL(pool_type* pool)
+{
+    assert(pool);
+    _root = 0;
+    _count = 0;
+    _pool = pool;
+}
+
+//preconditions: none
+//postconditions: a tree with the same contents as copy_me is constructed in its own pool.
+template <typename T, bool ORDER_STATS>
+CompactAVL<T, ORDER_STATS>::CompactAVL(const CompactAVL<T, ORDER_STATS>& copy_me)
+{
+    _pool = &_ownPool;
+    _root = copy(copy_me._root, *copy_me._pool, *_pool);
+    _count = copy_me._count;
+}
+
+//preconditions: none
+//postconditions: every node is returned to the pool.
+template <typename T, bool ORDER_STATS>
+CompactAVL<T, ORDER_STATS>::~CompactAVL()
+{
+    if(_pool != &_ownPool)
+        clear();
+}
+
+//preconditions: none
+//postconditions: this tree is cleared and becomes a copy of rhs, nodes stay in this tree's pool.
+template <typename T, bool ORDER_STATS>
+CompactAVL<T, ORDER_STATS>& CompactAVL<T, ORDER_STATS>::operator =(const CompactAVL<T, ORDER_STATS>& rhs)
+{
+    if(&rhs != this)
+    {
+        clear();
+        _root = copy(rhs._root, *rhs._pool, *_pool);
+        _count = rhs._count;
+    }
+    return *this;
+}
+
+//preconditions: none
+//postconditions: every node is returned to the pool, the tree is empty.
+template <typename T, bool ORDER_STATS>
+void CompactAVL<T, ORDER_STATS>::clear()
+{
+    clear(_root, *_pool);
+    _count = 0;
+}
+
+//preconditions: none
+//postconditions: found_ptr points to the item if it was found (until the next insert into the pool),
+// otherwise it is null.
+template <typename T, bool ORDER_STATS>
+bool CompactAVL<T, ORDER_STATS>::search(const T& target, T* & found_ptr)
+{
+    found_ptr = search(_root, target, *_pool);
+    return found_ptr != nullptr;
+}
+
+//preconditions: none
+//postconditions: insert_me is added to the tree, returns false if it is a duplicate.
+template <typename T, bool ORDER_STATS>
+bool CompactAVL<T, ORDER_STATS>::insert(const T& insert_me)
+{
+    bool inserted = insert(_root, insert_me, *_pool);
+    if(inserted)
+        _count++;
+    return inserted;
+}
+
+//preconditions: none
+//postconditions: target is removed and true is returned, otherwise false.
+template <typename T, bool ORDER_STATS>
+bool CompactAVL<T, ORDER_STATS>::erase(const T& target)
+{
+    bool erased = erase(_root, target, *_pool);
+    if(erased)
+        _count--;
+    return erased;
+}
+
+//preconditions: none
+//postconditions: returns true if every stored balance factor matches the subtree heights
+// and is in [-1, 1].
+template <typename T, bool ORDER_STATS>
+bool CompactAVL<T, ORDER_STATS>::isBalanced() const
+{
+    bool balanced = true;
+    verify(_root, *_pool, balanced);
+    return balanced;
+}
+
+//preconditions: none
+//postconditions: an iterative binary search for target is conducted, returns a pointer to the
+// item if it was found (until the next insert into the pool), otherwise null.
+template <typename T, bool ORDER_STATS>
+T* CompactAVL<T, ORDER_STATS>::search(uint32_t root, const T& target, pool_type& pool)
+{
+    uint32_t index = root;
+    while(index)
+    {
+        node_type& n = pool[index];
+        if(n._item == target)
+            return &n._item;
+        index = (n._item < target) ? n.right() : n.left();
+    }
+    return nullptr;
+}
+
+//preconditions: none
+//postconditions: insert_me is added as a leaf where the search for it falls off the tree,
+// returns false if it is a duplicate. The path is retraced adjusting balance factors:
+// the walk stops at the first node whose balance becomes 0 or after a single rotation,
+// since the subtree then has the height it had before the insert.
+template <typename T, bool ORDER_STATS>
+bool CompactAVL<T, ORDER_STATS>::insert(uint32_t& root, const T& insert_me, pool_type& pool)
+{
+    uint32_t path[MAX_DEPTH];
+    bool wentRight[MAX_DEPTH];
+    int depth = 0;
+
+    uint32_t index = root;
+    while(index)
+    {
+        const node_type& n = pool[index];
+        if(n._item == insert_me)
+            return false;
+        assert(depth < MAX_DEPTH);
+        path[depth] = index;
+        wentRight[depth] = (n._item < insert_me);
+        index = (wentRight[depth]) ? n.right() : n.left();
+        depth++;
+    }
+
+    uint32_t leaf = pool.allocate();
+    node_type& n = pool[leaf];
+    n._item = insert_me;
+    n._left = 0;
+    n._right = 0;
+    n.set_balance_factor(0);
+    n.set_size(1);
+
+    if(depth == 0)
+    {
+        root = leaf;
+        return true;
+    }
+    set_child(path[depth-1], wentRight[depth-1], leaf, pool);
+
+    //retrace: the subtree below path[i] grew on side wentRight[i].
+    int i = depth - 1;
+    for(; i >= 0; i--)
+    {
+        uint32_t p = path[i];
+        int bf = pool[p].balance_factor() + ((wentRight[i]) ? 1 : -1);
+
+        if(bf == 0)
+        {
+            pool[p].set_balance_factor(0);
+            break;
+        }
+        else if(bf == 1 || bf == -1)
+        {
+            pool[p].set_balance_factor(bf);
+        }
+        else
+        {
+            uint32_t top;
+            if(bf == 2)
+                top = rotate_left(p, pool);
+            else
+                top = rotate_right(p, pool);
+
+            if(i == 0)
+                root = top;
+            else
+                set_child(path[i-1], wentRight[i-1], top, pool);
+            i--;
+            break;
+        }
+        update_size(p, pool);
+    }
+
+    //the heights above are unchanged, only the sizes of the remaining ancestors grow.
+    if(ORDER_STATS)
+        for(; i >= 0; i--)
+            update_size(path[i], pool);
+
+    return true;
+}
+
+//preconditions: none
+//postconditions: target is removed (a node with two children takes the largest item of
+// its left subtree) and true is returned, otherwise false. The path is retraced adjusting
+// balance factors, the walk stops once a subtree's height is unchanged.
+template <typename T, bool ORDER_STATS>
+bool CompactAVL<T, ORDER_STATS>::erase(uint32_t& root, const T& target, pool_type& pool)
+{
+    uint32_t path[MAX_DEPTH];
+    bool wentRight[MAX_DEPTH];
+    int depth = 0;
+
+    uint32_t index = root;
+    while(index && pool[index]._item != target)
+    {
+        assert(depth < MAX_DEPTH);
+        path[depth] = index;
+        wentRight[depth] = (pool[index]._item < target);
+        index = (wentRight[depth]) ? pool[index].right() : pool[index].left();
+        depth++;
+    }
+
+    if(!index)
+        return false;
+
+    uint32_t removed = index;
+    uint32_t replacement;
+    if(pool[index].left() && pool[index].right())
+    {
+        //move the largest item of the left subtree into this node, remove that node instead.
+        path[depth] = index;
+        wentRight[depth] = false;
+        depth++;
+        removed = pool[index].left();
+        while(pool[removed].right())
+        {
+            path[depth] = removed;
+            wentRight[depth] = true;
+            depth++;
+            removed = pool[removed].right();
+        }
+        pool[index]._item = pool[removed]._item;
+    }
+    replacement = (pool[removed].left()) ? pool[removed].left() : pool[removed].right();
+
+    if(depth == 0)
+        root = replacement;
+    else
+        set_child(path[depth-1], wentRight[depth-1], replacement, pool);
+    pool.deallocate(removed);
+
+    //retrace: the subtree below path[i] shrank on side wentRight[i].
+    int i = depth - 1;
+    for(; i >= 0; i--)
+    {
+        uint32_t p = path[i];
+        int bf = pool[p].balance_factor() - ((wentRight[i]) ? 1 : -1);
+        bool heightUnchanged;
+
+        if(bf == 1 || bf == -1)
+        {
+            pool[p].set_balance_factor(bf);
+            heightUnchanged = true;
+        }
+        else if(bf == 0)
+        {
+            pool[p].set_balance_factor(0);
+            heightUnchanged = false;
+        }
+        else
+        {
+            //a rotation around a sibling with balance 0 leaves the height unchanged.
+            uint32_t sibling = (bf == 2) ? pool[p].right() : pool[p].left();
+            heightUnchanged = (pool[sibling].balance_factor() == 0);
+            uint32_t top = (bf == 2) ? rotate_left(p, pool) : rotate_right(p, pool);
+
+            if(i == 0)
+                root = top;
+            else
+                set_child(path[i-1], wentRight[i-1], top, pool);
+        }
+        update_size(p, pool);
+
+        if(heightUnchanged)
+        {
+            i--;
+            break;
+        }
+    }
+
+    if(ORDER_STATS)
+        for(; i >= 0; i--)
+            update_size(path[i], pool);
+
+    return true;
+}
+
+//preconditions: none
+//postconditions: every node of the tree is returned to the pool, root is set to 0.
+template <typename T, bool ORDER_STATS>
+void CompactAVL<T, ORDER_STATS>::clear(uint32_t& root, pool_type& pool)
+{
+    if(root)
+    {
+        uint32_t left = pool[root].left();
+        uint32_t right = pool[root].right();
+        clear(left, pool);
+        clear(right, pool);
+        pool.deallocate(root);
+        root = 0;
+    }
+}
+
+//preconditions: none
+//postconditions: the tree at root in the pool from is copied into the pool to, its root is returned.
+template <typename T, bool ORDER_STATS>
+uint32_t CompactAVL<T, ORDER_STATS>::copy(uint32_t root, const pool_type& from, pool_type& to)
+{
+    if(!root)
+        return 0;
+
+    uint32_t left = copy(from[root].left(), from, to);
+    uint32_t right = copy(from[root].right(), from, to);
+    uint32_t copied = to.allocate();
+    to[copied] = from[root];
+    to[copied].set_left(left);
+    to[copied].set_right(right);
+    return copied;
+}
+
+//preconditions: out has room for every item of the tree.
+//postconditions: the items are copied to out in ascending order, the count is returned.
+template <typename T, bool ORDER_STATS>
+size_t CompactAVL<T, ORDER_STATS>::flatten(uint32_t root, const pool_type& pool, T* out)
+{
+    if(!root)
+        return 0;
+
+    size_t count = flatten(pool[root].left(), pool, out);
+    out[count++] = pool[root]._item;
+    return count + flatten(pool[root].right(), pool, out + count);
+}
+
+//preconditions: none
+//postconditions: the tree is printed to outs from right to left.
+template <typename T, bool ORDER_STATS>
+void CompactAVL<T, ORDER_STATS>::print(uint32_t root, const pool_type& pool, int level, ostream& outs)
+{
+    if(root)
+    {
+        print(pool[root].right(), pool, level+1, outs);
+        outs << setw(level*5) << "|" << pool[root]._item << "|" << endl;
+        print(pool[root].left(), pool, level+1, outs);
+    }
+}
+
+//preconditions: index != 0
+//postconditions: recompute the subtree size of the node from its children.
+template <typename T, bool ORDER_STATS>
+void CompactAVL<T, ORDER_STATS>::update_size(uint32_t index, pool_type& pool)
+{
+    if(ORDER_STATS)
+    {
+        node_type& n = pool[index];
+        n.set_size(1 + subtree_size(n.left(), pool) + subtree_size(n.right(), pool));
+    }
+}
+
+//preconditions: parent != 0
+//postconditions: the left or right child of parent is set to child.
+template <typename T, bool ORDER_STATS>
+void CompactAVL<T, ORDER_STATS>::set_child(uint32_t parent, bool right, uint32_t child, pool_type& pool)
+{
+    if(right)
+        pool[parent].set_right(child);
+    else
+        pool[parent].set_left(child);
+}
+
+//preconditions: x has balance factor 2.
+//postconditions: x is rotated left (right-left if its right child leans left),
+// balance factors and sizes of the moved nodes are updated, the new subtree root is returned.
+template <typename T, bool ORDER_STATS>
+uint32_t CompactAVL<T, ORDER_STATS>::rotate_left(uint32_t x, pool_type& pool)
+{
+    uint32_t z = pool[x].right();
+    int bfz = pool[z].balance_factor();
+
+    if(bfz >= 0)
+    {
+        pool[x].set_right(pool[z].left());
+        pool[z].set_left(x);
+        pool[x].set_balance_factor((bfz == 0) ? 1 : 0);
+        pool[z].set_balance_factor((bfz == 0) ? -1 : 0);
+        update_size(x, pool);
+        update_size(z, pool);
+        return z;
+    }
+
+    uint32_t y = pool[z].left();
+    int bfy = pool[y].balance_factor();
+    pool[x].set_right(pool[y].left());
+    pool[z].set_left(pool[y].right());
+    pool[y].set_left(x);
+    pool[y].set_right(z);
+    pool[x].set_balance_factor((bfy == 1) ? -1 : 0);
+    pool[z].set_balance_factor((bfy == -1) ? 1 : 0);
+    pool[y].set_balance_factor(0);
+    update_size(x, pool);
+    update_size(z, pool);
+    update_size(y, pool);
+    return y;
+}
+
+//preconditions: x has balance factor -2.
+//postconditions: x is rotated right (left-right if its left child leans right),
+// balance factors and sizes of the moved nodes are updated, the new subtree root is returned.
+template <typename T, bool ORDER_STATS>
+uint32_t CompactAVL<T, ORDER_STATS>::rotate_right(uint32_t x, pool_type& pool)
+{
+    uint32_t z = pool[x].left();
+    int bfz = pool[z].balance_factor();
+
+    if(bfz <= 0)
+    {
+        pool[x].set_left(pool[z].right());
+        pool[z].set_right(x);
+        pool[x].set_balance_factor((bfz == 0) ? -1 : 0);
+        pool[z].set_balance_factor((bfz == 0) ? 1 : 0);
+        update_size(x, pool);
+        update_size(z, pool);
+        return z;
+    }
+
+    uint32_t y = pool[z].right();
+    int bfy = pool[y].balance_factor();
+    pool[x].set_left(pool[y].right());
+    pool[z].set_right(pool[y].left());
+    pool[y].set_right(x);
+    pool[y].set_left(z);
+    pool[x].set_balance_factor((bfy == -1) ? 1 : 0);
+    pool[z].set_balance_factor((bfy == 1) ? -1 : 0);
+    pool[y].set_balance_factor(0);
+    update_size(x, pool);
+    update_size(z, pool);
+    update_size(y, pool);
+    return y;
+}
+
+//preconditions: none
+//postconditions: returns the height of the subtree, balanced is set to false if a stored
+// balance factor does not match the heights of the children.
+template <typename T, bool ORDER_STATS>
+int CompactAVL<T, ORDER_STATS>::verify(uint32_t index, const pool_type& pool, bool& balanced)
+{
+    if(!index)
+        return -1;
+
+    int left = verify(pool[index].left(), pool, balanced);
+    int right = verify(pool[index].right(), pool, balanced);
+    if(right - left != pool[index].balance_factor())
+        balanced = false;
+    return 1 + ((left > right) ? left : right);
+}
+
+#endif // COMPACT_AVL_H
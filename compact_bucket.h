@@ -0,0 +1,95 @@
+#ifndef COMPACT_BUCKET_H
+#define COMPACT_BUCKET_H
+
+#include <cstdlib>
+#include <cassert>
+#include "bst_functions.h"
+#include "compact_avl.h"
+
+using namespace std;
+
+//A hash table bucket that is the 32 bit root index of a CompactAVL whose nodes live in the
+// table's shared compact_pool. For Record<int> a bucket is 4 bytes and a record 16 bytes,
+// against 8 and 40 for an AVLBucket.
+template <typename T>
+class CompactBucket
+{
+public:
+    typedef CompactAVL<T> tree_type;
+    typedef typename tree_type::pool_type pool_type;
+
+    //every byte of the bucket lives in the pool, so the table may release the pool in bulk.
+    static const bool BULK_RELEASE = true;
+
+    CompactBucket(): _root(0) {}
+
+    //preconditions: none
+    //postconditions: returns true if the record inserted, otherwise false.
+    bool insert(const T& entry, pool_type& pool)
+    {
+        return tree_type::insert(_root, entry, pool);
+    }
+
+    //preconditions: none
+    //postconditions: returns true if the record with the key was removed, otherwise false.
+    bool erase(int key, pool_type& pool)
+    {
+        return tree_type::erase(_root, T(key), pool);
+    }
+
+    //preconditions: none
+    //postconditions: returns the record with the key (valid until the next insert), or null.
+    T* search(int key, pool_type& pool)
+    {
+        return tree_type::search(_root, T(key), pool);
+    }
+
+    //preconditions: none
+    //postconditions: every node is returned to the pool.
+    void clear(pool_type& pool)
+    {
+        tree_type::clear(_root, pool);
+    }
+
+    //preconditions: this bucket is empty.
+    //postconditions: this bucket holds a copy of from, whose nodes live in fromPool.
+    void copy(const CompactBucket<T>& from, const pool_type& fromPool, pool_type& pool)
+    {
+        assert(!_root);
+        _root = tree_type::copy(from._root, fromPool, pool);
+    }
+
+    //preconditions: out has room for every record of the bucket.
+    //postconditions: the records are copied to out in key order, the count is returned.
+    size_t flatten(T* out, const pool_type& pool) const
+    {
+        return tree_type::flatten(_root, pool, out);
+    }
+
+    //preconditions: none
+    //postconditions: the tree is printed from right to left.
+    void print(ostream& outs, const pool_type& pool) const
+    {
+        tree_type::print(_root, pool, 0, outs);
+    }
+
+    //preconditions: none
+    //postconditions: returns true if the bucket holds no record.
+    inline bool empty() const
+    {
+        return _root == 0;
+    }
+
+    //preconditions: none
+    //postconditions: returns null, the records are not in a tree_node tree, so a batched lookup
+    // searches the bucket whole.
+    inline tree_node<T>* tree() const
+    {
+        return nullptr;
+    }
+
+private:
+    uint32_t _root;
+};
+
+#endif // COMPACT_BUCKET_H
@@ -0,0 +1,897 @@
+#ifndef CONCURRENT_AVL_H
+#define CONCURRENT_AVL_H
+
+#include <cstdlib>
+#include <cassert>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "epoch.h"
+
+using namespace std;
+
+//A one byte spin lock for the nodes of a ConcurrentAVL, a node is only locked for the few
+// stores of an insert, unlink or rotation. Usable with lock_guard.
+struct concurrent_lock
+{
+    atomic<bool> _held;
+
+    concurrent_lock(): _held(false) {}
+
+    void lock()
+    {
+        while(_held.exchange(true, memory_order_acquire))
+        {
+            while(_held.load(memory_order_relaxed))
+                this_thread::yield();
+        }
+    }
+
+    void unlock()
+    {
+        _held.store(false, memory_order_release);
+    }
+};
+
+//A node of a ConcurrentAVL. _item is the immutable key the node is ordered by, _value is the
+// record stored under it or null for a routing node (a removed record whose node still has two
+// children). _version is the optimistic version: bit 0 is set once the node is unlinked, bit 1
+// while a rotation is moving the node down, and every completed rotation adds VERSION_STEP.
+template <typename T>
+struct concurrent_node
+{
+    const T _item;
+    atomic<const T*> _value;
+    atomic<concurrent_node<T>*> _left;
+    atomic<concurrent_node<T>*> _right;
+    atomic<concurrent_node<T>*> _parent;
+    atomic<int> _height;        //a leaf has a height of 1, null has a height of 0.
+    atomic<uint64_t> _version;
+    concurrent_lock _lock;
+
+    concurrent_node(const T& item, const T* value, concurrent_node<T>* parent, int height):
+        _item(item), _value(value), _left(nullptr), _right(nullptr), _parent(parent), _height(height), _version(0) {}
+
+    //preconditions: dir is -1 (left) or 1 (right).
+    //postconditions: returns the child in that direction.
+    concurrent_node<T>* child(int dir) const
+    {
+        return (dir < 0) ? _left.load() : _right.load();
+    }
+};
+
+//An AVL tree that may be used by many threads at once, in the style of Bronson, Casper, Chafi
+// and Olukotun, "A Practical Concurrent Binary Search Tree". Searches never take a lock: they
+// read the version of every node on the way down and retry from the last node whose version
+// is unchanged if a rotation moved the node away. Inserts and erases lock only the node they
+// modify and its parent, rebalancing locks the nodes a rotation touches (parent before child).
+// Balance is relaxed while writers run and restored once they finish. Every operation runs inside
+// an epoch guard, removed records and unlinked nodes are retired to an EpochManager and freed once
+// no operation that could still reach them is running, so a reader never sees freed memory.
+template <typename T>
+class ConcurrentAVL
+{
+public:
+    ConcurrentAVL();
+    ~ConcurrentAVL();
+
+    bool insert(const T& insert_me);            //returns true if inserted, false if the value is already present.
+    bool erase(const T& target);                //returns true if the value was removed.
+    bool search(const T& target, T& result) const; //returns true and the stored value if it is present.
+
+    bool isBalanced() const;                    //requires that no writer is running.
+
+    //preconditions: none
+    //postconditions: returns the number of values in the tree.
+    size_t size() const
+    {
+        return _size.load(memory_order_relaxed);
+    }
+
+private:
+    typedef concurrent_node<T> node;
+
+    //the result of one optimistic attempt.
+    enum attempt_result {RETRY, FOUND, NOT_FOUND};
+
+    //the conditions returned by node_condition in place of a new height.
+    static const int NOTHING_REQUIRED = -1;
+    static const int UNLINK_REQUIRED = -2;
+    static const int REBALANCE_REQUIRED = -3;
+
+    static const uint64_t UNLINKED = 1;
+    static const uint64_t SHRINKING = 2;
+    static const uint64_t VERSION_STEP = 4;
+    static const int SPIN_COUNT = 100;
+
+    node _holder;               //a sentinel whose right child is the root, it is never rotated.
+    atomic<size_t> _size;
+
+    mutable EpochManager _epochs;   //frees the records and nodes that readers may still reach.
+
+    //not copyable.
+    ConcurrentAVL(const ConcurrentAVL<T>& other);
+    ConcurrentAVL<T>& operator=(const ConcurrentAVL<T>& rhs);
+
+    static int compare(const T& a, const T& b)
+    {
+        return (a < b) ? -1 : ((b < a) ? 1 : 0);
+    }
+
+    static int height(const node* n)
+    {
+        return (n) ? n->_height.load() : 0;
+    }
+
+    static bool can_unlink(const node* n)
+    {
+        return !n->_left.load() || !n->_right.load();
+    }
+
+    static void set_child(node* parent, node* old_child, node* new_child)
+    {
+        if(parent->_left.load() == old_child)
+            parent->_left = new_child;
+        else
+            parent->_right = new_child;
+    }
+
+    static void wait_until_not_changing(node* n);
+
+    attempt_result attempt_search(const T& target, node* n, int dir, uint64_t version, T& result) const;
+    attempt_result attempt_insert(const T& insert_me, node* n, int dir, uint64_t version);
+    attempt_result attempt_insert_leaf(const T& insert_me, node* n, int dir, uint64_t version);
+    attempt_result attempt_revive(const T& insert_me, node* n);
+    attempt_result attempt_erase(const T& target, node* n, int dir, uint64_t version);
+    attempt_result attempt_remove_node(node* parent, node* n);
+
+    void retire(const T* value);
+    bool attempt_unlink(node* parent, node* n);
+
+    static int node_condition(node* n);
+    node* fix_height(node* n);
+    void fix_height_and_rebalance(node* n);
+    node* rebalance(node* parent, node* n);
+    node* rebalance_to_right(node* parent, node* n, node* left, int hR0);
+    node* rebalance_to_left(node* parent, node* n, node* right, int hL0);
+    node* rotate_right(node* parent, node* n, node* left, int hR, int hLL, node* leftRight, int hLR);
+    node* rotate_left(node* parent, node* n, int hL, node* right, node* rightLeft, int hRL, int hRR);
+    node* rotate_right_over_left(node* parent, node* n, node* left, int hR, int hLL, node* leftRight, int hLRL);
+    node* rotate_left_over_right(node* parent, node* n, int hL, node* right, node* rightLeft, int hRR, int hRLR);
+
+    static int verify(const node* n, bool& balanced);
+};
+
+//preconditions: none
+//postconditions: a new, empty tree is constructed.
+template <typename T>
+ConcurrentAVL<T>::ConcurrentAVL(): _holder(T(), nullptr, nullptr, 0), _size(0)
+{
+}
+
+//preconditions: no other thread is using the tree.
+//postconditions: every node and record is deallocated, the retired ones by _epochs.
+template <typename T>
+ConcurrentAVL<T>::~ConcurrentAVL()
+{
+    vector<node*> stack;
+    if(_holder._right.load())
+        stack.push_back(_holder._right.load());
+    while(!stack.empty())
+    {
+        node* n = stack.back();
+        stack.pop_back();
+        if(n->_left.load())
+            stack.push_back(n->_left.load());
+        if(n->_right.load())
+            stack.push_back(n->_right.load());
+        delete n->_value.load();
+        delete n;
+    }
+}
+
+//preconditions: none
+//postconditions: returns true and copies the stored value to result if target is present.
+// Lock free unless the search meets a node in the middle of a rotation.
+template <typename T>
+bool ConcurrentAVL<T>::search(const T& target, T& result) const
+{
+    EpochManager::guard guard(_epochs);
+    node* holder = const_cast<node*>(&_holder);
+    attempt_result found;
+    do
+    {
+        found = attempt_search(target, holder, 1, 0, result);
+    } while(found == RETRY);
+    return found == FOUND;
+}
+
+//preconditions: none
+//postconditions: returns true if insert_me was added, false if an equal value is already present.
+template <typename T>
+bool ConcurrentAVL<T>::insert(const T& insert_me)
+{
+    EpochManager::guard guard(_epochs);
+    attempt_result inserted;
+    do
+    {
+        inserted = attempt_insert(insert_me, &_holder, 1, 0);
+    } while(inserted == RETRY);
+
+    if(inserted == FOUND)
+        _size.fetch_add(1, memory_order_relaxed);
+    return inserted == FOUND;
+}
+
+//preconditions: none
+//postconditions: returns true if the value equal to target was removed.
+template <typename T>
+bool ConcurrentAVL<T>::erase(const T& target)
+{
+    EpochManager::guard guard(_epochs);
+    attempt_result erased;
+    do
+    {
+        erased = attempt_erase(target, &_holder, 1, 0);
+    } while(erased == RETRY);
+
+    if(erased == FOUND)
+        _size.fetch_sub(1, memory_order_relaxed);
+    return erased == FOUND;
+}
+
+//preconditions: none
+//postconditions: spin until the rotation moving n finishes, then wait on its lock.
+template <typename T>
+void ConcurrentAVL<T>::wait_until_not_changing(node* n)
+{
+    for(int i = 0; i < SPIN_COUNT; i++)
+    {
+        if(!(n->_version.load() & SHRINKING))
+            return;
+        this_thread::yield();
+    }
+    lock_guard<concurrent_lock> lock(n->_lock);
+}
+
+//preconditions: n was read with the given version, the target lies below n in direction dir.
+//postconditions: the child in direction dir is validated against the version of n before the
+// search descends into it. RETRY is returned if n moved since it was read, so the caller
+// can retry from its own (still valid) node instead of from the root.
+template <typename T>
+typename ConcurrentAVL<T>::attempt_result ConcurrentAVL<T>::attempt_search(const T& target, node* n, int dir, uint64_t version, T& result) const
+{
+    while(true)
+    {
+        node* child = n->child(dir);
+        if(n->_version.load() != version)
+            return RETRY;
+        if(!child)
+            return NOT_FOUND;
+
+        int next = compare(target, child->_item);
+        if(next == 0)
+        {
+            const T* value = child->_value.load();
+            if(!value)
+                return NOT_FOUND;
+            result = *value;
+            return FOUND;
+        }
+
+        uint64_t childVersion = child->_version.load();
+        if(childVersion & SHRINKING)
+        {
+            wait_until_not_changing(child);
+        }
+        else if(!(childVersion & UNLINKED) && child == n->child(dir))
+        {
+            if(n->_version.load() != version)
+                return RETRY;
+            attempt_result found = attempt_search(target, child, next, childVersion, result);
+            if(found != RETRY)
+                return found;
+        }
+    }
+}
+
+//preconditions: n was read with the given version.
+//postconditions: descends like attempt_search, then adds a leaf or revives a routing node.
+// Returns FOUND if insert_me was added, NOT_FOUND if it is a duplicate.
+template <typename T>
+typename ConcurrentAVL<T>::attempt_result ConcurrentAVL<T>::attempt_insert(const T& insert_me, node* n, int dir, uint64_t version)
+{
+    attempt_result inserted = RETRY;
+    do
+    {
+        node* child = n->child(dir);
+        if(n->_version.load() != version)
+            return RETRY;
+
+        if(!child)
+        {
+            inserted = attempt_insert_leaf(insert_me, n, dir, version);
+        }
+        else
+        {
+            int next = compare(insert_me, child->_item);
+            if(next == 0)
+            {
+                inserted = attempt_revive(insert_me, child);
+            }
+            else
+            {
+                uint64_t childVersion = child->_version.load();
+                if(childVersion & SHRINKING)
+                {
+                    wait_until_not_changing(child);
+                }
+                else if(!(childVersion & UNLINKED) && child == n->child(dir))
+                {
+                    if(n->_version.load() != version)
+                        return RETRY;
+                    inserted = attempt_insert(insert_me, child, next, childVersion);
+                }
+            }
+        }
+    } while(inserted == RETRY);
+    return inserted;
+}
+
+//preconditions: n was read with the given version and had no child in direction dir.
+//postconditions: a new leaf holding insert_me is linked under n (with n locked) and the
+// heights are repaired, RETRY is returned if n changed in the meantime.
+template <typename T>
+typename ConcurrentAVL<T>::attempt_result ConcurrentAVL<T>::attempt_insert_leaf(const T& insert_me, node* n, int dir, uint64_t version)
+{
+    node* damaged;
+    {
+        lock_guard<concurrent_lock> lock(n->_lock);
+        if(n->_version.load() != version || n->child(dir))
+            return RETRY;
+
+        node* leaf = new node(insert_me, new T(insert_me), n, 1);
+        if(dir < 0)
+            n->_left = leaf;
+        else
+            n->_right = leaf;
+        damaged = fix_height(n);
+    }
+    fix_height_and_rebalance(damaged);
+    return FOUND;
+}
+
+//preconditions: n holds a value equal to insert_me.
+//postconditions: if n is a routing node it takes insert_me as its value and FOUND is returned,
+// NOT_FOUND is returned if n already holds a value.
+template <typename T>
+typename ConcurrentAVL<T>::attempt_result ConcurrentAVL<T>::attempt_revive(const T& insert_me, node* n)
+{
+    lock_guard<concurrent_lock> lock(n->_lock);
+    if(n->_version.load() & UNLINKED)
+        return RETRY;
+    if(n->_value.load())
+        return NOT_FOUND;
+    n->_value = new T(insert_me);
+    return FOUND;
+}
+
+//preconditions: n was read with the given version.
+//postconditions: descends like attempt_search, then removes the node equal to target.
+// Returns FOUND if a value was removed, NOT_FOUND if target is not present.
+template <typename T>
+typename ConcurrentAVL<T>::attempt_result ConcurrentAVL<T>::attempt_erase(const T& target, node* n, int dir, uint64_t version)
+{
+    attempt_result erased = RETRY;
+    do
+    {
+        node* child = n->child(dir);
+        if(n->_version.load() != version)
+            return RETRY;
+        if(!child)
+            return NOT_FOUND;
+
+        int next = compare(target, child->_item);
+        if(next == 0)
+        {
+            erased = attempt_remove_node(n, child);
+        }
+        else
+        {
+            uint64_t childVersion = child->_version.load();
+            if(childVersion & SHRINKING)
+            {
+                wait_until_not_changing(child);
+            }
+            else if(!(childVersion & UNLINKED) && child == n->child(dir))
+            {
+                if(n->_version.load() != version)
+                    return RETRY;
+                erased = attempt_erase(target, child, next, childVersion);
+            }
+        }
+    } while(erased == RETRY);
+    return erased;
+}
+
+//preconditions: parent was the parent of n when n was read.
+//postconditions: a node with two children keeps its place as a routing node (its value is
+// cleared), otherwise it is unlinked with both it and its parent locked and the heights
+// above it are repaired.
+template <typename T>
+typename ConcurrentAVL<T>::attempt_result ConcurrentAVL<T>::attempt_remove_node(node* parent, node* n)
+{
+    if(!n->_value.load())
+        return NOT_FOUND;
+
+    const T* previous;
+    if(!can_unlink(n))
+    {
+        lock_guard<concurrent_lock> lock(n->_lock);
+        if((n->_version.load() & UNLINKED) || can_unlink(n))
+            return RETRY;
+        previous = n->_value.load();
+        if(!previous)
+            return NOT_FOUND;
+        n->_value = nullptr;
+    }
+    else
+    {
+        node* damaged;
+        {
+            lock_guard<concurrent_lock> parentLock(parent->_lock);
+            if((parent->_version.load() & UNLINKED) || n->_parent.load() != parent)
+                return RETRY;
+
+            lock_guard<concurrent_lock> lock(n->_lock);
+            previous = n->_value.load();
+            if(!previous)
+                return NOT_FOUND;
+            if(!attempt_unlink(parent, n))
+                return RETRY;
+            damaged = fix_height(parent);
+        }
+        fix_height_and_rebalance(damaged);
+    }
+
+    retire(previous);
+    return FOUND;
+}
+
+//preconditions: value is no longer reachable from the tree.
+//postconditions: value is freed once every operation that may still hold it has finished.
+template <typename T>
+void ConcurrentAVL<T>::retire(const T* value)
+{
+    _epochs.retire(const_cast<T*>(value));
+}
+
+//preconditions: parent and n are locked.
+//postconditions: if n is a child of parent with at most one child, that child takes its place,
+// n is marked unlinked and retired, and true is returned. Otherwise false is returned.
+template <typename T>
+bool ConcurrentAVL<T>::attempt_unlink(node* parent, node* n)
+{
+    node* parentLeft = parent->_left.load();
+    node* parentRight = parent->_right.load();
+    if(parentLeft != n && parentRight != n)
+        return false;
+
+    node* left = n->_left.load();
+    node* right = n->_right.load();
+    if(left && right)
+        return false;
+
+    node* splice = (left) ? left : right;
+    if(parentLeft == n)
+        parent->_left = splice;
+    else
+        parent->_right = splice;
+    if(splice)
+        splice->_parent = parent;
+
+    n->_version = UNLINKED;
+    n->_value = nullptr;
+    _epochs.retire(n);
+    return true;
+}
+
+//preconditions: none
+//postconditions: returns UNLINK_REQUIRED for a routing node with less than two children,
+// REBALANCE_REQUIRED if the children differ in height by more than one, NOTHING_REQUIRED
+// if the stored height is correct, otherwise the correct height.
+template <typename T>
+int ConcurrentAVL<T>::node_condition(node* n)
+{
+    node* left = n->_left.load();
+    node* right = n->_right.load();
+    if((!left || !right) && !n->_value.load())
+        return UNLINK_REQUIRED;
+
+    int hN = n->_height.load();
+    int hL0 = height(left);
+    int hR0 = height(right);
+    int hNRepl = 1 + std::max(hL0, hR0);
+    int balance = hL0 - hR0;
+
+    if(balance < -1 || balance > 1)
+        return REBALANCE_REQUIRED;
+    return (hN != hNRepl) ? hNRepl : NOTHING_REQUIRED;
+}
+
+//preconditions: n is locked.
+//postconditions: the height of n is corrected. Returns the next node that needs repair:
+// n itself if it must be rebalanced or unlinked, its parent if its height changed, or null.
+template <typename T>
+typename ConcurrentAVL<T>::node* ConcurrentAVL<T>::fix_height(node* n)
+{
+    int condition = node_condition(n);
+    switch(condition)
+    {
+    case REBALANCE_REQUIRED:
+    case UNLINK_REQUIRED:
+        return n;
+    case NOTHING_REQUIRED:
+        return nullptr;
+    default:
+        n->_height = condition;
+        return n->_parent.load();
+    }
+}
+
+//preconditions: none
+//postconditions: the damage left by an insert, erase or rotation is repaired from n up
+// towards the root until a node needs nothing. Heights are fixed with only the node locked,
+// rotations and unlinks lock the parent and then the node. A rotation may hand back a node
+// below it that needs repair first, so the nodes it moved are revisited afterwards: their
+// heights were computed from children that another thread may have been fixing meanwhile.
+template <typename T>
+void ConcurrentAVL<T>::fix_height_and_rebalance(node* n)
+{
+    vector<node*> pending;
+    while(true)
+    {
+        int condition = (n && n->_parent.load()) ? node_condition(n) : NOTHING_REQUIRED;
+        if(condition == NOTHING_REQUIRED || (n->_version.load() & UNLINKED))
+        {
+            if(pending.empty())
+                return;
+            n = pending.back();
+            pending.pop_back();
+        }
+        else if(condition != UNLINK_REQUIRED && condition != REBALANCE_REQUIRED)
+        {
+            lock_guard<concurrent_lock> lock(n->_lock);
+            n = fix_height(n);
+        }
+        else
+        {
+            node* parent = n->_parent.load();
+            lock_guard<concurrent_lock> parentLock(parent->_lock);
+            if(!(parent->_version.load() & UNLINKED) && n->_parent.load() == parent)
+            {
+                lock_guard<concurrent_lock> lock(n->_lock);
+                node* rotated[] = {parent, n->_left.load(), n->_right.load(), n};
+                n = rebalance(parent, n);
+                pending.insert(pending.end(), rotated, rotated + 4);
+            }
+        }
+    }
+}
+
+//preconditions: parent and n are locked, n is a child of parent.
+//postconditions: n is unlinked if it is a routing node with less than two children, rotated if
+// it is out of balance, or its height is fixed. Returns the next node that needs repair.
+template <typename T>
+typename ConcurrentAVL<T>::node* ConcurrentAVL<T>::rebalance(node* parent, node* n)
+{
+    node* left = n->_left.load();
+    node* right = n->_right.load();
+
+    if((!left || !right) && !n->_value.load())
+        return (attempt_unlink(parent, n)) ? fix_height(parent) : n;
+
+    int hN = n->_height.load();
+    int hL0 = height(left);
+    int hR0 = height(right);
+    int hNRepl = 1 + std::max(hL0, hR0);
+    int balance = hL0 - hR0;
+
+    if(balance > 1)
+        return rebalance_to_right(parent, n, left, hR0);
+    if(balance < -1)
+        return rebalance_to_left(parent, n, right, hL0);
+    if(hNRepl != hN)
+    {
+        n->_height = hNRepl;
+        return fix_height(parent);
+    }
+    return nullptr;
+}
+
+//preconditions: parent and n are locked, the left subtree of n is too tall.
+//postconditions: the left child is locked (and its right child, for a double rotation) and
+// n is rotated right, or right over left. Returns n if the heights changed under us.
+template <typename T>
+typename ConcurrentAVL<T>::node* ConcurrentAVL<T>::rebalance_to_right(node* parent, node* n, node* left, int hR0)
+{
+    lock_guard<concurrent_lock> leftLock(left->_lock);
+    int hL = left->_height.load();
+    if(hL - hR0 <= 1)
+        return n;
+
+    node* leftRight = left->_right.load();
+    int hLL0 = height(left->_left.load());
+    int hLR0 = height(leftRight);
+    if(hLL0 >= hLR0)
+        return rotate_right(parent, n, left, hR0, hLL0, leftRight, hLR0);
+
+    {
+        lock_guard<concurrent_lock> leftRightLock(leftRight->_lock);
+        int hLR = leftRight->_height.load();
+        if(hLL0 >= hLR)
+            return rotate_right(parent, n, left, hR0, hLL0, leftRight, hLR);
+
+        int hLRL = height(leftRight->_left.load());
+        int balance = hLL0 - hLRL;
+        if(balance >= -1 && balance <= 1)
+        {
+            //a double rotation would leave the routing node left with a single child,
+            // unlink it (or first rotate it down to one child) instead.
+            if(left->_value.load())
+                return rotate_right_over_left(parent, n, left, hR0, hLL0, leftRight, hLRL);
+            if(hLL0 == 0)
+                return left;
+            if(hLRL == 0)
+                return rotate_left(n, left, hLL0, leftRight, nullptr, 0, height(leftRight->_right.load()));
+            return rotate_right_over_left(parent, n, left, hR0, hLL0, leftRight, hLRL);
+        }
+    }
+    //the left child must be rebalanced first.
+    return rebalance_to_left(n, left, leftRight, hLL0);
+}
+
+//preconditions: parent and n are locked, the right subtree of n is too tall.
+//postconditions: the mirror of rebalance_to_right.
+template <typename T>
+typename ConcurrentAVL<T>::node* ConcurrentAVL<T>::rebalance_to_left(node* parent, node* n, node* right, int hL0)
+{
+    lock_guard<concurrent_lock> rightLock(right->_lock);
+    int hR = right->_height.load();
+    if(hL0 - hR >= -1)
+        return n;
+
+    node* rightLeft = right->_left.load();
+    int hRL0 = height(rightLeft);
+    int hRR0 = height(right->_right.load());
+    if(hRR0 >= hRL0)
+        return rotate_left(parent, n, hL0, right, rightLeft, hRL0, hRR0);
+
+    {
+        lock_guard<concurrent_lock> rightLeftLock(rightLeft->_lock);
+        int hRL = rightLeft->_height.load();
+        if(hRR0 >= hRL)
+            return rotate_left(parent, n, hL0, right, rightLeft, hRL, hRR0);
+
+        int hRLR = height(rightLeft->_right.load());
+        int balance = hRR0 - hRLR;
+        if(balance >= -1 && balance <= 1)
+        {
+            //a double rotation would leave the routing node right with a single child,
+            // unlink it (or first rotate it down to one child) instead.
+            if(right->_value.load())
+                return rotate_left_over_right(parent, n, hL0, right, rightLeft, hRR0, hRLR);
+            if(hRR0 == 0)
+                return right;
+            if(hRLR == 0)
+                return rotate_right(n, right, rightLeft, hRR0, height(rightLeft->_left.load()), nullptr, 0);
+            return rotate_left_over_right(parent, n, hL0, right, rightLeft, hRR0, hRLR);
+        }
+    }
+    //the right child must be rebalanced first.
+    return rebalance_to_right(n, right, rightLeft, hRR0);
+}
+
+//preconditions: parent, n and left are locked.
+//postconditions: left takes the place of n, n moves down to the right. n is marked SHRINKING
+// for the duration so searches passing through it wait or retry. Returns the next node that
+// needs repair.
+template <typename T>
+typename ConcurrentAVL<T>::node* ConcurrentAVL<T>::rotate_right(node* parent, node* n, node* left, int hR, int hLL, node* leftRight, int hLR)
+{
+    uint64_t version = n->_version.load();
+    n->_version = version | SHRINKING;
+
+    n->_left = leftRight;
+    if(leftRight)
+        leftRight->_parent = n;
+    left->_right = n;
+    n->_parent = left;
+    set_child(parent, n, left);
+    left->_parent = parent;
+
+    int hNRepl = 1 + std::max(hLR, hR);
+    n->_height = hNRepl;
+    left->_height = 1 + std::max(hLL, hNRepl);
+
+    n->_version = version + VERSION_STEP;
+
+    int balanceN = hLR - hR;
+    if(balanceN < -1 || balanceN > 1)
+        return n;
+    if((!leftRight || hR == 0) && !n->_value.load())
+        return n;
+    int balanceL = hLL - hNRepl;
+    if(balanceL < -1 || balanceL > 1)
+        return left;
+    if(hLL == 0 && !left->_value.load())
+        return left;
+    return fix_height(parent);
+}
+
+//preconditions: parent, n and right are locked.
+//postconditions: the mirror of rotate_right.
+template <typename T>
+typename ConcurrentAVL<T>::node* ConcurrentAVL<T>::rotate_left(node* parent, node* n, int hL, node* right, node* rightLeft, int hRL, int hRR)
+{
+    uint64_t version = n->_version.load();
+    n->_version = version | SHRINKING;
+
+    n->_right = rightLeft;
+    if(rightLeft)
+        rightLeft->_parent = n;
+    right->_left = n;
+    n->_parent = right;
+    set_child(parent, n, right);
+    right->_parent = parent;
+
+    int hNRepl = 1 + std::max(hL, hRL);
+    n->_height = hNRepl;
+    right->_height = 1 + std::max(hNRepl, hRR);
+
+    n->_version = version + VERSION_STEP;
+
+    int balanceN = hRL - hL;
+    if(balanceN < -1 || balanceN > 1)
+        return n;
+    if((!rightLeft || hL == 0) && !n->_value.load())
+        return n;
+    int balanceR = hRR - hNRepl;
+    if(balanceR < -1 || balanceR > 1)
+        return right;
+    if(hRR == 0 && !right->_value.load())
+        return right;
+    return fix_height(parent);
+}
+
+//preconditions: parent, n, left and leftRight are locked.
+//postconditions: leftRight takes the place of n with left and n as its children, both n and
+// left are marked SHRINKING for the duration. Returns the next node that needs repair.
+template <typename T>
+typename ConcurrentAVL<T>::node* ConcurrentAVL<T>::rotate_right_over_left(node* parent, node* n, node* left, int hR, int hLL, node* leftRight, int hLRL)
+{
+    uint64_t version = n->_version.load();
+    uint64_t leftVersion = left->_version.load();
+    node* leftRightLeft = leftRight->_left.load();
+    node* leftRightRight = leftRight->_right.load();
+    int hLRR = height(leftRightRight);
+
+    n->_version = version | SHRINKING;
+    left->_version = leftVersion | SHRINKING;
+
+    n->_left = leftRightRight;
+    if(leftRightRight)
+        leftRightRight->_parent = n;
+    left->_right = leftRightLeft;
+    if(leftRightLeft)
+        leftRightLeft->_parent = left;
+    leftRight->_left = left;
+    left->_parent = leftRight;
+    leftRight->_right = n;
+    n->_parent = leftRight;
+    set_child(parent, n, leftRight);
+    leftRight->_parent = parent;
+
+    int hNRepl = 1 + std::max(hLRR, hR);
+    n->_height = hNRepl;
+    int hLRepl = 1 + std::max(hLL, hLRL);
+    left->_height = hLRepl;
+    leftRight->_height = 1 + std::max(hLRepl, hNRepl);
+
+    n->_version = version + VERSION_STEP;
+    left->_version = leftVersion + VERSION_STEP;
+
+    int balanceN = hLRR - hR;
+    if(balanceN < -1 || balanceN > 1)
+        return n;
+    if((!leftRightRight || hR == 0) && !n->_value.load())
+        return n;
+    int balanceLR = hLRepl - hNRepl;
+    if(balanceLR < -1 || balanceLR > 1)
+        return leftRight;
+    return fix_height(parent);
+}
+
+//preconditions: parent, n, right and rightLeft are locked.
+//postconditions: the mirror of rotate_right_over_left.
+template <typename T>
+typename ConcurrentAVL<T>::node* ConcurrentAVL<T>::rotate_left_over_right(node* parent, node* n, int hL, node* right, node* rightLeft, int hRR, int hRLR)
+{
+    uint64_t version = n->_version.load();
+    uint64_t rightVersion = right->_version.load();
+    node* rightLeftLeft = rightLeft->_left.load();
+    node* rightLeftRight = rightLeft->_right.load();
+    int hRLL = height(rightLeftLeft);
+
+    n->_version = version | SHRINKING;
+    right->_version = rightVersion | SHRINKING;
+
+    n->_right = rightLeftLeft;
+    if(rightLeftLeft)
+        rightLeftLeft->_parent = n;
+    right->_left = rightLeftRight;
+    if(rightLeftRight)
+        rightLeftRight->_parent = right;
+    rightLeft->_right = right;
+    right->_parent = rightLeft;
+    rightLeft->_left = n;
+    n->_parent = rightLeft;
+    set_child(parent, n, rightLeft);
+    rightLeft->_parent = parent;
+
+    int hNRepl = 1 + std::max(hL, hRLL);
+    n->_height = hNRepl;
+    int hRRepl = 1 + std::max(hRLR, hRR);
+    right->_height = hRRepl;
+    rightLeft->_height = 1 + std::max(hNRepl, hRRepl);
+
+    n->_version = version + VERSION_STEP;
+    right->_version = rightVersion + VERSION_STEP;
+
+    int balanceN = hRLL - hL;
+    if(balanceN < -1 || balanceN > 1)
+        return n;
+    if((!rightLeftLeft || hL == 0) && !n->_value.load())
+        return n;
+    int balanceRL = hRRepl - hNRepl;
+    if(balanceRL < -1 || balanceRL > 1)
+        return rightLeft;
+    return fix_height(parent);
+}
+
+//preconditions: no writer is running.
+//postconditions: returns true if the keys are in order, every stored height is correct and
+// no node is out of balance.
+template <typename T>
+bool ConcurrentAVL<T>::isBalanced() const
+{
+    bool balanced = true;
+    verify(_holder._right.load(), balanced);
+    return balanced;
+}
+
+//preconditions: none
+//postconditions: returns the height of the subtree, balanced is set to false on any violation.
+template <typename T>
+int ConcurrentAVL<T>::verify(const node* n, bool& balanced)
+{
+    if(!n)
+        return 0;
+
+    const node* left = n->_left.load();
+    const node* right = n->_right.load();
+    if((left && !(left->_item < n->_item)) || (right && !(n->_item < right->_item)))
+        balanced = false;
+    if((!left || !right) && !n->_value.load())
+        balanced = false;
+
+    int hL = verify(left, balanced);
+    int hR = verify(right, balanced);
+    if(hL - hR < -1 || hL - hR > 1 || n->_height.load() != 1 + std::max(hL, hR))
+        balanced = false;
+    return 1 + std::max(hL, hR);
+}
+
+#endif // CONCURRENT_AVL_H
@@ -0,0 +1,359 @@
+#ifndef CONCURRENT_OPENHASH_H
+#define CONCURRENT_OPENHASH_H
+
+#include <cstdlib>
+#include <cstdint>
+#include <cassert>
+#include <atomic>
+#include <mutex>
+#include <record.h>
+#include "hash_functions.h"
+#include "epoch.h"
+
+using namespace std;
+
+//A linear probing table that grows while other threads use it. Lookups never take a lock and
+// never wait: a reader enters an epoch, starts at the oldest slot array still in use and follows
+// the array it is being migrated into if the key is not found. Writers take turns on one mutex.
+// Once the slots in use pass MAX_LOAD_PERCENT a new array (twice as large, or as large if most of
+// them are flags) is linked behind the current one, new records go there, and every later insert
+// and remove moves the next MIGRATE_STEP slots over, so the cost of growing is spread over the
+// writes instead of stopping the world. A record is moved before its old slot is flagged, so a reader that
+// finds the flag also finds the record in the new array. Each record lives in its own allocation
+// that a slot points to, so moving it is one pointer store and readers never see a torn record.
+// The old array, and every removed record, is reclaimed through an EpochManager once no reader
+// can still reach it.
+template <typename T>
+class ConcurrentOpenHash
+{
+public:
+    ConcurrentOpenHash(size_t capacity = 17);           //an empty table of capacity slots.
+    ~ConcurrentOpenHash();
+
+    //not copyable.
+    ConcurrentOpenHash(const ConcurrentOpenHash<T>&) = delete;
+    ConcurrentOpenHash<T>& operator=(const ConcurrentOpenHash<T>&) = delete;
+
+    bool insert(const T& entry);                        //returns true if the record inserted, otherwise false.
+    bool remove(int key);                               //returns true if the record with the key was removed, otherwise false.
+    bool is_present(int key) const;                     //returns true if the key exists, otherwise false.
+    void find(int key, bool& found, T& result) const;   //returns found = true, result = record with key if the key exists.
+
+    //preconditions: none
+    //postconditions: returns the number of records.
+    inline size_t size() const
+    {
+        return _size.load(memory_order_relaxed);
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of slots of the newest array.
+    inline size_t capacity() const
+    {
+        lock_guard<mutex> guard(_writer);
+        return newest()->_capacity;
+    }
+
+    //preconditions: none
+    //postconditions: returns true while the records are being moved to a new array.
+    inline bool resizing() const
+    {
+        lock_guard<mutex> guard(_writer);
+        return _data.load(memory_order_relaxed)->_next.load(memory_order_relaxed) != nullptr;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of times a new array was started.
+    inline size_t resizes() const
+    {
+        lock_guard<mutex> guard(_writer);
+        return _resizes;
+    }
+
+    //preconditions: none
+    //postconditions: returns the epoch manager, for its reclamation counters.
+    inline const EpochManager& epochs() const
+    {
+        return _epochs;
+    }
+
+private:
+    static const int NEVER_USED = -1;
+    static const int PREVIOUSLY_USED = -2;
+    static const size_t MIGRATE_STEP = 16;      //slots of the old array moved by every insert and remove.
+    static const size_t MAX_LOAD_PERCENT = 50;  //the share of slots in use (records and flags) that starts a resize.
+
+    //the key is written after the record pointer, so a reader that sees the key sees the record.
+    struct slot
+    {
+        atomic<int> _key;
+        atomic<const T*> _record;
+    };
+
+    //one generation of slots. _next is the array the records are moving to, or null.
+    struct slot_array
+    {
+        size_t _capacity;
+        slot* _slots;
+        atomic<slot_array*> _next;
+        size_t _used;           //slots that are not NEVER_USED, only touched by writers.
+
+        slot_array(size_t capacity);
+        ~slot_array();
+    };
+
+    atomic<slot_array*> _data;      //the oldest array still in use, where readers start.
+    atomic<size_t> _size;
+    mutable mutex _writer;          //writers take turns, readers never take it.
+    size_t _migrated;               //slots of _data already moved, while it has a _next.
+    size_t _resizes;
+    mutable EpochManager _epochs;
+
+    slot* search(const slot_array* a, int key) const;  //the slot holding the key in a, or null.
+    void place(slot_array* a, int key, const T* record); //store a record in the first vacant slot.
+    void start_resize();                        //link a new array behind the current one.
+    void migrate_step();                        //move the next MIGRATE_STEP slots of _data.
+
+    //preconditions: the writer lock is held.
+    //postconditions: returns the array new records go to, the last one of the chain.
+    inline slot_array* newest() const
+    {
+        slot_array* a = _data.load(memory_order_relaxed);
+        slot_array* next = a->_next.load(memory_order_relaxed);
+        return (next) ? next : a;
+    }
+
+    //preconditions: none
+    //postconditions: returns the home slot of the key in an array of that capacity.
+    inline static size_t hash(int key, size_t capacity)
+    {
+        return hash_reduce(uint32_t(hash_mix(key)), capacity);
+    }
+};
+
+//preconditions: capacity > 0
+//postconditions: every slot is NEVER_USED.
+template <typename T>
+ConcurrentOpenHash<T>::slot_array::slot_array(size_t capacity): _next(nullptr)
+{
+    _capacity = capacity;
+    _slots = new slot[capacity];
+    for(size_t i = 0; i < capacity; i++)
+    {
+        _slots[i]._key.store(NEVER_USED, memory_order_relaxed);
+        _slots[i]._record.store(nullptr, memory_order_relaxed);
+    }
+    _used = 0;
+}
+
+//preconditions: no reader can reach the array.
+//postconditions: the slots are released, the records they point to are not.
+template <typename T>
+ConcurrentOpenHash<T>::slot_array::~slot_array()
+{
+    delete [] _slots;
+}
+
+//preconditions: capacity > 1
+//postconditions: one empty array of capacity slots.
+template <typename T>
+ConcurrentOpenHash<T>::ConcurrentOpenHash(size_t capacity): _data(new slot_array(capacity)), _size(0)
+{
+    assert(capacity > 1);
+    _migrated = 0;
+    _resizes = 0;
+}
+
+//preconditions: no thread uses the table.
+//postconditions: the records and arrays are released. A record that is still being migrated is
+// owned by the slot of the old array, the flagged slots of the old array own nothing.
+template <typename T>
+ConcurrentOpenHash<T>::~ConcurrentOpenHash()
+{
+    slot_array* a = _data.load(memory_order_relaxed);
+    while(a)
+    {
+        for(size_t i = 0; i < a->_capacity; i++)
+            if(a->_slots[i]._key.load(memory_order_relaxed) >= 0)
+                delete a->_slots[i]._record.load(memory_order_relaxed);
+        slot_array* next = a->_next.load(memory_order_relaxed);
+        delete a;
+        a = next;
+    }
+}
+
+//preconditions: key must be a non-negative integer.
+//postconditions: the record is placed in the newest array unless its key is present in any
+// array. A resize starts once the newest array passes MAX_LOAD_PERCENT, and one migration step runs.
+template <typename T>
+bool ConcurrentOpenHash<T>::insert(const T& entry)
+{
+    assert(entry.key >= 0);
+    lock_guard<mutex> guard(_writer);
+    migrate_step();
+
+    for(slot_array* a = _data.load(memory_order_relaxed); a; a = a->_next.load(memory_order_relaxed))
+        if(search(a, entry.key))
+            return false;
+
+    slot_array* target = newest();
+    if(100 * (target->_used + 1) > MAX_LOAD_PERCENT * target->_capacity)
+    {
+        //a resize still running is finished first, so there are never more than two arrays.
+        while(_data.load(memory_order_relaxed)->_next.load(memory_order_relaxed))
+            migrate_step();
+        start_resize();
+        target = newest();
+    }
+
+    place(target, entry.key, new T(entry));
+    _size.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+//preconditions: key must be a non-negative integer.
+//postconditions: the slot of the key is flagged PREVIOUSLY_USED and its record retired, it is
+// freed once no reader can still hold it. Returns false if the key is not present.
+template <typename T>
+bool ConcurrentOpenHash<T>::remove(int key)
+{
+    assert(key >= 0);
+    lock_guard<mutex> guard(_writer);
+    migrate_step();
+
+    for(slot_array* a = _data.load(memory_order_relaxed); a; a = a->_next.load(memory_order_relaxed))
+    {
+        slot* s = search(a, key);
+        if(s)
+        {
+            const T* record = s->_record.load(memory_order_relaxed);
+            s->_key.store(PREVIOUSLY_USED, memory_order_release);
+            _epochs.retire(const_cast<T*>(record));
+            _size.fetch_sub(1, memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+//preconditions: none
+//postconditions: if the record with the recieved key exists in the table,
+// returns true, otherwise returns false.
+template <typename T>
+bool ConcurrentOpenHash<T>::is_present(int key) const
+{
+    bool found;
+    T result;
+    find(key, found, result);
+    return found;
+}
+
+//preconditions: none
+//postconditions: if the record with the recieved key exists in the table, found will be true and
+// the record will be returned by ref. The arrays are searched from the oldest, a key that is not
+// in one is looked for in the array it is migrating to. Never blocks.
+template <typename T>
+void ConcurrentOpenHash<T>::find(int key, bool& found, T& result) const
+{
+    EpochManager::guard inside(_epochs);
+    found = false;
+    for(const slot_array* a = _data.load(memory_order_acquire); a; a = a->_next.load(memory_order_acquire))
+    {
+        const slot* s = search(a, key);
+        if(s)
+        {
+            //the slot was reused if the key was removed meanwhile, the removal then counts as first.
+            const T* record = s->_record.load(memory_order_acquire);
+            found = (record->key == key);
+            if(found)
+                result = *record;
+            return;
+        }
+    }
+}
+
+//preconditions: a is reachable, by a reader inside an epoch or by the writer.
+//postconditions: the slots of a are probed from the home of the key until the key or a NEVER_USED
+// slot is found, or every slot was visited. Returns the slot holding the key, or null.
+template <typename T>
+typename ConcurrentOpenHash<T>::slot* ConcurrentOpenHash<T>::search(const slot_array* a, int key) const
+{
+    size_t index = hash(key, a->_capacity);
+    for(size_t count = 0; count < a->_capacity; count++)
+    {
+        int at = a->_slots[index]._key.load(memory_order_acquire);
+        if(at == key)
+            return &a->_slots[index];
+        if(at == NEVER_USED)
+            return nullptr;
+        index = (index + 1 < a->_capacity) ? index + 1 : 0;
+    }
+    return nullptr;
+}
+
+//preconditions: the writer lock is held, the key is not in a, a has a vacant slot.
+//postconditions: the record is stored in the first vacant slot from the home of the key. The
+// pointer is published before the key, so a reader that sees the key finds the record.
+template <typename T>
+void ConcurrentOpenHash<T>::place(slot_array* a, int key, const T* record)
+{
+    size_t index = hash(key, a->_capacity);
+    while(a->_slots[index]._key.load(memory_order_relaxed) >= 0)
+        index = (index + 1 < a->_capacity) ? index + 1 : 0;
+
+    slot& s = a->_slots[index];
+    if(s._key.load(memory_order_relaxed) == NEVER_USED)
+        a->_used++;
+    s._record.store(record, memory_order_release);
+    s._key.store(key, memory_order_release);
+}
+
+//preconditions: the writer lock is held, no resize is running.
+//postconditions: a new empty array is linked behind _data, twice as large unless fewer than half
+// of the slots in use hold records, then as large, which only drops the flags.
+template <typename T>
+void ConcurrentOpenHash<T>::start_resize()
+{
+    slot_array* current = _data.load(memory_order_relaxed);
+    size_t capacity = current->_capacity;
+    if(2 * _size.load(memory_order_relaxed) >= current->_used)
+        capacity = 2 * capacity + 1;
+
+    current->_next.store(new slot_array(capacity), memory_order_release);
+    _migrated = 0;
+    _resizes++;
+}
+
+//preconditions: the writer lock is held.
+//postconditions: while resizing, the next MIGRATE_STEP slots of _data are moved: each record is
+// placed in the new array before its old slot is flagged PREVIOUSLY_USED, the record itself is
+// shared and not copied. Once every slot is moved, the new array becomes _data and the old one
+// is retired, readers still in it follow _next to the records.
+template <typename T>
+void ConcurrentOpenHash<T>::migrate_step()
+{
+    slot_array* old = _data.load(memory_order_relaxed);
+    slot_array* next = old->_next.load(memory_order_relaxed);
+    if(!next)
+        return;
+
+    for(size_t i = 0; i < MIGRATE_STEP && _migrated < old->_capacity; i++, _migrated++)
+    {
+        slot& s = old->_slots[_migrated];
+        int key = s._key.load(memory_order_relaxed);
+        if(key >= 0)
+        {
+            place(next, key, s._record.load(memory_order_relaxed));
+            s._key.store(PREVIOUSLY_USED, memory_order_release);
+        }
+    }
+
+    if(_migrated == old->_capacity)
+    {
+        _data.store(next, memory_order_release);
+        _epochs.retire(old);
+        _migrated = 0;
+    }
+}
+
+#endif // CONCURRENT_OPENHASH_H
@@ -0,0 +1,265 @@
+#ifndef DISKHASH_H
+#define DISKHASH_H
+
+#include <cstdlib>
+#include <cstdint>
+#include <iostream>
+#include <cassert>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <record.h>
+#include "hash_functions.h"
+#include "extendiblehash.h"
+#include "buffer_pool.h"
+
+using namespace std;
+
+//An extendible hash table whose pages live in a file instead of memory. Only the directory of
+// page numbers (8 bytes per entry) and the depth of every page stay in memory, the pages are
+// extendible_page blocks read and written through a BufferPool with CLOCK eviction, so the table
+// holds as many records as the disk allows with a fixed amount of memory. A lookup pins one page,
+// a split pins two. The records are copied to the file byte for byte, so T must be trivially copyable.
+// An operation whose page cannot be read or written fails as if the record were absent (or the
+// insert refused), pool().failures() tells such failures apart.
+template <typename T, size_t PAGE_SLOTS = 256>
+class DiskHash
+{
+public:
+    DiskHash(const string& path, size_t poolFrames = 64);  //the file is created or truncated.
+
+    //the table owns its file.
+    DiskHash(const DiskHash<T, PAGE_SLOTS>&) = delete;
+    DiskHash<T, PAGE_SLOTS>& operator=(const DiskHash<T, PAGE_SLOTS>&) = delete;
+
+    bool insert(const T& entry);                        //returns true if the record inserted, otherwise false.
+    bool remove(int key);                               //returns true if the record with the key was removed, otherwise false.
+    bool is_present(int key) const;                     //returns true if the key exists, otherwise false.
+    void find(int key, bool& found, T& result) const;   //returns found = true, result = record with key if the key exists.
+    bool flush();                                       //write every modified page to the file, false if a write failed.
+
+    //preconditions: none
+    //postconditions: returns the current _size.
+    inline size_t size() const
+    {
+        return _size;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of slots of every page.
+    inline size_t capacity() const
+    {
+        return _depths.size() * PAGE_SLOTS;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of hash bits that index the directory.
+    inline size_t global_depth() const
+    {
+        return _globalDepth;
+    }
+
+    //preconditions: none
+    //postconditions: returns the buffer pool, for its page and I/O counters.
+    inline const BufferPool& pool() const
+    {
+        return _pool;
+    }
+
+private:
+    typedef extendible_page<T, PAGE_SLOTS> page_type;
+
+    static_assert(is_trivially_copyable<T>::value, "DiskHash stores records as raw bytes");
+    static const size_t MAX_GLOBAL_DEPTH = 24;  //the directory never exceeds 2^24 entries.
+
+    mutable BufferPool _pool;       //lookups pin pages, which updates the frames.
+    vector<uint64_t> _directory;    //2^_globalDepth page numbers.
+    vector<size_t> _depths;         //the depth of every page, so the directory is kept without reading pages.
+    size_t _globalDepth;
+    size_t _size;
+
+    bool split(uint64_t page, uint64_t h);      //split the page holding h, false at MAX_GLOBAL_DEPTH.
+
+    //preconditions: none
+    //postconditions: returns the directory entry of the hash, its top _globalDepth bits.
+    inline size_t directory_index(uint64_t h) const
+    {
+        return (_globalDepth) ? size_t(h >> (64 - _globalDepth)) : 0;
+    }
+
+    //preconditions: page < _depths.size()
+    //postconditions: the page is pinned and returned.
+    inline page_type* pin(uint64_t page) const
+    {
+        return static_cast<page_type*>(_pool.pin(page));
+    }
+};
+
+//preconditions: poolFrames >= 2, the file can be created.
+//postconditions: the file holds one empty page, global depth 0.
+template <typename T, size_t PAGE_SLOTS>
+DiskHash<T, PAGE_SLOTS>::DiskHash(const string& path, size_t poolFrames): _pool(path, sizeof(page_type), poolFrames)
+{
+    assert(poolFrames >= 2);
+    _globalDepth = 0;
+    _size = 0;
+
+    uint64_t first;
+    static_cast<page_type*>(_pool.allocate(first))->reset(0);
+    _pool.unpin(first, true);
+    _directory.push_back(first);
+    _depths.push_back(0);
+}
+
+//preconditions: none
+//postconditions: the entry is placed in the page of its hash, a full page is rebuilt or split first
+// exactly as in ExtendibleHash. Returns false if the key is already present, if the page cannot
+// split below MAX_GLOBAL_DEPTH, or if a page could not be read or written.
+template <typename T, size_t PAGE_SLOTS>
+bool DiskHash<T, PAGE_SLOTS>::insert(const T& entry)
+{
+    uint64_t h = hash_mix(entry.key);
+    size_t index;
+    while(true)
+    {
+        uint64_t page = _directory[directory_index(h)];
+        page_type* p = pin(page);
+        if(!p)
+            return false;
+        if(p->find(entry.key, h, index))
+        {
+            _pool.unpin(page, false);
+            return false;
+        }
+
+        if(!p->full())
+        {
+            p->place(entry);
+            _pool.unpin(page, true);
+            _size++;
+            return true;
+        }
+
+        if(p->sparse())
+        {
+            p->rebuild(nullptr);
+            _pool.unpin(page, true);
+            continue;
+        }
+
+        _pool.unpin(page, false);
+        if(!split(page, h))
+            return false;
+    }
+}
+
+//preconditions: key must be a non-negative integer.
+//postconditions: the record is flagged PREVIOUSLY_USED in its page, returns false if it is not
+// there or its page could not be read.
+template <typename T, size_t PAGE_SLOTS>
+bool DiskHash<T, PAGE_SLOTS>::remove(int key)
+{
+    assert(key >= 0);
+    uint64_t h = hash_mix(key);
+    uint64_t page = _directory[directory_index(h)];
+    page_type* p = pin(page);
+    if(!p)
+        return false;
+    size_t index;
+    bool found = p->find(key, h, index);
+    if(found)
+    {
+        p->erase(index);
+        _size--;
+    }
+    _pool.unpin(page, found);
+    return found;
+}
+
+//preconditions: none
+//postconditions: if the record with the recieved key exists in the table,
+// returns true, otherwise returns false.
+template <typename T, size_t PAGE_SLOTS>
+bool DiskHash<T, PAGE_SLOTS>::is_present(int key) const
+{
+    bool found;
+    T result;
+    find(key, found, result);
+    return found;
+}
+
+//preconditions: none
+//postconditions: if the record with the recieved key exists in the table,
+// found will be true and the record will be returned by ref. found is false if the page could
+// not be read.
+template <typename T, size_t PAGE_SLOTS>
+void DiskHash<T, PAGE_SLOTS>::find(int key, bool& found, T& result) const
+{
+    uint64_t h = hash_mix(key);
+    uint64_t page = _directory[directory_index(h)];
+    const page_type* p = pin(page);
+    found = false;
+    if(!p)
+        return;
+    size_t index;
+    found = p->find(key, h, index);
+    if(found)
+        result = p->_items[index];
+    _pool.unpin(page, false);
+}
+
+//preconditions: none
+//postconditions: every modified page is written to the file, returns false if a write failed.
+template <typename T, size_t PAGE_SLOTS>
+bool DiskHash<T, PAGE_SLOTS>::flush()
+{
+    return _pool.flush();
+}
+
+//preconditions: page holds the hash h.
+//postconditions: the page is split by its next hash bit into itself and a new page appended to
+// the file, the directory entries of the upper half of its range point to the new page. The
+// directory doubles first if the page already used every directory bit. Returns false (and
+// changes nothing) at MAX_GLOBAL_DEPTH or if the page could not be read or the new one allocated.
+template <typename T, size_t PAGE_SLOTS>
+bool DiskHash<T, PAGE_SLOTS>::split(uint64_t page, uint64_t h)
+{
+    size_t depth = _depths[page];
+    if(depth == _globalDepth && _globalDepth == MAX_GLOBAL_DEPTH)
+        return false;
+
+    page_type* lower = pin(page);
+    if(!lower)
+        return false;
+    uint64_t high;
+    page_type* upper = static_cast<page_type*>(_pool.allocate(high));
+    if(!upper)
+    {
+        _pool.unpin(page, false);
+        return false;
+    }
+    upper->reset(depth + 1);
+    lower->rebuild(upper);
+    _pool.unpin(page, true);
+    _pool.unpin(high, true);
+
+    if(depth == _globalDepth)
+    {
+        //every entry becomes two adjacent entries, the new low bit does not matter yet.
+        vector<uint64_t> doubled(_directory.size() * 2);
+        for(size_t i = 0; i < _directory.size(); i++)
+            doubled[2 * i] = doubled[2 * i + 1] = _directory[i];
+        _directory.swap(doubled);
+        _globalDepth++;
+    }
+
+    size_t span = size_t(1) << (_globalDepth - depth);
+    size_t first = directory_index(h) & ~(span - 1);
+    for(size_t i = first + span / 2; i < first + span; i++)
+        _directory[i] = high;
+    _depths[page] = depth + 1;
+    _depths.push_back(depth + 1);
+    return true;
+}
+
+#endif // DISKHASH_H
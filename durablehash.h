@@ -0,0 +1,329 @@
+#ifndef DURABLEHASH_H
+#define DURABLEHASH_H
+
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <type_traits>
+#include <cerrno>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <record.h>
+#include "doublehash.h"
+#include "write_ahead_log.h"
+
+using namespace std;
+
+//A hash table that survives a crash. Every insert and remove that changes the table is appended
+// to a WriteAheadLog and returns once it is on disk, concurrent callers share each fsync through
+// group commit. A checkpoint saves every record to a snapshot file and truncates the log, it runs
+// whenever the log outgrows checkpointBytes. Opening the table loads the snapshot and replays the
+// log on top of it. A snapshot that cannot be saved leaves the log as it is, the log is only
+// truncated once the snapshot is synced, and a snapshot that cannot be read aborts the process
+// rather than start from a table that lost records. The table and the log are guarded by one mutex, so any number of threads may
+// share a DurableHash. The records are written byte for byte, so T must be trivially copyable.
+template <typename T, typename Table = DoubleHash<T> >
+class DurableHash
+{
+public:
+    //recovers path.snapshot and path.log, or starts empty if there are none.
+    DurableHash(const string& path, size_t capacity, uint64_t checkpointBytes = uint64_t(1) << 24);
+
+    //the table owns its files.
+    DurableHash(const DurableHash<T, Table>&) = delete;
+    DurableHash<T, Table>& operator=(const DurableHash<T, Table>&) = delete;
+
+    bool insert(const T& entry);                        //returns true once the inserted record is durable.
+    bool remove(int key);                               //returns true once the removal is durable.
+    bool is_present(int key) const;                     //returns true if the key exists, otherwise false.
+    void find(int key, bool& found, T& result) const;   //returns found = true, result = record with key if the key exists.
+    bool checkpoint();                                  //save a snapshot and truncate the log, false if it failed.
+
+    //preconditions: none
+    //postconditions: returns the current number of records.
+    inline size_t size() const
+    {
+        lock_guard<mutex> guard(_mutex);
+        return _table.size();
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of log frames replayed when the table was opened.
+    inline size_t recovered() const
+    {
+        return _recovered;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of checkpoints taken since the table was opened.
+    inline size_t checkpoints() const
+    {
+        lock_guard<mutex> guard(_mutex);
+        return _checkpoints;
+    }
+
+    //preconditions: none
+    //postconditions: returns the log, for its append and sync counters.
+    inline const WriteAheadLog& log() const
+    {
+        return _log;
+    }
+
+private:
+    static_assert(is_trivially_copyable<T>::value, "DurableHash logs records as raw bytes");
+    static const int INSERT = 1;
+    static const int REMOVE = 2;
+    static const uint64_t SNAPSHOT_MAGIC = 0x544F485350414E53ULL;   //"SNAPSHOT"
+
+    struct log_entry
+    {
+        int op;
+        T record;       //only the key is used by REMOVE.
+    };
+
+    Table _table;
+    mutable mutex _mutex;
+    WriteAheadLog _log;
+    string _snapshotPath;
+    uint64_t _checkpointBytes;
+    size_t _recovered;
+    size_t _checkpoints;
+
+    void apply(const log_entry& entry);         //redo one logged operation.
+    void load_snapshot();                       //insert the records of the snapshot file.
+    bool save_snapshot() const;                 //replace the snapshot file with the current records.
+    void checkpoint_if_due();                   //checkpoint if the log outgrew _checkpointBytes.
+
+    //preconditions: _mutex is held.
+    //postconditions: the operation is appended to the log, returns its sequence number. The
+    // fields are copied into a zeroed buffer, so the padding that is logged too is deterministic.
+    inline uint64_t log_operation(int op, const T& record)
+    {
+        log_entry entry;
+        char bytes[sizeof(log_entry)] = {};
+        size_t at = size_t(reinterpret_cast<const char*>(&entry.record) - reinterpret_cast<const char*>(&entry));
+        memcpy(bytes, &op, sizeof(op));
+        memcpy(bytes + at, &record, sizeof(T));
+        return _log.append(bytes, uint32_t(sizeof(bytes)));
+    }
+};
+
+//preconditions: the files can be created or opened.
+//postconditions: the table holds the records of the snapshot with every intact logged operation
+// redone on top of it. A torn frame at the end of the log is cut off.
+template <typename T, typename Table>
+DurableHash<T, Table>::DurableHash(const string& path, size_t capacity, uint64_t checkpointBytes)
+    : _table(capacity), _log(path + ".log")
+{
+    _snapshotPath = path + ".snapshot";
+    _checkpointBytes = checkpointBytes;
+    _checkpoints = 0;
+
+    load_snapshot();
+    _recovered = _log.replay([this](const char* bytes, uint32_t length)
+    {
+        log_entry entry;
+        if(length == sizeof(entry))
+        {
+            memcpy(&entry, bytes, sizeof(entry));
+            apply(entry);
+        }
+    });
+}
+
+//preconditions: none
+//postconditions: the entry is inserted as in the table, then logged. Returns true after the log
+// reaches the disk, false without logging if the table refused the entry. Other threads can
+// find the record while its commit is waiting for the disk.
+template <typename T, typename Table>
+bool DurableHash<T, Table>::insert(const T& entry)
+{
+    uint64_t lsn;
+    {
+        lock_guard<mutex> guard(_mutex);
+        if(!_table.insert(entry))
+            return false;
+        lsn = log_operation(INSERT, entry);
+    }
+
+    _log.commit(lsn);
+    checkpoint_if_due();
+    return true;
+}
+
+//preconditions: key must be a non-negative integer.
+//postconditions: the record is removed as in the table, then logged. Returns true after the log
+// reaches the disk, false without logging if the key was not there.
+template <typename T, typename Table>
+bool DurableHash<T, Table>::remove(int key)
+{
+    uint64_t lsn;
+    {
+        lock_guard<mutex> guard(_mutex);
+        if(!_table.remove(key))
+            return false;
+        T record;
+        record.key = key;
+        lsn = log_operation(REMOVE, record);
+    }
+
+    _log.commit(lsn);
+    checkpoint_if_due();
+    return true;
+}
+
+//preconditions: none
+//postconditions: if the record with the recieved key exists in the table,
+// returns true, otherwise returns false.
+template <typename T, typename Table>
+bool DurableHash<T, Table>::is_present(int key) const
+{
+    lock_guard<mutex> guard(_mutex);
+    return _table.is_present(key);
+}
+
+//preconditions: none
+//postconditions: if the record with the recieved key exists in the table,
+// found will be true and the record will be returned by ref.
+template <typename T, typename Table>
+void DurableHash<T, Table>::find(int key, bool& found, T& result) const
+{
+    lock_guard<mutex> guard(_mutex);
+    _table.find(key, found, result);
+}
+
+//preconditions: none
+//postconditions: every record is saved to the snapshot file, then the log is truncated and true
+// is returned. The operations still waiting for their commit are in the snapshot, so their
+// callers return. If the snapshot could not be saved and synced the log is kept whole and false
+// is returned, the records stay durable through the log.
+template <typename T, typename Table>
+bool DurableHash<T, Table>::checkpoint()
+{
+    lock_guard<mutex> guard(_mutex);
+    if(!save_snapshot())
+        return false;
+    _log.truncate();
+    _checkpoints++;
+    return true;
+}
+
+//preconditions: none
+//postconditions: takes a checkpoint if the log is larger than _checkpointBytes, once however
+// many callers find it so. If the snapshot fails the log keeps growing and the next call retries.
+template <typename T, typename Table>
+void DurableHash<T, Table>::checkpoint_if_due()
+{
+    if(_log.bytes() <= _checkpointBytes)
+        return;
+
+    lock_guard<mutex> guard(_mutex);
+    if(_log.bytes() <= _checkpointBytes)
+        return;
+    if(!save_snapshot())
+        return;
+    _log.truncate();
+    _checkpoints++;
+}
+
+//preconditions: none
+//postconditions: the logged operation is redone. A crash between saving a snapshot and truncating
+// the log replays operations the snapshot already holds: an insert of a present key fails, and
+// every later operation on the key is replayed too, so the key still ends as it was logged last.
+template <typename T, typename Table>
+void DurableHash<T, Table>::apply(const log_entry& entry)
+{
+    if(entry.op == INSERT)
+        _table.insert(entry.record);
+    else if(entry.op == REMOVE)
+        _table.remove(entry.record.key);
+}
+
+//preconditions: the table is empty.
+//postconditions: the records of the snapshot file are inserted, nothing happens if there is no
+// file. The file is written whole and renamed into place, so a partial one is never found: a
+// file that cannot be opened or read, has the wrong magic number or a size that does not match
+// its record count aborts the process.
+template <typename T, typename Table>
+void DurableHash<T, Table>::load_snapshot()
+{
+    int fd;
+    do
+        fd = ::open(_snapshotPath.c_str(), O_RDONLY);
+    while(fd < 0 && errno == EINTR);
+    if(fd < 0)
+    {
+        if(errno == ENOENT)
+            return;
+        io_failure("open", _snapshotPath);
+    }
+
+    struct stat status;
+    if(::fstat(fd, &status) != 0)
+        io_failure("fstat", _snapshotPath);
+    uint64_t header[2];     //the magic number and the record count.
+    if(!read_fully(fd, reinterpret_cast<char*>(header), sizeof(header), 0))
+        io_failure("read", _snapshotPath);
+    if(header[0] != SNAPSHOT_MAGIC || header[1] > uint64_t(status.st_size) / sizeof(T)
+       || uint64_t(status.st_size) != sizeof(header) + header[1] * sizeof(T))
+    {
+        cerr << "Error: " << _snapshotPath << " is not a valid snapshot." << endl;
+        abort();
+    }
+
+    vector<T> records(header[1]);
+    if(!read_fully(fd, reinterpret_cast<char*>(records.data()), records.size() * sizeof(T), off_t(sizeof(header))))
+        io_failure("read", _snapshotPath);
+    ::close(fd);
+
+    for(size_t i = 0; i < records.size(); i++)
+        _table.insert(records[i]);
+}
+
+//preconditions: _mutex is held.
+//postconditions: every record is written to a temporary file that is synced and then renamed
+// over the snapshot, and the directory is synced so the rename survives a crash. Returns true
+// once all of it succeeded. On a failure the temporary file is removed and false is returned,
+// the snapshot on disk is then the old one or the new one, both are safe to replay the log on.
+template <typename T, typename Table>
+bool DurableHash<T, Table>::save_snapshot() const
+{
+    vector<T> records(_table.size());
+    records.resize(_table.flatten(records.data()));
+    uint64_t header[2] = { SNAPSHOT_MAGIC, uint64_t(records.size()) };
+
+    string temporary = _snapshotPath + ".tmp";
+    int fd;
+    do
+        fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    while(fd < 0 && errno == EINTR);
+    if(fd < 0)
+        return false;
+    bool saved = write_fully(fd, reinterpret_cast<const char*>(header), sizeof(header))
+                 && write_fully(fd, reinterpret_cast<const char*>(records.data()), records.size() * sizeof(T))
+                 && sync_fully(fd, false);
+    if(::close(fd) != 0)
+        saved = false;
+    if(!saved || ::rename(temporary.c_str(), _snapshotPath.c_str()) != 0)
+    {
+        ::unlink(temporary.c_str());
+        return false;
+    }
+
+    size_t slash = _snapshotPath.find_last_of('/');
+    string directory = (slash == string::npos) ? "." : _snapshotPath.substr(0, slash + 1);
+    int dir = ::open(directory.c_str(), O_RDONLY);
+    if(dir < 0)
+        return false;
+    bool synced = sync_fully(dir, false);
+    ::close(dir);
+    return synced;
+}
+
+#endif // DURABLEHASH_H
@@ -0,0 +1,254 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <cstdlib>
+#include <cstdint>
+#include <cassert>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+static const size_t EPOCH_MAX_THREADS = 256;    //threads that may use epochs at the same time.
+
+//preconditions: fewer than EPOCH_MAX_THREADS threads are using epochs.
+//postconditions: returns the participant number of the calling thread, claimed on its first call
+// and handed back when the thread exits, so it can be reused by a later thread.
+inline size_t epoch_thread_id()
+{
+    static atomic<bool> claimed[EPOCH_MAX_THREADS];
+
+    //claims a number on construction, releases it when the thread exits.
+    struct participant
+    {
+        size_t _id;
+
+        participant()
+        {
+            for(_id = 0; _id < EPOCH_MAX_THREADS; _id++)
+            {
+                bool expected = false;
+                if(!claimed[_id].load(memory_order_relaxed)
+                   && claimed[_id].compare_exchange_strong(expected, true, memory_order_acquire))
+                    return;
+            }
+            assert(false && "too many threads use epochs");
+        }
+
+        ~participant()
+        {
+            claimed[_id].store(false, memory_order_release);
+        }
+    };
+
+    thread_local participant self;
+    return self._id;
+}
+
+//Epoch-based reclamation. A reader announces the global epoch in its own slot before it reads
+// shared pointers and clears the slot when it is done, through a guard. A writer that unlinks an
+// object retires it with the epoch of the moment, and the object is only freed two epochs later:
+// the global epoch advances one step at a time, and only once every reader that is inside a guard
+// has announced the current epoch, so by then no reader can still hold a pointer it found before
+// the object was unlinked. Readers never wait, a reader that stays inside a guard only delays the
+// freeing.
+class EpochManager
+{
+public:
+    //Keeps the calling thread inside an epoch while it lives, guards may nest.
+    class guard
+    {
+    public:
+        guard(const EpochManager& manager);
+        ~guard();
+
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+
+    private:
+        const EpochManager& _manager;
+        size_t _id;
+    };
+
+    EpochManager();
+    ~EpochManager();                                    //free every object still retired.
+
+    //the retired objects belong to the manager.
+    EpochManager(const EpochManager&) = delete;
+    EpochManager& operator=(const EpochManager&) = delete;
+
+    template <typename U>
+    void retire(U* object);                             //delete object once no reader can reach it.
+    template <typename U>
+    void retire_array(U* objects);                      //delete[] objects once no reader can reach them.
+    size_t reclaim();                                   //try to advance the epoch, free what is safe to.
+
+    //preconditions: none
+    //postconditions: returns the number of objects retired and not freed yet.
+    inline size_t pending() const
+    {
+        lock_guard<mutex> lock(_retiredLock);
+        return _retired.size();
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of objects freed so far.
+    inline size_t freed() const
+    {
+        lock_guard<mutex> lock(_retiredLock);
+        return _freed;
+    }
+
+private:
+    static const uint64_t QUIESCENT = ~uint64_t(0);    //announced by a thread outside every guard.
+    static const size_t RECLAIM_EVERY = 64;             //retirements between attempts to reclaim.
+
+    //the announced epoch of one thread, on a cache line of its own.
+    struct alignas(64) announcement
+    {
+        atomic<uint64_t> _epoch;
+        size_t _depth;          //nested guards, only touched by the owning thread.
+    };
+
+    struct retired
+    {
+        void* _object;
+        void (*_free)(void*);
+        uint64_t _epoch;
+    };
+
+    mutable announcement _announced[EPOCH_MAX_THREADS];
+    atomic<uint64_t> _epoch;
+    mutable mutex _retiredLock;     //guards the list, retire is never on a reader's path.
+    vector<retired> _retired;
+    size_t _sinceReclaim;
+    size_t _freed;
+
+    void add(void* object, void (*free)(void*));        //put an object on the list.
+
+    template <typename U>
+    static void free_object(void* object)
+    {
+        delete static_cast<U*>(object);
+    }
+
+    template <typename U>
+    static void free_array(void* objects)
+    {
+        delete [] static_cast<U*>(objects);
+    }
+};
+
+//preconditions: none
+//postconditions: the thread announces the current epoch, unless an outer guard already did.
+inline EpochManager::guard::guard(const EpochManager& manager): _manager(manager), _id(epoch_thread_id())
+{
+    announcement& own = _manager._announced[_id];
+    if(own._depth++ == 0)
+    {
+        own._epoch.store(_manager._epoch.load(memory_order_seq_cst), memory_order_seq_cst);
+        atomic_thread_fence(memory_order_seq_cst);  //the announcement is visible before any pointer is read.
+    }
+}
+
+//preconditions: none
+//postconditions: the outermost guard marks the thread quiescent.
+inline EpochManager::guard::~guard()
+{
+    announcement& own = _manager._announced[_id];
+    if(--own._depth == 0)
+        own._epoch.store(QUIESCENT, memory_order_release);
+}
+
+//preconditions: none
+//postconditions: epoch 0, no thread is inside a guard and nothing is retired.
+inline EpochManager::EpochManager(): _epoch(0)
+{
+    for(size_t i = 0; i < EPOCH_MAX_THREADS; i++)
+    {
+        _announced[i]._epoch.store(QUIESCENT, memory_order_relaxed);
+        _announced[i]._depth = 0;
+    }
+    _sinceReclaim = 0;
+    _freed = 0;
+}
+
+//preconditions: no thread is inside a guard of the manager.
+//postconditions: every retired object is freed.
+inline EpochManager::~EpochManager()
+{
+    for(size_t i = 0; i < _retired.size(); i++)
+        _retired[i]._free(_retired[i]._object);
+}
+
+//preconditions: object is unlinked, no reader that enters a guard from now on can reach it.
+//postconditions: the object is deleted once every reader that could still hold it has left its guard.
+template <typename U>
+void EpochManager::retire(U* object)
+{
+    add(object, &free_object<U>);
+}
+
+//preconditions: objects is unlinked, no reader that enters a guard from now on can reach it.
+//postconditions: the array is deleted once every reader that could still hold it has left its guard.
+template <typename U>
+void EpochManager::retire_array(U* objects)
+{
+    add(objects, &free_array<U>);
+}
+
+//preconditions: none
+//postconditions: the epoch advances if every thread inside a guard announced the current one, then
+// every object retired at least two epochs ago is freed. Returns the number freed.
+inline size_t EpochManager::reclaim()
+{
+    lock_guard<mutex> lock(_retiredLock);
+    _sinceReclaim = 0;
+
+    uint64_t current = _epoch.load(memory_order_seq_cst);
+    bool advance = true;
+    for(size_t i = 0; i < EPOCH_MAX_THREADS && advance; i++)
+    {
+        uint64_t announced = _announced[i]._epoch.load(memory_order_seq_cst);
+        advance = (announced == QUIESCENT || announced == current);
+    }
+    if(advance)
+        _epoch.compare_exchange_strong(current, current + 1, memory_order_seq_cst);
+    current = _epoch.load(memory_order_seq_cst);
+
+    size_t kept = 0;
+    size_t freed = 0;
+    for(size_t i = 0; i < _retired.size(); i++)
+        if(_retired[i]._epoch + 2 <= current)
+        {
+            _retired[i]._free(_retired[i]._object);
+            freed++;
+        }
+        else
+            _retired[kept++] = _retired[i];
+    _retired.resize(kept);
+    _freed += freed;
+    return freed;
+}
+
+//preconditions: none
+//postconditions: the object is on the list with the current epoch, every RECLAIM_EVERY
+// retirements an attempt is made to reclaim.
+inline void EpochManager::add(void* object, void (*free)(void*))
+{
+    bool due;
+    {
+        lock_guard<mutex> lock(_retiredLock);
+        retired r;
+        r._object = object;
+        r._free = free;
+        r._epoch = _epoch.load(memory_order_seq_cst);
+        _retired.push_back(r);
+        due = (++_sinceReclaim >= RECLAIM_EVERY);
+    }
+    if(due)
+        reclaim();
+}
+
+#endif // EPOCH_H
@@ -0,0 +1,420 @@
+#ifndef EXTENDIBLEHASH_H
+#define EXTENDIBLEHASH_H
+
+#include <cstdlib>
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <cassert>
+#include <vector>
+#include <record.h>
+#include "hash_functions.h"
+
+using namespace std;
+
+//One fixed size page of an extendible hash table: an OpenHash style array of records probed
+// linearly, whose keys are NEVER_USED or PREVIOUSLY_USED when the slot holds no record. Every
+// directory entry whose top _depth hash bits match the page's prefix points to it. The page is
+// one flat block without pointers, so it is also the unit DiskHash reads and writes.
+template <typename T, size_t PAGE_SLOTS>
+struct extendible_page
+{
+    static_assert((PAGE_SLOTS & (PAGE_SLOTS - 1)) == 0, "PAGE_SLOTS must be a power of two");
+    static const int NEVER_USED = -1;
+    static const int PREVIOUSLY_USED = -2;
+    static const size_t MAX_FILL = PAGE_SLOTS - PAGE_SLOTS / 4;    //a page splits before its probes get long.
+
+    T _items[PAGE_SLOTS];
+    size_t _size;       //records in the page.
+    size_t _used;       //records and PREVIOUSLY_USED slots, the slots a probe may step over.
+    size_t _depth;      //the number of hash bits shared by every key of the page.
+
+    extendible_page(size_t depth);
+    void reset(size_t depth);                               //every slot becomes NEVER_USED.
+    bool find(int key, uint64_t h, size_t& index) const;    //the slot of the key, false if it is not there.
+    void place(const T& entry);                             //store a record that is not in the page.
+    void erase(size_t index);                               //flag the slot PREVIOUSLY_USED.
+    void rebuild(extendible_page<T, PAGE_SLOTS>* high);     //drop the PREVIOUSLY_USED slots, or split into high.
+
+    //preconditions: none
+    //postconditions: returns true if the page must be rebuilt or split before the next insert.
+    inline bool full() const
+    {
+        return _used >= MAX_FILL;
+    }
+
+    //preconditions: full()
+    //postconditions: returns true if dropping the PREVIOUSLY_USED slots frees enough room.
+    inline bool sparse() const
+    {
+        return _size < MAX_FILL / 2;
+    }
+
+    //preconditions: none
+    //postconditions: returns the first slot probed for the hash, from its low bits.
+    static inline size_t slot_of(uint64_t h)
+    {
+        return size_t(h) & (PAGE_SLOTS - 1);
+    }
+
+    //preconditions: none
+    //postconditions: returns true if the slot holds a record.
+    static inline bool occupied(const T& slot)
+    {
+        return slot.key != NEVER_USED && slot.key != PREVIOUSLY_USED;
+    }
+};
+
+//An extendible hash table: a directory indexed by the top _globalDepth bits of the hash points
+// to fixed size open addressing pages. A full page splits on its own, into two pages told apart by
+// one more hash bit, and only the directory entries of that page change (the directory doubles
+// when the page already uses every bit of it). An insert never rehashes more than one page,
+// memory grows a page at a time, and a page is the unit to persist or evict.
+template <typename T, size_t PAGE_SLOTS = 256>
+class ExtendibleHash
+{
+    //note: this typename is different so that the definition and implementation can be seperated.
+    template <typename TT, size_t SS>
+    friend ostream& operator<<(ostream& outs, const ExtendibleHash<TT, SS>& table);
+
+public:
+    ExtendibleHash();                                   //one empty page.
+
+    //big 3
+    ~ExtendibleHash();
+    ExtendibleHash<T, PAGE_SLOTS>& operator=(const ExtendibleHash<T, PAGE_SLOTS>& other);
+    ExtendibleHash(const ExtendibleHash<T, PAGE_SLOTS>& other);
+
+    bool insert(const T& entry);                        //returns true if the record inserted, otherwise false.
+    bool remove(int key);                               //returns true if the record with the key was removed, otherwise false.
+    bool is_present(int key) const;                     //returns true if the key exists, otherwise false.
+    void find(int key, bool& found, T& result) const;   //returns found = true, result = record with key if the key exists.
+
+    //preconditions: none
+    //postconditions: returns the current _size.
+    inline size_t size() const
+    {
+        return _size;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of slots of every page.
+    inline size_t capacity() const
+    {
+        return _pages * PAGE_SLOTS;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of pages.
+    inline size_t pages() const
+    {
+        return _pages;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of hash bits that index the directory.
+    inline size_t global_depth() const
+    {
+        return _globalDepth;
+    }
+
+private:
+    typedef extendible_page<T, PAGE_SLOTS> page_type;
+
+    static const size_t MAX_GLOBAL_DEPTH = 24;                      //the directory never exceeds 2^24 entries.
+
+    vector<page_type*> _directory;  //2^_globalDepth entries, a page of depth d fills 2^(_globalDepth - d) of them.
+    size_t _globalDepth;
+    size_t _size;
+    size_t _pages;
+
+    void clearPages();
+    void copyPages(const ExtendibleHash<T, PAGE_SLOTS>& other);
+
+    bool split(page_type* page, uint64_t h);        //split the page holding h, false at MAX_GLOBAL_DEPTH.
+
+    //preconditions: none
+    //postconditions: returns the directory entry of the hash, its top _globalDepth bits.
+    inline size_t directory_index(uint64_t h) const
+    {
+        return (_globalDepth) ? size_t(h >> (64 - _globalDepth)) : 0;
+    }
+};
+
+//preconditions: none
+//postconditions: constructs an empty page of the recieved depth.
+template <typename T, size_t PAGE_SLOTS>
+extendible_page<T, PAGE_SLOTS>::extendible_page(size_t depth)
+{
+    reset(depth);
+}
+
+//preconditions: none
+//postconditions: the page is empty with the recieved depth, every slot is NEVER_USED.
+template <typename T, size_t PAGE_SLOTS>
+void extendible_page<T, PAGE_SLOTS>::reset(size_t depth)
+{
+    _size = 0;
+    _used = 0;
+    _depth = depth;
+    for(size_t i = 0; i < PAGE_SLOTS; i++)
+        _items[i].key = NEVER_USED;
+}
+
+//preconditions: h is the hash of key.
+//postconditions: the page is probed linearly from slot_of(h) until the key or a NEVER_USED slot,
+// returns true and the slot of the key if it was found. A page is never full, so a probe ends.
+template <typename T, size_t PAGE_SLOTS>
+bool extendible_page<T, PAGE_SLOTS>::find(int key, uint64_t h, size_t& index) const
+{
+    index = slot_of(h);
+    while(_items[index].key != NEVER_USED)
+    {
+        if(_items[index].key == key)
+            return true;
+        index = (index + 1) & (PAGE_SLOTS - 1);
+    }
+    return false;
+}
+
+//preconditions: the key of entry is not in the page, !full().
+//postconditions: the entry is stored in the first vacant slot of its probe sequence.
+template <typename T, size_t PAGE_SLOTS>
+void extendible_page<T, PAGE_SLOTS>::place(const T& entry)
+{
+    size_t index = slot_of(hash_mix(entry.key));
+    while(occupied(_items[index]))
+        index = (index + 1) & (PAGE_SLOTS - 1);
+
+    if(_items[index].key == NEVER_USED)
+        _used++;
+    _items[index] = entry;
+    _size++;
+}
+
+//preconditions: index holds a record.
+//postconditions: the record is flagged PREVIOUSLY_USED, the probes of the records behind it still pass.
+template <typename T, size_t PAGE_SLOTS>
+void extendible_page<T, PAGE_SLOTS>::erase(size_t index)
+{
+    assert(occupied(_items[index]));
+    _items[index].key = PREVIOUSLY_USED;
+    _size--;
+}
+
+//preconditions: high is null, or an empty page one bit deeper than this page.
+//postconditions: the records of the page are placed again into the cleared page, without its
+// PREVIOUSLY_USED slots. With high, _depth is incremented and the records whose next
+// hash bit is 1 go to high instead.
+template <typename T, size_t PAGE_SLOTS>
+void extendible_page<T, PAGE_SLOTS>::rebuild(extendible_page<T, PAGE_SLOTS>* high)
+{
+    vector<T> records;
+    records.reserve(_size);
+    for(size_t i = 0; i < PAGE_SLOTS; i++)
+        if(occupied(_items[i]))
+            records.push_back(_items[i]);
+
+    size_t depth = _depth;
+    reset((high) ? depth + 1 : depth);
+
+    for(size_t i = 0; i < records.size(); i++)
+    {
+        bool upper = high && ((hash_mix(records[i].key) >> (63 - depth)) & 1);
+        (upper ? high : this)->place(records[i]);
+    }
+}
+
+//preconditions: none
+//postconditions: every page is printed once with its depth and records.
+template <typename TT, size_t SS>
+ostream& operator<<(ostream& outs, const ExtendibleHash<TT, SS>& table)
+{
+    for(size_t i = 0; i < table._directory.size(); )
+    {
+        const extendible_page<TT, SS>* page = table._directory[i];
+        outs << "[" << setfill('0') << setw(3) << i << "] depth " << page->_depth
+             << " : " << page->_size << " records" << setfill(' ') << endl;
+        for(size_t slot = 0; slot < SS; slot++)
+            if(page->occupied(page->_items[slot]))
+                outs << "    " << page->_items[slot].key << ":" << page->_items[slot].data << endl;
+        i += size_t(1) << (table._globalDepth - page->_depth);
+    }
+    return outs;
+}
+
+//preconditions: none
+//postconditions: constructs a table of one empty page, global depth 0.
+template <typename T, size_t PAGE_SLOTS>
+ExtendibleHash<T, PAGE_SLOTS>::ExtendibleHash()
+{
+    _globalDepth = 0;
+    _size = 0;
+    _pages = 1;
+    _directory.push_back(new page_type(0));
+}
+
+//preconditions: none
+//postconditions: deallocate every page.
+template <typename T, size_t PAGE_SLOTS>
+ExtendibleHash<T, PAGE_SLOTS>::~ExtendibleHash()
+{
+    clearPages();
+}
+
+//preconditions: none
+//postconditions: deallocate this table and reassign it the contents of other.
+template <typename T, size_t PAGE_SLOTS>
+ExtendibleHash<T, PAGE_SLOTS>& ExtendibleHash<T, PAGE_SLOTS>::operator=(const ExtendibleHash<T, PAGE_SLOTS>& other)
+{
+    if(&other == this)
+        return *this;
+
+    clearPages();
+    copyPages(other);
+    return *this;
+}
+
+//preconditions: none
+//postconditions: construct this table with the contents of other.
+template <typename T, size_t PAGE_SLOTS>
+ExtendibleHash<T, PAGE_SLOTS>::ExtendibleHash(const ExtendibleHash<T, PAGE_SLOTS>& other)
+{
+    copyPages(other);
+}
+
+//preconditions: none
+//postconditions: every page is deallocated once, the directory is empty.
+template <typename T, size_t PAGE_SLOTS>
+void ExtendibleHash<T, PAGE_SLOTS>::clearPages()
+{
+    for(size_t i = 0; i < _directory.size(); )
+    {
+        page_type* page = _directory[i];
+        i += size_t(1) << (_globalDepth - page->_depth);
+        delete page;
+    }
+    _directory.clear();
+}
+
+//preconditions: the directory is empty.
+//postconditions: every page of other is copied once, and every directory entry points to the
+// copy of the page it pointed to in other.
+template <typename T, size_t PAGE_SLOTS>
+void ExtendibleHash<T, PAGE_SLOTS>::copyPages(const ExtendibleHash<T, PAGE_SLOTS>& other)
+{
+    _globalDepth = other._globalDepth;
+    _size = other._size;
+    _pages = other._pages;
+    _directory.resize(other._directory.size());
+    for(size_t i = 0; i < _directory.size(); )
+    {
+        size_t span = size_t(1) << (_globalDepth - other._directory[i]->_depth);
+        page_type* page = new page_type(*other._directory[i]);
+        for(size_t j = 0; j < span; j++)
+            _directory[i + j] = page;
+        i += span;
+    }
+}
+
+//preconditions: none
+//postconditions: the entry is placed in the page of its hash. A page that is full splits first
+// (or only drops its PREVIOUSLY_USED slots if they are what fills it), so an insert rewrites at
+// most one page and, when the page used every directory bit, doubles the directory of pointers.
+// Returns false if the key is already present, or if the page cannot split below MAX_GLOBAL_DEPTH.
+template <typename T, size_t PAGE_SLOTS>
+bool ExtendibleHash<T, PAGE_SLOTS>::insert(const T& entry)
+{
+    uint64_t h = hash_mix(entry.key);
+    page_type* page = _directory[directory_index(h)];
+    size_t index;
+    if(page->find(entry.key, h, index))
+        return false;
+
+    while(page->full())
+    {
+        if(page->sparse())
+            page->rebuild(nullptr);
+        else if(!split(page, h))
+            return false;
+        page = _directory[directory_index(h)];
+    }
+
+    page->place(entry);
+    _size++;
+    return true;
+}
+
+//preconditions: key must be a non-negative integer.
+//postconditions: the record is flagged PREVIOUSLY_USED in its page, returns false if it is not there.
+template <typename T, size_t PAGE_SLOTS>
+bool ExtendibleHash<T, PAGE_SLOTS>::remove(int key)
+{
+    assert(key >= 0);
+    uint64_t h = hash_mix(key);
+    page_type* page = _directory[directory_index(h)];
+    size_t index;
+    if(!page->find(key, h, index))
+        return false;
+
+    page->erase(index);
+    _size--;
+    return true;
+}
+
+//preconditions: none
+//postconditions: if the record with the recieved key exists in the table,
+// returns true, otherwise returns false.
+template <typename T, size_t PAGE_SLOTS>
+bool ExtendibleHash<T, PAGE_SLOTS>::is_present(int key) const
+{
+    uint64_t h = hash_mix(key);
+    size_t index;
+    return _directory[directory_index(h)]->find(key, h, index);
+}
+
+//preconditions: none
+//postconditions: if the record with the recieved key exists in the table,
+// found will be true and the record will be returned by ref.
+template <typename T, size_t PAGE_SLOTS>
+void ExtendibleHash<T, PAGE_SLOTS>::find(int key, bool& found, T& result) const
+{
+    uint64_t h = hash_mix(key);
+    const page_type* page = _directory[directory_index(h)];
+    size_t index;
+    found = page->find(key, h, index);
+    if(found)
+        result = page->_items[index];
+}
+
+//preconditions: page holds the hash h.
+//postconditions: the page is split by its next hash bit into itself and a new page, the directory
+// entries of the upper half of its range point to the new page. The directory doubles first if the
+// page already used every directory bit. Returns false (and changes nothing) at MAX_GLOBAL_DEPTH.
+template <typename T, size_t PAGE_SLOTS>
+bool ExtendibleHash<T, PAGE_SLOTS>::split(page_type* page, uint64_t h)
+{
+    if(page->_depth == _globalDepth)
+    {
+        if(_globalDepth == MAX_GLOBAL_DEPTH)
+            return false;
+
+        //every entry becomes two adjacent entries, the new low bit does not matter yet.
+        vector<page_type*> doubled(_directory.size() * 2);
+        for(size_t i = 0; i < _directory.size(); i++)
+            doubled[2 * i] = doubled[2 * i + 1] = _directory[i];
+        _directory.swap(doubled);
+        _globalDepth++;
+    }
+
+    page_type* high = new page_type(page->_depth + 1);
+    size_t span = size_t(1) << (_globalDepth - page->_depth);
+    size_t first = directory_index(h) & ~(span - 1);
+    page->rebuild(high);
+    for(size_t i = first + span / 2; i < first + span; i++)
+        _directory[i] = high;
+    _pages++;
+    return true;
+}
+
+#endif // EXTENDIBLEHASH_H
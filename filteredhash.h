@@ -0,0 +1,134 @@
+#ifndef FILTEREDHASH_H
+#define FILTEREDHASH_H
+
+#include <cstdlib>
+#include <iostream>
+#include "bloom_filter.h"
+
+using namespace std;
+
+//Any of the hash tables (ChainedHash, OpenHash, DoubleHash) with a BlockedBloomFilter kept
+// alongside it. A lookup of a key that is not in the table is usually rejected by the filter
+// with one cache access instead of walking a bucket or a whole probe sequence.
+template <typename Table>
+class FilteredHash
+{
+    //preconditions: none
+    //postconditions: the table is printed to the recieved output stream.
+    friend ostream& operator<<(ostream& outs, const FilteredHash<Table>& table)
+    {
+        return outs << table._table;
+    }
+
+public:
+    FilteredHash();                             //a default table, the filter is sized for its capacity.
+    FilteredHash(size_t maxCapacity);           //the table and filter are sized for maxCapacity records.
+
+    template <typename T>
+    bool insert(const T& entry);                //returns true if the record inserted, otherwise false.
+    bool remove(int key);                       //returns true if the record with the key was removed, otherwise false.
+    bool is_present(int key);                   //returns true if the key exists, otherwise false.
+    template <typename T>
+    void find(int key, bool& found, T& result); //returns found = true, result = record with key if the key exists.
+
+    //preconditions: none
+    //postconditions: returns the current size of the table.
+    inline size_t size() const
+    {
+        return _table.size();
+    }
+
+    //preconditions: none
+    //postconditions: returns the capacity of the table.
+    inline size_t capacity() const
+    {
+        return _table.capacity();
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of lookups the filter rejected without a table access.
+    inline size_t filtered() const
+    {
+        return _filtered;
+    }
+
+private:
+    Table _table;
+    BlockedBloomFilter _filter;     //counts every key in _table.
+    size_t _filtered;
+};
+
+//preconditions: none
+//postconditions: constructs a default table and a filter sized for its capacity.
+template <typename Table>
+FilteredHash<Table>::FilteredHash(): _filter(_table.capacity()), _filtered(0)
+{
+}
+
+//preconditions: none
+//postconditions: constructs a table with the recieved capacity and a filter sized for it.
+template <typename Table>
+FilteredHash<Table>::FilteredHash(size_t maxCapacity): _table(maxCapacity), _filter(maxCapacity), _filtered(0)
+{
+}
+
+//preconditions: none
+//postconditions: the entry is inserted into the table, and counted by the filter if it inserted.
+template <typename Table>
+template <typename T>
+bool FilteredHash<Table>::insert(const T& entry)
+{
+    if(!_table.insert(entry))
+        return false;
+    _filter.insert(entry.key);
+    return true;
+}
+
+//preconditions: none
+//postconditions: the table is only searched if the filter may contain the key,
+// the key is uncounted if it was removed.
+template <typename Table>
+bool FilteredHash<Table>::remove(int key)
+{
+    if(!_filter.may_contain(key))
+    {
+        _filtered++;
+        return false;
+    }
+
+    if(!_table.remove(key))
+        return false;
+    _filter.remove(key);
+    return true;
+}
+
+//preconditions: none
+//postconditions: returns false without touching the table if the filter rejects the key.
+template <typename Table>
+bool FilteredHash<Table>::is_present(int key)
+{
+    if(!_filter.may_contain(key))
+    {
+        _filtered++;
+        return false;
+    }
+    return _table.is_present(key);
+}
+
+//preconditions: none
+//postconditions: found is false without touching the table if the filter rejects the key,
+// otherwise the table is searched.
+template <typename Table>
+template <typename T>
+void FilteredHash<Table>::find(int key, bool& found, T& result)
+{
+    if(!_filter.may_contain(key))
+    {
+        _filtered++;
+        found = false;
+        return;
+    }
+    _table.find(key, found, result);
+}
+
+#endif // FILTEREDHASH_H
@@ -0,0 +1,240 @@
+#ifndef FROZEN_BUCKET_H
+#define FROZEN_BUCKET_H
+
+#include <cstdlib>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include "bst_functions.h"
+#include "frozen_tree.h"
+
+using namespace std;
+
+//One contiguous arena for the records of every frozen bucket of a table. Each bucket owns
+// a run of [offset, offset + count), the keys are kept in their own array so a lookup
+// descends through ints only and reads a single record at the end.
+template <typename T>
+class frozen_pool
+{
+public:
+    frozen_pool(uint32_t initialCapacity = 64);
+    ~frozen_pool();
+
+    uint32_t allocate(uint32_t count);  //returns the offset of a run of count unused slots.
+    void reserve(uint32_t capacity);    //grow the arena to hold at least capacity records.
+
+    //preconditions: offset was returned by allocate().
+    //postconditions: returns the keys of the run starting at offset.
+    inline int* keys(uint32_t offset) const
+    {
+        return _keys + offset;
+    }
+
+    //preconditions: offset was returned by allocate().
+    //postconditions: returns the records of the run starting at offset.
+    inline T* items(uint32_t offset) const
+    {
+        return _items + offset;
+    }
+
+private:
+    int* _keys;
+    T* _items;
+    uint32_t _used;
+    uint32_t _capacity;
+
+    //not copyable, buckets refer to their runs by offset.
+    frozen_pool(const frozen_pool<T>& other);
+    frozen_pool<T>& operator=(const frozen_pool<T>& other);
+};
+
+//preconditions: none
+//postconditions: constructs an empty arena with room for initialCapacity records.
+template <typename T>
+frozen_pool<T>::frozen_pool(uint32_t initialCapacity)
+{
+    _capacity = (initialCapacity) ? initialCapacity : 1;
+    _used = 0;
+    _keys = new int[_capacity];
+    _items = new T[_capacity];
+}
+
+//preconditions: none
+//postconditions: deallocate the arena.
+template <typename T>
+frozen_pool<T>::~frozen_pool()
+{
+    delete [] _keys;
+    delete [] _items;
+}
+
+//preconditions: none
+//postconditions: the arena holds at least capacity slots, the used slots are moved over.
+template <typename T>
+void frozen_pool<T>::reserve(uint32_t capacity)
+{
+    if(capacity <= _capacity)
+        return;
+
+    int* keys = new int[capacity];
+    T* items = new T[capacity];
+    for(uint32_t i = 0; i < _used; i++)
+    {
+        keys[i] = _keys[i];
+        items[i] = _items[i];
+    }
+    delete [] _keys;
+    delete [] _items;
+    _keys = keys;
+    _items = items;
+    _capacity = capacity;
+}
+
+//preconditions: none
+//postconditions: returns the offset of count unused slots, the arena doubles when full.
+template <typename T>
+uint32_t frozen_pool<T>::allocate(uint32_t count)
+{
+    if(_used + count > _capacity)
+        reserve((_used + count > _capacity * 2) ? _used + count : _capacity * 2);
+
+    uint32_t offset = _used;
+    _used += count;
+    return offset;
+}
+
+//A read-only hash table bucket: the records of the bucket in Eytzinger order inside the
+// table's frozen_pool, searched with eytzinger_lower_bound on the key array. A bucket is
+// built once by ChainedHash::freeze(), insert and erase always fail.
+template <typename T>
+class FrozenBucket
+{
+public:
+    typedef frozen_pool<T> pool_type;
+
+    //every record lives in the pool, so the table may release the pool in bulk.
+    static const bool BULK_RELEASE = true;
+
+    FrozenBucket(): _offset(0), _count(0) {}
+
+    void build(const T* sorted, uint32_t count, pool_type& pool); //this bucket must be empty.
+
+    //preconditions: none
+    //postconditions: the bucket is read-only, returns false.
+    bool insert(const T&, pool_type&)
+    {
+        return false;
+    }
+
+    //preconditions: none
+    //postconditions: the bucket is read-only, returns false.
+    bool erase(int, pool_type&)
+    {
+        return false;
+    }
+
+    T* search(int key, pool_type& pool);    //returns the record with the key, or null.
+    void copy(const FrozenBucket<T>& from, const pool_type& fromPool, pool_type& pool); //this bucket must be empty.
+    size_t flatten(T* out, const pool_type& pool) const; //copy the records to out in key order, returns the count.
+    void print(ostream& outs, const pool_type& pool) const; //print the records in key order.
+
+    //preconditions: none
+    //postconditions: the bucket forgets its run, the run is reclaimed when the pool is destroyed.
+    void clear(pool_type&)
+    {
+        _count = 0;
+    }
+
+    //preconditions: none
+    //postconditions: returns true if the bucket holds no record.
+    inline bool empty() const
+    {
+        return _count == 0;
+    }
+
+    //preconditions: none
+    //postconditions: returns null, the records are not in a tree_node tree, so a batched lookup
+    // searches the bucket whole.
+    inline tree_node<T>* tree() const
+    {
+        return nullptr;
+    }
+
+private:
+    uint32_t _offset;   //the first slot of this bucket in the pool.
+    uint32_t _count;
+};
+
+//preconditions: this bucket is empty, sorted holds count records in key order.
+//postconditions: the records are laid out in Eytzinger order in a new run of the pool.
+template <typename T>
+void FrozenBucket<T>::build(const T* sorted, uint32_t count, pool_type& pool)
+{
+    assert(_count == 0);
+    _count = count;
+    if(_count == 0)
+        return;
+
+    _offset = pool.allocate(_count);
+    T* items = pool.items(_offset);
+    int* keys = pool.keys(_offset);
+    size_t next = 0;
+    eytzinger_fill(sorted, items, _count, next);
+    for(uint32_t i = 0; i < _count; i++)
+        keys[i] = items[i].key;
+}
+
+//preconditions: none
+//postconditions: returns a pointer to the record with the key, or null if it is not in the bucket.
+template <typename T>
+T* FrozenBucket<T>::search(int key, pool_type& pool)
+{
+    if(_count == 0)
+        return nullptr;
+
+    int* keys = pool.keys(_offset);
+    size_t i = eytzinger_lower_bound(keys, _count, key);
+    return (i < _count && keys[i] == key) ? pool.items(_offset) + i : nullptr;
+}
+
+//preconditions: this bucket is empty.
+//postconditions: this bucket holds a copy of from in a new run of pool.
+template <typename T>
+void FrozenBucket<T>::copy(const FrozenBucket<T>& from, const pool_type& fromPool, pool_type& pool)
+{
+    assert(_count == 0);
+    _count = from._count;
+    if(_count == 0)
+        return;
+
+    _offset = pool.allocate(_count);
+    for(uint32_t i = 0; i < _count; i++)
+    {
+        pool.keys(_offset)[i] = fromPool.keys(from._offset)[i];
+        pool.items(_offset)[i] = fromPool.items(from._offset)[i];
+    }
+}
+
+//preconditions: out has room for every record of the bucket.
+//postconditions: the records are copied to out in key order, the count is returned.
+template <typename T>
+size_t FrozenBucket<T>::flatten(T* out, const pool_type& pool) const
+{
+    if(_count == 0)
+        return 0;
+    return eytzinger_flatten(pool.items(_offset), _count, out);
+}
+
+//preconditions: none
+//postconditions: every record is printed on its own line in key order.
+template <typename T>
+void FrozenBucket<T>::print(ostream& outs, const pool_type& pool) const
+{
+    T* sorted = new T[_count];
+    flatten(sorted, pool);
+    for(uint32_t i = 0; i < _count; i++)
+        outs << "|" << sorted[i] << "|" << endl;
+    delete [] sorted;
+}
+
+#endif // FROZEN_BUCKET_H
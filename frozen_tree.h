@@ -0,0 +1,177 @@
+#ifndef FROZEN_TREE_H
+#define FROZEN_TREE_H
+
+#include <cstdlib>
+#include <cassert>
+#include <iostream>
+#include "prefetch.h"
+
+using namespace std;
+
+//preconditions: sorted holds n items in ascending order, out has room for n items.
+//postconditions: out holds the items in Eytzinger (breadth first) order: the children of
+// out[i] are out[2i+1] and out[2i+2]. The implicit tree is filled by an in order walk.
+template <typename T>
+void eytzinger_fill(const T* sorted, T* out, size_t n, size_t& next, size_t k = 1)
+{
+    if(k <= n)
+    {
+        eytzinger_fill(sorted, out, n, next, 2 * k);
+        out[k - 1] = sorted[next++];
+        eytzinger_fill(sorted, out, n, next, 2 * k + 1);
+    }
+}
+
+//preconditions: a holds n items in Eytzinger order.
+//postconditions: returns the position of the smallest item that is not less than target,
+// or n if every item is less than target. The descent has no data dependent branch, and
+// the node four levels below is prefetched so the next cache lines are already loading.
+template <typename T, typename K>
+size_t eytzinger_lower_bound(const T* a, size_t n, const K& target)
+{
+    size_t k = 1;
+    while(k <= n)
+    {
+        if(16 * k <= n)
+            PREFETCH(a + 16 * k - 1);
+        k = 2 * k + (a[k - 1] < target);
+    }
+
+    //every right turn appended a 1, drop them and the last left turn to reach the answer.
+    while(k & 1)
+        k >>= 1;
+    k >>= 1;
+    return (k) ? k - 1 : n;
+}
+
+//preconditions: a holds n items in Eytzinger order, out has room for n items.
+//postconditions: the items are copied to out in ascending order, the count is returned.
+template <typename T>
+size_t eytzinger_flatten(const T* a, size_t n, T* out, size_t k = 1)
+{
+    size_t count = 0;
+    if(k <= n)
+    {
+        count += eytzinger_flatten(a, n, out, 2 * k);
+        out[count++] = a[k - 1];
+        count += eytzinger_flatten(a, n, out + count, 2 * k + 1);
+    }
+    return count;
+}
+
+//A read-only search tree stored in one contiguous array in Eytzinger order, the layout of a
+// perfectly balanced tree (as built by tree_from_sorted_list) without any pointer. The top
+// levels share a few cache lines and every descent is branchless, so lookups in a read
+// mostly index are faster than in the AVL it was frozen from. Produced by AVL<T>::freeze().
+template <typename T>
+class FrozenTree
+{
+    //preconditions: none
+    //postconditions: print the items in ascending order.
+    friend ostream& operator<<(ostream& outs, const FrozenTree<T>& tree)
+    {
+        T* sorted = new T[tree._size];
+        eytzinger_flatten(tree._items, tree._size, sorted);
+        for(size_t i = 0; i < tree._size; i++)
+            outs << "|" << sorted[i] << "| ";
+        outs << endl;
+        delete [] sorted;
+        return outs;
+    }
+
+public:
+    FrozenTree();
+    FrozenTree(const T* sorted_list, size_t size); //the list must be sorted.
+    ~FrozenTree();
+
+    FrozenTree<T>& operator=(const FrozenTree<T>& rhs);
+    FrozenTree(const FrozenTree<T>& other);
+
+    const T* search(const T& target) const;        //returns the item equal to target, or null.
+    size_t flatten(T* out) const;                  //copy the items to out in ascending order.
+
+    //preconditions: none
+    //postconditions: returns the number of items.
+    inline size_t size() const
+    {
+        return _size;
+    }
+
+private:
+    T* _items;      //the items in Eytzinger order.
+    size_t _size;
+};
+
+//preconditions: none
+//postconditions: constructs an empty frozen tree.
+template <typename T>
+FrozenTree<T>::FrozenTree()
+{
+    _items = nullptr;
+    _size = 0;
+}
+
+//preconditions: sorted_list holds size items in ascending order.
+//postconditions: constructs a frozen tree holding the items of sorted_list.
+template <typename T>
+FrozenTree<T>::FrozenTree(const T* sorted_list, size_t size)
+{
+    _size = size;
+    _items = new T[_size];
+    size_t next = 0;
+    eytzinger_fill(sorted_list, _items, _size, next);
+}
+
+//preconditions: none
+//postconditions: deallocate the array.
+template <typename T>
+FrozenTree<T>::~FrozenTree()
+{
+    delete [] _items;
+}
+
+//preconditions: none
+//postconditions: this frozen tree holds a copy of the items of rhs.
+template <typename T>
+FrozenTree<T>& FrozenTree<T>::operator=(const FrozenTree<T>& rhs)
+{
+    if(&rhs == this)
+        return *this;
+
+    delete [] _items;
+    _size = rhs._size;
+    _items = new T[_size];
+    for(size_t i = 0; i < _size; i++)
+        _items[i] = rhs._items[i];
+    return *this;
+}
+
+//preconditions: none
+//postconditions: construct this frozen tree with a copy of the items of other.
+template <typename T>
+FrozenTree<T>::FrozenTree(const FrozenTree<T>& other)
+{
+    _size = other._size;
+    _items = new T[_size];
+    for(size_t i = 0; i < _size; i++)
+        _items[i] = other._items[i];
+}
+
+//preconditions: none
+//postconditions: returns a pointer to the item equal to target, or null if there is none.
+template <typename T>
+const T* FrozenTree<T>::search(const T& target) const
+{
+    size_t i = eytzinger_lower_bound(_items, _size, target);
+    return (i < _size && !(target < _items[i])) ? &_items[i] : nullptr;
+}
+
+//preconditions: out has room for size() items.
+//postconditions: the items are copied to out in ascending order, the count is returned.
+template <typename T>
+size_t FrozenTree<T>::flatten(T* out) const
+{
+    return eytzinger_flatten(_items, _size, out);
+}
+
+#endif // FROZEN_TREE_H
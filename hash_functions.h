@@ -0,0 +1,143 @@
+#ifndef HASH_FUNCTIONS_H
+#define HASH_FUNCTIONS_H
+
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include <random>
+
+using namespace std;
+
+//preconditions: none
+//postconditions: returns x rotated left by b bits.
+inline uint64_t siphash_rotl(uint64_t x, int b)
+{
+    return (x << b) | (x >> (64 - b));
+}
+
+//preconditions: none
+//postconditions: one SipRound is applied to the state.
+inline void siphash_round(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3)
+{
+    v0 += v1; v1 = siphash_rotl(v1, 13); v1 ^= v0; v0 = siphash_rotl(v0, 32);
+    v2 += v3; v3 = siphash_rotl(v3, 16); v3 ^= v2;
+    v0 += v3; v3 = siphash_rotl(v3, 21); v3 ^= v0;
+    v2 += v1; v1 = siphash_rotl(v1, 17); v1 ^= v2; v2 = siphash_rotl(v2, 32);
+}
+
+//preconditions: none
+//postconditions: returns SipHash-1-3 of the 4 byte key under the 128 bit secret (k0, k1).
+// Without the secret the outputs cannot be predicted, so keys cannot be chosen to collide.
+inline uint64_t siphash13(uint32_t key, uint64_t k0, uint64_t k1)
+{
+    uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
+    uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
+    uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
+    uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+
+    //the message fits in the last block: its length in the top byte, the key in the low bytes.
+    uint64_t b = (uint64_t(4) << 56) | key;
+    v3 ^= b;
+    siphash_round(v0, v1, v2, v3);
+    v0 ^= b;
+
+    v2 ^= 0xff;
+    siphash_round(v0, v1, v2, v3);
+    siphash_round(v0, v1, v2, v3);
+    siphash_round(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+//preconditions: none
+//postconditions: returns a well mixed 64 bit hash of the key (the splitmix64 finalizer). It is a
+// bijection, two keys never share all 64 bits, but it is public and offers no flooding protection.
+inline uint64_t hash_mix(int key)
+{
+    uint64_t h = uint64_t(uint32_t(key)) + 0x9E3779B97F4A7C15ULL;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
+}
+
+//preconditions: none
+//postconditions: maps a 32 bit hash onto [0, capacity) with a multiply instead of a modulo.
+inline size_t hash_reduce(uint32_t h, size_t capacity)
+{
+    return size_t((uint64_t(h) * capacity) >> 32);
+}
+
+//The hash function of a table. A table starts with the cheap key % capacity and switches to
+// a random secret once it detects flooding, every table gets its own secret so a key set that
+// collides in one table is spread evenly in any other.
+class table_hash
+{
+public:
+    table_hash(): _seeded(false), _k0(0), _k1(0) {}
+
+    //preconditions: none
+    //postconditions: returns a seeded hash with a fresh 128 bit secret.
+    static table_hash random()
+    {
+        random_device device;
+        table_hash h;
+        h._seeded = true;
+        h._k0 = (uint64_t(device()) << 32) ^ device();
+        h._k1 = ((uint64_t(device()) << 32) ^ device())
+                ^ uint64_t(chrono::steady_clock::now().time_since_epoch().count());
+        return h;
+    }
+
+    //preconditions: none
+    //postconditions: returns true once the table has switched to the seeded hash.
+    inline bool seeded() const
+    {
+        return _seeded;
+    }
+
+    //preconditions: seeded()
+    //postconditions: returns the 64 bit keyed hash of the key, its low and high halves are
+    // independent and are used as the first and second hash of the table.
+    inline uint64_t keyed(int key) const
+    {
+        return siphash13(uint32_t(key), _k0, _k1);
+    }
+
+private:
+    bool _seeded;
+    uint64_t _k0;
+    uint64_t _k1;
+};
+
+//preconditions: capacity > 0
+//postconditions: returns true if an insert that needed probes steps is far beyond the longest
+// probe run that size random keys reach. The longest cluster of linear probing at load a grows
+// like ln(size) / (a - 1 - ln(a)), well past the mean probe count, so the bound is a multiple of
+// that maximum and random keys stay below it at any load up to 0.9 and beyond. Keys that share
+// their hash build a single cluster that grows with every insert and soon cross it.
+inline bool probe_flooded(size_t probes, size_t size, size_t capacity)
+{
+    static const size_t MIN_PROBES = 64;
+    static const double FACTOR = 3.0;
+
+    if(probes <= MIN_PROBES)
+        return false;
+    double load = double(size) / double(capacity);
+    if(load < 0.01)
+        load = 0.01;
+    if(load > 0.99)
+        load = 0.99;
+    double longest = log(double(size) + 2.0) / (load - 1.0 - log(load));
+    return double(probes) > MIN_PROBES + FACTOR * longest;
+}
+
+//preconditions: capacity > 0
+//postconditions: returns true if a bucket holding depth records is far deeper than the
+// average size / capacity, a random key set stays within a small margin of the average.
+inline bool chain_flooded(size_t depth, size_t size, size_t capacity)
+{
+    static const size_t MIN_DEPTH = 16;
+    return depth > MIN_DEPTH + 2 * (size / capacity);
+}
+
+#endif // HASH_FUNCTIONS_H
@@ -18,11 +18,80 @@
  *      * INTERACTIVE_DOUBLE  : A doublehash will be created with table size = 17.
  *      * INTERACTIVE_CHAINED : A chainedhash will be created with table size = 5.
  *      * INTERACTIVE_OPEN    : A openhash will be created with table size = 17.
+ *      * RANDOM_FILTERED     : An openhash behind a blocked bloom filter will be created with table size = 100517,
+ *                              the number of misses the filter rejected is reported.
+ *      * CONCURRENT_AVL      : A ConcurrentAVL is stress tested by several threads, then its throughput
+ *                              is compared to an AVL behind a single mutex.
+ *      * RANDOM_EXTENDIBLE   : An extendiblehash will be created with one page and grow to 10051 insertions,
+ *                              the number of pages and the directory depth are reported.
+ *      * DISK_HASH           : A diskhash whose buffer pool holds 64 pages is filled with 4x as many records as
+ *                              the pool can hold, then searched, the time and page I/O are reported.
+ *      * HASH_FLOODING       : Keys that are all multiples of the table size are inserted into each table,
+ *                              the time taken and the number of reseeds the tables detected are reported.
+ *                              Random keys then fill an openhash and a doublehash of size 100517 to a load of
+ *                              0.9, ten times each, and any reseed is reported as an error.
+ *      * CACHE               : An openhash and a doublehash of size 10007 are used as caches of 7500 records
+ *                              under a skewed workload, the hit rate and evictions are reported.
+ *      * EXPIRY              : An openhash and a doublehash of size 100517 hold sessions that expire after up to
+ *                              1000 ticks while new ones arrive every tick, the expirations and time are reported.
+ *      * PERFECT_HASH        : An openhash of size 100517 is filled to half and frozen into a minimal perfect hash,
+ *                              the lookup time of both and the bits per key of the frozen table are reported.
+ *      * DURABLE_HASH        : Several threads insert and remove in a durablehash, the fsyncs that group commit
+ *                              saved are reported, then the table is reopened from its snapshot and log.
+ *      * INTERLEAVED         : An openhash and a doublehash of size 4000037 and a chainedhash of AVL buckets are
+ *                              filled with 2800000 records, then searched one key at a time and in batches
+ *                              whose probes are interleaved, the time of both is reported.
+ *      * PARTITIONED         : A partitionedhash of doublehash shards serves a write heavy workload from as many
+ *                              producer threads as shards, for 1, 2, 4, ... shards up to the core count, the
+ *                              throughput is reported next to one doublehash behind a mutex.
+ *      * ASYNC               : An asynchash over a doublehash of size 4000037 is sent 2800000 inserts and then as
+ *                              many finds with callbacks, its worker runs them in batches sorted by home slot.
+ *                              The time, batches and errors are reported next to calling a doublehash directly.
+ *      * CONCURRENT_RESIZE   : A concurrent openhash of 17 slots grows to 1000000 records while reader threads
+ *                              search it, the resizes, reads, the longest lookup and the records reclaimed
+ *                              through epochs are reported.
+ *      * ORDERED             : An avl and a chainedhash with a sorted index hold random keys that are inserted
+ *                              and removed, the index is enabled once the table is half full. rank, select,
+ *                              count_range and range are checked against a std::set.
+ *      * SET_OPERATIONS      : Two avls are united, intersected and subtracted by the linear merge (similar sizes),
+ *                              by split / join (one 16x smaller) and by split / join on 2 levels of threads.
+ *                              Every result is checked against the std algorithms and for balance, then unite
+ *                              is timed against inserting the nodes one at a time.
+ *      * BUCKET_POLICIES     : A chainedhash of 1009 buckets holding 100000 records, about 100 per bucket, is run
+ *                              through the random test with each bucket policy (adaptive, avl, compact, block),
+ *                              then inserts, finds and removes are timed for each and the bytes per record
+ *                              reported. A compact avl is checked against a std::set, with its copies.
+ *      * FROZEN              : An avl and a chainedhash are filled with random keys and frozen, every present and
+ *                              absent key is checked in the frozen copies, one at a time and in batches, and the
+ *                              lookups are timed against the structures they were frozen from.
+ *      * PERSISTENT_AVL      : One thread inserts and erases in a PersistentAVL while several threads take snapshots,
+ *                              every snapshot must be sorted, match its size and stay the same after later writes.
+ *      * TWO_CHOICES         : 100003 random keys are inserted in chainedhashes of 100003 buckets with one and two
+ *                              choices per key, the deepest bucket of each is reported and every key checked.
+ *      * LINEAR_HASHING      : Chainedhashes of 7 buckets with one and two choices grow by linear hashing past 1.5
+ *                              records per bucket while 100000 keys are inserted and some removed, the number of
+ *                              buckets is reported as they grow and every key checked.
  *
  ************************************************************************************************************************/
+#include <climits>
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <mutex>
+#include <set>
 #include "chainedhash.h"
 #include "doublehash.h"
 #include "openhash.h"
+#include "concurrent_avl.h"
+#include "filteredhash.h"
+#include "extendiblehash.h"
+#include "diskhash.h"
+#include "durablehash.h"
+#include "partitionedhash.h"
+#include "asynchash.h"
+#include "concurrent_openhash.h"
+#include "persistent_avl.h"
+#include <algorithm>
 using namespace std;
 
 //preconditions: hash must be initialized.
@@ -39,6 +108,129 @@ void testHashTableInteractive(T& hash);
 template<typename T>
 void testHashTableRandom(T& hash, size_t items, string& str);
 
+//preconditions: threads > 0.
+//postconditions: each thread inserts, erases and searches its own stripe of keys in a shared
+// ConcurrentAVL and the result is checked against a std::set per thread. Then a mixed workload
+// (80% search) is timed on the ConcurrentAVL and on an AVL guarded by one mutex.
+void testConcurrentAVL(size_t threads, size_t operations);
+
+//preconditions: hash must be initialized, items < hash.capacity().
+//postconditions: items keys that are all multiples of the capacity (they share key % capacity)
+// are inserted and searched for, the time taken and the reseeds of the table are reported.
+template<typename T>
+void testHashFlooding(T& hash, size_t items, string& str);
+
+//preconditions: capacity > 0, 0 < load < 1.
+//postconditions: runs tables of type T are filled with random keys up to load, every table that
+// reseeds, a false alarm of the flood detector, is reported as an error.
+template<typename T>
+void testRandomReseeds(size_t capacity, double load, size_t runs, string& str);
+
+//preconditions: frames >= 2.
+//postconditions: a DiskHash with a pool of frames pages is filled with 4x the records the pool can
+// hold, every key is searched for, then as many missing keys, the time and the pool I/O are reported.
+void testDiskHash(size_t frames);
+
+//preconditions: hash must be initialized, budget <= hash.capacity().
+//postconditions: the table becomes a cache of budget records and serves operations lookups, 80% of
+// them to 2 * budget / 3 hot keys, a miss inserts the key. The hit rate and evictions are reported.
+template<typename T>
+void testCache(T& hash, size_t budget, size_t operations, string& str);
+
+//preconditions: hash must be initialized, 500 * perTick < hash.capacity().
+//postconditions: for ticks ticks, perTick sessions that expire 1 to 1000 ticks later are inserted
+// and as many random sessions are searched for, then the clock advances a tick. Every record found
+// is checked to be alive, the expirations, the records left and the time are reported.
+template<typename T>
+void testExpiry(T& hash, size_t ticks, size_t perTick, string& str);
+
+//preconditions: items < capacity.
+//postconditions: an OpenHash of capacity is filled with items random records and frozen, every key
+// and as many missing keys are searched for in both, the times and the bits per key are reported.
+void testPerfectHash(size_t capacity, size_t items);
+
+//preconditions: threads > 0.
+//postconditions: each thread inserts operations records in a DurableHash and removes every
+// fourth, the commits per fsync and the time are reported. The table is then reopened and
+// checked against what was acknowledged.
+void testDurableHash(size_t threads, size_t operations);
+
+//preconditions: hash must be initialized, items < hash.capacity() for open addressing.
+//postconditions: items random records are inserted, then every key and as many missing keys are
+// searched for with is_present one at a time, and again in batches of BATCH keys whose probes are
+// interleaved. Both results are checked against each other, the times are reported.
+template<typename T>
+void testInterleaved(T& hash, size_t items, string& str);
+
+//preconditions: maxCores > 0.
+//postconditions: for 1, 2, 4, ... shards up to maxCores, as many producers send operations requests
+// each (50% insert, 25% remove, 25% find) to a PartitionedHash and the replies are checked, then the
+// same threads run the workload on one DoubleHash behind a mutex. The throughput of both is reported.
+void testPartitionedHash(size_t maxCores, size_t operations);
+
+//preconditions: items < capacity.
+//postconditions: items random inserts and then as many finds (half of them for missing keys) are
+// submitted to an AsyncHash of capacity with callbacks that check the results, and the same
+// operations are run directly on a DoubleHash. The times and the batches are reported.
+void testAsyncHash(size_t capacity, size_t items);
+
+//preconditions: readers > 0.
+//postconditions: one writer inserts items records into a ConcurrentOpenHash of 17 slots and removes
+// every fourth, while readers search for the keys inserted so far and for missing keys. Every
+// result is checked, the resizes, the reads, the longest lookup and the epoch counters are reported.
+void testConcurrentResize(size_t readers, size_t items);
+
+//preconditions: items > 0.
+//postconditions: items random keys are inserted in an AVL and a ChainedHash of TABLE_SIZE and a
+// quarter of them removed, the sorted index of the table is enabled half way so it is built from
+// the buckets. rank, select, count_range and range of both are checked against a std::set.
+void testOrderStatistics(size_t items);
+
+//preconditions: items > 0.
+//postconditions: two AVLs of random keys are combined by unite, intersect and subtract through the
+// linear merge, the split / join algorithm and split / join with parallelDepth 2. Every result is
+// compared with set_union, set_intersection and set_difference and checked for balance. unite is
+// timed against inserting every node of the other tree one at a time.
+void testSetOperations(size_t items);
+
+//preconditions: items > 0, capacity > 0.
+//postconditions: a ChainedHash<Record<int>, Bucket> of capacity runs testHashTableRandom with items
+// records, then items random keys are inserted, searched for with as many missing keys and removed
+// from a fresh table, every result is checked and the time of each step reported with the bytes
+// of the buckets and their pool per record.
+template<typename Bucket>
+void testBucketPolicy(size_t capacity, size_t items, string str);
+
+//preconditions: items > 0.
+//postconditions: random keys are inserted in a CompactAVL and some erased, it is checked against a
+// std::set, then a copy and an assigned tree are changed and all three checked, with isBalanced.
+void testCompactAVL(size_t items);
+
+//preconditions: items > 0, capacity > 0.
+//postconditions: an AVL<int> and a ChainedHash<Record<int> > of capacity are filled with items even
+// keys and frozen, every even key is searched for in both copies and every odd key must be missing,
+// with the single and the batched is_present. The lookups are timed against the source structures.
+void testFrozen(size_t capacity, size_t items);
+
+//preconditions: readers > 0.
+//postconditions: one writer inserts and erases operations random keys in a shared PersistentAVL
+// while readers threads take snapshots. Each snapshot must be sorted, its size must equal the count of
+// range over all keys, and it must read the same once the writer has gone on. The last version is
+// checked against the writer's std::set.
+void testPersistentAVL(size_t readers, size_t operations);
+
+//preconditions: capacity > 0.
+//postconditions: capacity random keys are inserted in ChainedHashes of capacity buckets placing each
+// key by one hash and by the less loaded of two, the deepest bucket of each is reported. Every key
+// must be found, then removed, in both tables.
+void testTwoChoices(size_t capacity);
+
+//preconditions: capacity > 0, items > 0, maxLoad > 0.
+//postconditions: a ChainedHash of capacity buckets grows by linear hashing past maxLoad while items
+// random keys are inserted and every fourth one removed. The table must grow by one bucket at a time
+// and stay within maxLoad, then every inserted key must be found or, if removed, missing.
+void testLinearHashing(size_t capacity, size_t items, double maxLoad, bool twoChoices);
+
 //preconditions: none
 //postconditions: a valid menu selection from cin is returned.
 char getMenuSelection(string &prompt, string &validEntries);
@@ -54,6 +246,26 @@ const bool RANDOM_OPEN = true;
 const bool INTERACTIVE_DOUBLE = true;
 const bool INTERACTIVE_CHAINED = false;
 const bool INTERACTIVE_OPEN = false;
+const bool RANDOM_FILTERED = false;
+const bool CONCURRENT_AVL = false;
+const bool RANDOM_EXTENDIBLE = false;
+const bool HASH_FLOODING = false;
+const bool DISK_HASH = false;
+const bool CACHE = false;
+const bool EXPIRY = false;
+const bool PERFECT_HASH = false;
+const bool DURABLE_HASH = false;
+const bool INTERLEAVED = false;
+const bool PARTITIONED = false;
+const bool ASYNC = false;
+const bool CONCURRENT_RESIZE = false;
+const bool ORDERED = false;
+const bool SET_OPERATIONS = false;
+const bool BUCKET_POLICIES = false;
+const bool FROZEN = false;
+const bool PERSISTENT_AVL = false;
+const bool TWO_CHOICES = false;
+const bool LINEAR_HASHING = false;
 
 //The table size for random tests.
 const size_t TABLE_SIZE = 100517;
@@ -108,6 +320,147 @@ int main()
         DoubleHash<Record<int> > doubleHash(TABLE_SIZE);
         testHashTableRandom(doubleHash, itemsToInsert,message);
     }
+    if (RANDOM_FILTERED){
+        //----------- RANDOM TEST ------------------------------
+        //. . . . . .  Filtered Open Hash Table . . . . . . . . . . .;
+        size_t itemsToInsert = TABLE_SIZE / 10;
+        string message = "Filtered Open Hash: Table Size = " +
+                to_string(TABLE_SIZE) + " : Insertions = " + to_string(itemsToInsert);
+        FilteredHash<OpenHash<Record<int> > > filteredHash(TABLE_SIZE);
+        testHashTableRandom(filteredHash, itemsToInsert,message);
+        cout << "Lookups rejected by the filter: " << filteredHash.filtered() << endl;
+    }
+    if (RANDOM_EXTENDIBLE){
+        //----------- RANDOM TEST ------------------------------
+        //. . . . . .  Extendible Hash Table . . . . . . . . . . .;
+        size_t itemsToInsert = TABLE_SIZE / 10;
+        string message = "Extendible Hash: Pages grow on demand : Insertions = " + to_string(itemsToInsert);
+        ExtendibleHash<Record<int> > extendibleHash;
+        testHashTableRandom(extendibleHash, itemsToInsert,message);
+        cout << "Pages: " << extendibleHash.pages() << ", directory depth: " << extendibleHash.global_depth() << endl;
+    }
+    if (CONCURRENT_AVL){
+        //----------- CONCURRENT TEST ------------------------------
+        testConcurrentAVL(thread::hardware_concurrency() ? thread::hardware_concurrency() : 4, 1000000);
+    }
+    if (DISK_HASH){
+        //----------- OUT OF CORE TEST ------------------------------
+        testDiskHash(64);
+    }
+    if (HASH_FLOODING){
+        //----------- FLOODING TEST ------------------------------
+        const size_t FLOOD_SIZE = 10007;
+        size_t itemsToInsert = FLOOD_SIZE / 2;
+        string message = "Open Hash: Table Size = " + to_string(FLOOD_SIZE);
+        OpenHash<Record<int> > openHash(FLOOD_SIZE);
+        testHashFlooding(openHash, itemsToInsert, message);
+
+        message = "Double Hash: Table Size = " + to_string(FLOOD_SIZE);
+        DoubleHash<Record<int> > doubleHash(FLOOD_SIZE);
+        testHashFlooding(doubleHash, itemsToInsert, message);
+
+        message = "Chained Hash: Table Size = " + to_string(FLOOD_SIZE);
+        ChainedHash<Record<int> > chained(FLOOD_SIZE);
+        testHashFlooding(chained, itemsToInsert, message);
+
+        message = "Open Hash: Table Size = 100517";
+        testRandomReseeds<OpenHash<Record<int> > >(100517, 0.9, 10, message);
+        message = "Double Hash: Table Size = 100517";
+        testRandomReseeds<DoubleHash<Record<int> > >(100517, 0.9, 10, message);
+    }
+    if (CACHE){
+        //----------- CACHE TEST ------------------------------
+        const size_t CACHE_SIZE = 10007;
+        const size_t BUDGET = 7500;
+        string message = "Open Hash: Table Size = " + to_string(CACHE_SIZE) + " : Budget = " + to_string(BUDGET);
+        OpenHash<Record<int> > openHash(CACHE_SIZE);
+        testCache(openHash, BUDGET, 1000000, message);
+
+        message = "Double Hash: Table Size = " + to_string(CACHE_SIZE) + " : Budget = " + to_string(BUDGET);
+        DoubleHash<Record<int> > doubleHash(CACHE_SIZE);
+        testCache(doubleHash, BUDGET, 1000000, message);
+    }
+    if (EXPIRY){
+        //----------- EXPIRY TEST ------------------------------
+        string message = "Open Hash: Table Size = " + to_string(TABLE_SIZE);
+        OpenHash<Record<int> > openHash(TABLE_SIZE);
+        testExpiry(openHash, 10000, 100, message);
+
+        message = "Double Hash: Table Size = " + to_string(TABLE_SIZE);
+        DoubleHash<Record<int> > doubleHash(TABLE_SIZE);
+        testExpiry(doubleHash, 10000, 100, message);
+    }
+    if (PERFECT_HASH){
+        //----------- FROZEN TEST ------------------------------
+        testPerfectHash(TABLE_SIZE, TABLE_SIZE / 2);
+    }
+    if (DURABLE_HASH){
+        //----------- DURABILITY TEST ------------------------------
+        testDurableHash(8, 2000);
+    }
+    if (INTERLEAVED){
+        //----------- INTERLEAVED LOOKUP TEST ------------------------------
+        const size_t LARGE_SIZE = 4000037;
+        const size_t ITEMS = 2800000;
+        string message = "Open Hash: Table Size = " + to_string(LARGE_SIZE);
+        OpenHash<Record<int> > openHash(LARGE_SIZE);
+        testInterleaved(openHash, ITEMS, message);
+
+        message = "Double Hash: Table Size = " + to_string(LARGE_SIZE);
+        DoubleHash<Record<int> > doubleHash(LARGE_SIZE);
+        testInterleaved(doubleHash, ITEMS, message);
+
+        message = "Chained Hash (AVL buckets): Table Size = " + to_string(TABLE_SIZE);
+        ChainedHash<Record<int>, AVLBucket<Record<int> > > chained(TABLE_SIZE);
+        testInterleaved(chained, ITEMS, message);
+    }
+    if (PARTITIONED){
+        //----------- PARTITIONED TEST ------------------------------
+        testPartitionedHash(thread::hardware_concurrency() ? thread::hardware_concurrency() : 4, 1000000);
+    }
+    if (ASYNC){
+        //----------- ASYNC TEST ------------------------------
+        testAsyncHash(4000037, 2800000);
+    }
+    if (CONCURRENT_RESIZE){
+        //----------- CONCURRENT RESIZE TEST ------------------------------
+        testConcurrentResize(thread::hardware_concurrency() > 1 ? thread::hardware_concurrency() - 1 : 3, 1000000);
+    }
+    if (ORDERED){
+        //----------- ORDER STATISTICS TEST ------------------------------
+        testOrderStatistics(TABLE_SIZE / 10);
+    }
+    if (SET_OPERATIONS){
+        //----------- SET OPERATIONS TEST ------------------------------
+        testSetOperations(200000);
+    }
+    if (BUCKET_POLICIES){
+        //----------- BUCKET POLICY TEST ------------------------------
+        const size_t SMALL_SIZE = 1009;
+        const size_t ITEMS = 100000;
+        testBucketPolicy<AdaptiveBucket<Record<int> > >(SMALL_SIZE, ITEMS, "Adaptive buckets");
+        testBucketPolicy<AVLBucket<Record<int> > >(SMALL_SIZE, ITEMS, "AVL buckets");
+        testBucketPolicy<CompactBucket<Record<int> > >(SMALL_SIZE, ITEMS, "Compact AVL buckets");
+        testBucketPolicy<BlockBucket<Record<int> > >(SMALL_SIZE, ITEMS, "Sorted block buckets");
+        testCompactAVL(ITEMS);
+    }
+    if (FROZEN){
+        //----------- FROZEN TEST ------------------------------
+        testFrozen(TABLE_SIZE, TABLE_SIZE / 2);
+    }
+    if (PERSISTENT_AVL){
+        //----------- PERSISTENT TEST ------------------------------
+        testPersistentAVL(thread::hardware_concurrency() ? thread::hardware_concurrency() : 4, 200000);
+    }
+    if (TWO_CHOICES){
+        //----------- TWO CHOICES TEST ------------------------------
+        testTwoChoices(100003);
+    }
+    if (LINEAR_HASHING){
+        //----------- LINEAR HASHING TEST ------------------------------
+        testLinearHashing(7, 100000, 1.5, false);
+        testLinearHashing(7, 100000, 1.5, true);
+    }
 
     cout<<endl<<endl<<endl<<"---------------------------------"<<endl;
 }
@@ -253,6 +606,1218 @@ void testHashTableRandom(T& hash, size_t items, string& str)
 
 }
 
+//preconditions: hash must be initialized, items < hash.capacity().
+//postconditions: keys 0, capacity, 2 * capacity ... are inserted and searched for.
+template<typename T>
+void testHashFlooding(T& hash, size_t items, string& str)
+{
+    cout << "********************************************************************************" << endl
+         << "                    H A S H   F L O O D I N G   T E S T:                        " << endl
+         << "********************************************************************************" << endl;
+    cout << str << " : Insertions = " << items << endl;
+
+    int stride = int(hash.capacity());
+    auto start = chrono::steady_clock::now();
+    for(size_t i = 0; i < items; i++)
+        hash.insert(Record<int>(int(i) * stride, int(i)));
+    for(size_t i = 0; i < items; i++)
+        if(!hash.is_present(int(i) * stride))
+            cout << "Error: item with key = " << int(i) * stride << " could not be found." << endl;
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Inserted and found " << hash.size() << " keys in " << seconds << " s, reseeds: "
+         << hash.reseeds() << endl
+         << "------------------ END FLOODING TEST ----------------------" << endl;
+}
+
+template<typename T>
+void testRandomReseeds(size_t capacity, double load, size_t runs, string& str)
+{
+    cout << "********************************************************************************" << endl
+         << "                 R A N D O M   K E Y   R E S E E D   T E S T:                   " << endl
+         << "********************************************************************************" << endl;
+    cout << str << " : Load = " << load << " : Runs = " << runs << endl;
+
+    size_t reseeded = 0;
+    for(size_t run = 0; run < runs; run++)
+    {
+        T hash(capacity);
+        mt19937 generator(unsigned(run) + 1);
+        size_t items = size_t(load * double(capacity));
+        while(hash.size() < items)
+            hash.insert(Record<int>(int(generator() & 0x7fffffff), 0));
+        if(hash.reseeds())
+        {
+            cout << "Error: random keys reseeded the table in run " << run << "." << endl;
+            reseeded++;
+        }
+    }
+
+    cout << "Runs that reseeded: " << reseeded << endl
+         << "------------------ END RANDOM KEY RESEED TEST ----------------------" << endl;
+}
+
+//preconditions: frames >= 2.
+//postconditions: the table is built in diskhash.bin, which is removed afterwards.
+void testDiskHash(size_t frames)
+{
+    const size_t PAGE_SLOTS = 256;
+    const char* PATH = "diskhash.bin";
+    size_t items = 4 * frames * PAGE_SLOTS;
+
+    cout << "********************************************************************************" << endl
+         << "                    O U T   O F   C O R E   H A S H   T E S T:                  " << endl
+         << "********************************************************************************" << endl;
+    cout << "Pool: " << frames << " pages of " << PAGE_SLOTS << " records : Insertions = " << items << endl;
+
+    size_t reads = 0, writes = 0, pages = 0, errors = 0;
+    double insertSeconds = 0, searchSeconds = 0;
+    {
+        DiskHash<Record<int>, PAGE_SLOTS> diskHash(PATH, frames);
+        vector<int> keys(items);
+        for(size_t i = 0; i < items; i++)
+            keys[i] = int(i * 7 + 1);
+        default_random_engine engine;
+        shuffle(keys.begin(), keys.end(), engine);
+
+        auto start = chrono::steady_clock::now();
+        for(size_t i = 0; i < items; i++)
+            diskHash.insert(Record<int>(keys[i], int(i)));
+        auto inserted = chrono::steady_clock::now();
+
+        shuffle(keys.begin(), keys.end(), engine);
+        for(size_t i = 0; i < items; i++)
+            if(!diskHash.is_present(keys[i]) || diskHash.is_present(keys[i] + 1))
+                errors++;
+        auto searched = chrono::steady_clock::now();
+
+        insertSeconds = chrono::duration<double>(inserted - start).count();
+        searchSeconds = chrono::duration<double>(searched - inserted).count();
+        reads = diskHash.pool().reads();
+        writes = diskHash.pool().writes();
+        pages = diskHash.pool().pages();
+    }
+    remove(PATH);
+
+    cout << "Pages in the file: " << pages << " (" << double(pages) / frames << "x the pool)" << endl
+         << "Insert: " << insertSeconds << " s, search " << 2 * items << " keys: " << searchSeconds << " s" << endl
+         << "Page reads: " << reads << ", page writes: " << writes << ", errors: " << errors << endl
+         << "------------------ END OUT OF CORE TEST ----------------------" << endl;
+}
+
+template<typename T>
+void testCache(T& hash, size_t budget, size_t operations, string& str)
+{
+    cout << "********************************************************************************" << endl
+         << "                          C A C H E   T E S T:                                  " << endl
+         << "********************************************************************************" << endl;
+    cout << str << " : Lookups = " << operations << endl;
+
+    hash.enable_cache(budget);
+    default_random_engine engine;
+    uniform_int_distribution<int> hot(0, int(2 * budget / 3) - 1);
+    uniform_int_distribution<int> cold(int(budget), INT_MAX - 1);
+    uniform_int_distribution<int> percent(0, 99);
+
+    size_t errors = 0;
+    auto start = chrono::steady_clock::now();
+    for(size_t i = 0; i < operations; i++)
+    {
+        int key = (percent(engine) < 80) ? hot(engine) : cold(engine);
+        bool found;
+        Record<int> result;
+        hash.find(key, found, result);
+        if(found && result.data != key / 2)
+            errors++;
+        if(!found && !hash.insert(Record<int>(key, key / 2)))
+            errors++;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Hit rate: " << 100.0 * hash.hits() / (hash.hits() + hash.misses()) << "% (80% of the lookups are hot)" << endl
+         << "Evictions: " << hash.evictions() << ", records: " << hash.size() << ", errors: " << errors << endl
+         << "Time: " << seconds << " s" << endl
+         << "------------------ END CACHE TEST ----------------------" << endl;
+}
+
+template<typename T>
+void testExpiry(T& hash, size_t ticks, size_t perTick, string& str)
+{
+    cout << "********************************************************************************" << endl
+         << "                          E X P I R Y   T E S T:                                " << endl
+         << "********************************************************************************" << endl;
+    cout << str << " : Ticks = " << ticks << " : Sessions per tick = " << perTick << endl;
+
+    //the data of a session is the tick it expires, so a lookup can check it is alive. Session n
+    // gets the key n * 2654435761 mod 2^31, distinct keys spread over the whole range.
+    auto sessionKey = [](int n) { return int((uint64_t(n) * 2654435761u) & INT_MAX); };
+    default_random_engine engine;
+    uniform_int_distribution<int> lifetime(1, 1000);
+    int nextKey = 0;
+    size_t found = 0, errors = 0;
+
+    auto start = chrono::steady_clock::now();
+    for(size_t tick = 0; tick < ticks; tick++)
+    {
+        for(size_t i = 0; i < perTick; i++)
+        {
+            int expires = int(tick) + lifetime(engine);
+            if(!hash.insert(Record<int>(sessionKey(nextKey++), expires), uint64_t(expires)))
+                errors++;
+        }
+
+        uniform_int_distribution<int> session(0, nextKey - 1);
+        for(size_t i = 0; i < perTick; i++)
+        {
+            bool isFound;
+            Record<int> result;
+            hash.find(sessionKey(session(engine)), isFound, result);
+            if(isFound && uint64_t(result.data) <= hash.now())
+                errors++;
+            found += isFound;
+        }
+
+        hash.advance(tick + 1);
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Sessions: " << nextKey << ", expired: " << hash.expirations() << ", alive: " << hash.size() << endl
+         << "Lookups that found a live session: " << found << ", errors: " << errors << endl
+         << "Time: " << seconds << " s (" << 1e6 * seconds / ticks << " us per tick)" << endl
+         << "------------------ END EXPIRY TEST ----------------------" << endl;
+}
+
+void testPerfectHash(size_t capacity, size_t items)
+{
+    cout << "********************************************************************************" << endl
+         << "                     P E R F E C T   H A S H   T E S T:                         " << endl
+         << "********************************************************************************" << endl;
+    cout << "Open Hash: Table Size = " << capacity << " : Insertions = " << items << endl;
+
+    //the even keys are inserted, so every odd key is known to be missing.
+    OpenHash<Record<int> > openHash(capacity);
+    default_random_engine engine;
+    uniform_int_distribution<int> random(0, INT_MAX / 2 - 1);
+    vector<int> keys;
+    while(keys.size() < items)
+    {
+        int key = 2 * random(engine);
+        if(openHash.insert(Record<int>(key, key % 10000)))
+            keys.push_back(key);
+    }
+
+    auto start = chrono::steady_clock::now();
+    PerfectHash<Record<int> > frozen = openHash.freeze();
+    double buildSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    size_t errors = 0;
+    start = chrono::steady_clock::now();
+    for(size_t i = 0; i < items; i++)
+        if(!openHash.is_present(keys[i]) || openHash.is_present(keys[i] + 1))
+            errors++;
+    double openSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    for(size_t i = 0; i < items; i++)
+        if(!frozen.is_present(keys[i]) || frozen.is_present(keys[i] + 1))
+            errors++;
+    double frozenSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Freeze: " << buildSeconds << " s, " << frozen.bits_per_key() << " bits per key" << endl
+         << "Search " << 2 * items << " keys: open hash " << openSeconds << " s, perfect hash " << frozenSeconds << " s" << endl
+         << "Errors: " << errors << endl
+         << "------------------ END PERFECT HASH TEST ----------------------" << endl;
+}
+
+void testDurableHash(size_t threads, size_t operations)
+{
+    const char* PATH = "durablehash";
+    const string LOG = string(PATH) + ".log";
+    const string SNAPSHOT = string(PATH) + ".snapshot";
+
+    cout << "********************************************************************************" << endl
+         << "                     D U R A B L E   H A S H   T E S T:                         " << endl
+         << "********************************************************************************" << endl;
+    cout << "Threads: " << threads << " : Inserts per thread = " << operations << endl;
+
+    remove(LOG.c_str());
+    remove(SNAPSHOT.c_str());
+
+    size_t commits = 0, syncs = 0, checkpoints = 0, size = 0, errors = 0;
+    double seconds = 0;
+    {
+        DurableHash<Record<int> > durable(PATH, TABLE_SIZE, 1 << 18);
+        vector<thread> workers;
+        auto start = chrono::steady_clock::now();
+        for(size_t t = 0; t < threads; t++)
+            workers.push_back(thread([&durable, t, operations]()
+            {
+                for(size_t i = 0; i < operations; i++)
+                {
+                    int key = int(t * operations + i);
+                    durable.insert(Record<int>(key, key % 10000));
+                    if(i % 4 == 0)
+                        durable.remove(key);
+                }
+            }));
+        for(size_t t = 0; t < threads; t++)
+            workers[t].join();
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        commits = durable.log().appends();
+        syncs = durable.log().syncs();
+        checkpoints = durable.checkpoints();
+        size = durable.size();
+    }
+
+    DurableHash<Record<int> > reopened(PATH, TABLE_SIZE);
+    for(size_t key = 0; key < threads * operations; key++)
+        if(reopened.is_present(int(key)) != ((key % operations) % 4 != 0))
+            errors++;
+
+    cout << "Commits: " << commits << ", fsyncs: " << syncs << " (" << double(commits) / syncs << " commits per fsync)" << endl
+         << "Time: " << seconds << " s, checkpoints: " << checkpoints << endl
+         << "Reopened: " << reopened.size() << " of " << size << " records, " << reopened.recovered()
+         << " log frames replayed, errors: " << errors << endl
+         << "------------------ END DURABLE HASH TEST ----------------------" << endl;
+
+    remove(LOG.c_str());
+    remove(SNAPSHOT.c_str());
+}
+
+template<typename T>
+void testInterleaved(T& hash, size_t items, string& str)
+{
+    const size_t BATCH = 1024;
+
+    cout << "********************************************************************************" << endl
+         << "                  I N T E R L E A V E D   L O O K U P   T E S T:                " << endl
+         << "********************************************************************************" << endl;
+    cout << str << " : Insertions = " << items << endl;
+
+    //the even keys are inserted, so every odd key is known to be missing.
+    default_random_engine engine;
+    uniform_int_distribution<int> random(0, INT_MAX / 2 - 1);
+    vector<int> keys;
+    while(keys.size() < 2 * items)
+    {
+        int key = 2 * random(engine);
+        if(hash.insert(Record<int>(key, key % 10000)))
+        {
+            keys.push_back(key);
+            keys.push_back(key + 1);
+        }
+    }
+    shuffle(keys.begin(), keys.end(), engine);
+
+    bool* sequential = new bool[keys.size()];
+    bool* batched = new bool[keys.size()];
+
+    auto start = chrono::steady_clock::now();
+    for(size_t i = 0; i < keys.size(); i++)
+        sequential[i] = hash.is_present(keys[i]);
+    double sequentialSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    for(size_t i = 0; i < keys.size(); i += BATCH)
+        hash.is_present(&keys[i], min(BATCH, keys.size() - i), &batched[i]);
+    double batchedSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    size_t found = 0, errors = 0;
+    for(size_t i = 0; i < keys.size(); i++)
+    {
+        found += batched[i];
+        if(batched[i] != sequential[i] || batched[i] != (keys[i] % 2 == 0))
+            errors++;
+    }
+    delete[] sequential;
+    delete[] batched;
+
+    cout << "Search " << keys.size() << " keys: one at a time " << sequentialSeconds << " s, interleaved "
+         << batchedSeconds << " s (" << sequentialSeconds / batchedSeconds << "x)" << endl
+         << "Found: " << found << ", errors: " << errors << endl
+         << "------------------ END INTERLEAVED LOOKUP TEST ----------------------" << endl;
+}
+
+void testPartitionedHash(size_t maxCores, size_t operations)
+{
+    const int MAX_KEY = 1000000;
+    typedef PartitionedHash<Record<int>, DoubleHash<Record<int> > > partitioned;
+
+    cout << "********************************************************************************" << endl
+         << "                  P A R T I T I O N E D   H A S H   T E S T:                    " << endl
+         << "********************************************************************************" << endl;
+    cout << "Operations per producer: " << operations << ", 50% insert, 25% remove, 25% find" << endl;
+
+    for(size_t cores = 1; cores <= maxCores; cores *= 2)
+    {
+        //producer t owns the keys equal to t modulo cores, so it knows what every reply must be.
+        partitioned table(cores, cores, 2 * MAX_KEY / cores + 1);
+        vector<size_t> errors(cores, 0);
+        vector<thread> producers;
+        auto start = chrono::steady_clock::now();
+        for(size_t t = 0; t < cores; t++)
+            producers.push_back(thread([&, t]()
+            {
+                const size_t POLL = 256;
+                vector<bool> present(MAX_KEY / cores + 1, false);
+                unsigned seed = unsigned(t) * 7919 + 1;
+                auto check = [&](const partitioned::reply& r)
+                {
+                    bool expected = (r.tag & 1) != 0;
+                    if(r.ok != expected || (r.op == partitioned::FIND && r.ok && r.record.key != int(r.tag >> 1)))
+                        errors[t]++;
+                };
+
+                for(size_t i = 0; i < operations; i++)
+                {
+                    seed = seed * 1103515245 + 12345;
+                    size_t slot = (seed >> 8) % (MAX_KEY / cores);
+                    int key = int(slot * cores + t);
+                    uint64_t tag = uint64_t(key) << 1;   //the low bit is the expected result.
+                    switch((seed >> 4) % 4)
+                    {
+                    case 0:
+                    case 1:
+                        table.insert(t, Record<int>(key, key % 10000), tag | !present[slot]);
+                        present[slot] = true;
+                        break;
+                    case 2:
+                        table.remove(t, key, tag | present[slot]);
+                        present[slot] = false;
+                        break;
+                    default:
+                        table.find(t, key, tag | present[slot]);
+                    }
+                    if(i % POLL == 0)
+                        table.poll(t, check);
+                }
+
+                table.flush(t);
+                while(table.outstanding(t) > 0)
+                {
+                    table.poll(t, check);
+                    this_thread::yield();
+                }
+            }));
+        for(size_t t = 0; t < cores; t++)
+            producers[t].join();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        //the same workload on one table behind a mutex.
+        DoubleHash<Record<int> > shared(2 * MAX_KEY + 1);
+        mutex lock;
+        vector<thread> lockers;
+        start = chrono::steady_clock::now();
+        for(size_t t = 0; t < cores; t++)
+            lockers.push_back(thread([&, t]()
+            {
+                unsigned seed = unsigned(t) * 7919 + 1;
+                for(size_t i = 0; i < operations; i++)
+                {
+                    seed = seed * 1103515245 + 12345;
+                    int key = int(((seed >> 8) % (MAX_KEY / cores)) * cores + t);
+                    lock_guard<mutex> guard(lock);
+                    switch((seed >> 4) % 4)
+                    {
+                    case 0:
+                    case 1:
+                        shared.insert(Record<int>(key, key % 10000));
+                        break;
+                    case 2:
+                        shared.remove(key);
+                        break;
+                    default:
+                        shared.is_present(key);
+                    }
+                }
+            }));
+        for(size_t t = 0; t < cores; t++)
+            lockers[t].join();
+        double lockedSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        size_t totalErrors = 0;
+        for(size_t t = 0; t < cores; t++)
+            totalErrors += errors[t];
+        double total = double(cores * operations) / 1e6;
+        cout << "Shards: " << cores << " : partitioned " << total / seconds << " Mops/s, mutex "
+             << total / lockedSeconds << " Mops/s, records: " << table.size() << " (" << shared.size()
+             << "), errors: " << totalErrors << endl;
+    }
+    cout << "------------------ END PARTITIONED HASH TEST ----------------------" << endl;
+}
+
+void testAsyncHash(size_t capacity, size_t items)
+{
+    cout << "********************************************************************************" << endl
+         << "                       A S Y N C   H A S H   T E S T:                           " << endl
+         << "********************************************************************************" << endl;
+    cout << "Double Hash: Table Size = " << capacity << " : Insertions = " << items << endl;
+
+    //the even keys are inserted, so every odd key is known to be missing.
+    default_random_engine engine;
+    uniform_int_distribution<int> random(0, INT_MAX / 2 - 1);
+    vector<int> keys;
+    set<int> unique;
+    while(keys.size() < items)
+    {
+        int key = 2 * random(engine);
+        if(unique.insert(key).second)
+            keys.push_back(key);
+    }
+
+    DoubleHash<Record<int> > direct(capacity);
+    size_t directErrors = 0;
+    auto start = chrono::steady_clock::now();
+    for(size_t i = 0; i < items; i++)
+        if(!direct.insert(Record<int>(keys[i], keys[i] % 10000)))
+            directErrors++;
+    for(size_t i = 0; i < items; i++)
+        if(direct.is_present(keys[i] + int(i % 2)) != (i % 2 == 0))
+            directErrors++;
+    double directSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    size_t errors = 0, batches = 0;
+    start = chrono::steady_clock::now();
+    {
+        AsyncHash<Record<int> > async(capacity);
+        for(size_t i = 0; i < items; i++)
+            async.insert(Record<int>(keys[i], keys[i] % 10000), [&errors](bool ok, const Record<int>&)
+            {
+                if(!ok)
+                    errors++;
+            });
+        for(size_t i = 0; i < items; i++)
+        {
+            bool expected = (i % 2 == 0);
+            async.find(keys[i] + int(i % 2), [&errors, expected](bool found, const Record<int>& record)
+            {
+                if(found != expected || (found && record.data != record.key % 10000))
+                    errors++;
+            });
+        }
+        async.drain();
+        batches = async.batches();
+    }
+    double asyncSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Direct: " << directSeconds << " s, errors: " << directErrors << endl
+         << "Async: " << asyncSeconds << " s, " << batches << " batches of " << double(2 * items) / batches
+         << " operations on average, errors: " << errors << endl
+         << "------------------ END ASYNC HASH TEST ----------------------" << endl;
+}
+
+void testConcurrentResize(size_t readers, size_t items)
+{
+    cout << "********************************************************************************" << endl
+         << "              C O N C U R R E N T   R E S I Z E   T E S T:                      " << endl
+         << "********************************************************************************" << endl;
+    cout << "Concurrent Open Hash: Table Size = 17 : Insertions = " << items << " : Readers = " << readers << endl;
+
+    //key k holds k, keys below inserted are present unless k % 4 == 3, odd keys beyond are missing.
+    ConcurrentOpenHash<Record<int> > table(17);
+    atomic<size_t> inserted(0);
+    atomic<bool> done(false);
+    vector<size_t> reads(readers, 0), errors(readers, 0);
+    vector<double> longest(readers, 0);
+    vector<thread> threads;
+    auto start = chrono::steady_clock::now();
+    for(size_t r = 0; r < readers; r++)
+        threads.push_back(thread([&, r]()
+        {
+            unsigned seed = unsigned(r) * 7919 + 1;
+            while(!done.load(memory_order_relaxed))
+            {
+                seed = seed * 1103515245 + 12345;
+                size_t limit = inserted.load(memory_order_acquire);
+                int key = (limit && seed % 2) ? int((seed >> 8) % limit) : int(items + (seed >> 8) % items);
+                bool expected = (size_t(key) < limit && key % 4 != 3);
+
+                auto before = chrono::steady_clock::now();
+                bool found;
+                Record<int> result;
+                table.find(key, found, result);
+                double seconds = chrono::duration<double>(chrono::steady_clock::now() - before).count();
+                if(seconds > longest[r])
+                    longest[r] = seconds;
+
+                if((found && (!expected || result.data != key)) || (!found && expected))
+                    errors[r]++;
+                reads[r]++;
+            }
+        }));
+
+    for(size_t key = 0; key < items; key++)
+    {
+        table.insert(Record<int>(int(key), int(key)));
+        if(key % 4 == 3)
+            table.remove(int(key));
+        inserted.store(key + 1, memory_order_release);
+    }
+    done.store(true);
+    for(size_t r = 0; r < readers; r++)
+        threads[r].join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    size_t totalReads = 0, totalErrors = 0;
+    double slowest = 0;
+    for(size_t r = 0; r < readers; r++)
+    {
+        totalReads += reads[r];
+        totalErrors += errors[r];
+        if(longest[r] > slowest)
+            slowest = longest[r];
+    }
+
+    cout << "Records: " << table.size() << ", capacity: " << table.capacity() << ", resizes: " << table.resizes() << endl
+         << "Time: " << seconds << " s, reads during growth: " << totalReads << ", longest lookup: "
+         << 1e6 * slowest << " us" << endl
+         << "Reclaimed through epochs: " << table.epochs().freed() << ", waiting: " << table.epochs().pending() << endl
+         << "Errors: " << totalErrors << endl
+         << "------------------ END CONCURRENT RESIZE TEST ----------------------" << endl;
+}
+
+void testOrderStatistics(size_t items)
+{
+    cout << "********************************************************************************" << endl
+         << "                O R D E R   S T A T I S T I C S   T E S T:                      " << endl
+         << "********************************************************************************" << endl;
+    cout << "AVL and Chained Hash: Table Size = " << TABLE_SIZE << " : Insertions = " << items << endl;
+
+    const int MAX_KEY = int(items * 10);
+    mt19937 generator(29);
+    AVL<int> tree;
+    ChainedHash<Record<int> > chained(TABLE_SIZE);
+    set<int> expected;
+    size_t errors = 0;
+
+    for(size_t i = 0; i < items; i++)
+    {
+        int key = int(generator() % MAX_KEY);
+        bool inserted = expected.insert(key).second;
+        if(tree.insert(key) != inserted || chained.insert(Record<int>(key, key)) != inserted)
+            errors++;
+        if(i % 4 == 3)
+        {
+            //remove a key that is present, so every structure loses the same one.
+            set<int>::iterator it = expected.lower_bound(int(generator() % MAX_KEY));
+            int gone = (it == expected.end()) ? *expected.begin() : *it;
+            expected.erase(gone);
+            if(!tree.erase(gone) || !chained.remove(gone))
+                errors++;
+        }
+        if(i == items / 2)
+            chained.enable_sorted_index();
+    }
+    if(tree.size() != expected.size() || chained.size() != expected.size() || !tree.isBalanced())
+        errors++;
+
+    //rank and select of every key, and one past the end.
+    size_t k = 0;
+    for(set<int>::iterator it = expected.begin(); it != expected.end(); ++it, k++)
+    {
+        int selected;
+        if(tree.rank(*it) != k || !tree.select(k, selected) || selected != *it)
+            errors++;
+    }
+    int selected;
+    if(tree.select(expected.size(), selected))
+        errors++;
+
+    //count_range and range over random intervals, some empty or past the keys.
+    const size_t QUERIES = 2000;
+    for(size_t q = 0; q < QUERIES; q++)
+    {
+        int lo = int(generator() % (MAX_KEY + 100)) - 50;
+        int hi = lo + int(generator() % (q % 2 ? 100 : MAX_KEY / 4));
+        vector<int> want(expected.lower_bound(lo), expected.upper_bound(hi));
+
+        vector<int> fromTree;
+        tree.range(lo, hi, [&fromTree](const int& key) { fromTree.push_back(key); });
+        vector<int> fromTable;
+        chained.range(lo, hi, [&fromTable](const Record<int>& record) { fromTable.push_back(record.key); });
+
+        if(tree.count_range(lo, hi) != want.size() || chained.count_range(lo, hi) != want.size()
+           || fromTree != want || fromTable != want)
+            errors++;
+    }
+
+    cout << "Keys: " << expected.size() << ", rank/select checked: " << k << ", range queries: " << QUERIES << endl
+         << "Errors: " << errors << endl
+         << "------------------ END ORDER STATISTICS TEST ----------------------" << endl;
+}
+
+void testSetOperations(size_t items)
+{
+    cout << "********************************************************************************" << endl
+         << "                  S E T   O P E R A T I O N S   T E S T:                        " << endl
+         << "********************************************************************************" << endl;
+
+    const int MAX_KEY = int(items * 4);
+    mt19937 generator(30);
+    size_t errors = 0;
+
+    //three runs: similar sizes (linear merge), rhs 16x smaller (split / join), similar sizes on threads.
+    const char* names[] = {"Similar sizes, linear merge", "Right 16x smaller, split / join", "Similar sizes, split / join on 2 levels of threads"};
+    size_t rightSizes[] = {items, items / 16, items};
+    int depths[] = {0, 0, 2};
+    for(int run = 0; run < 3; run++)
+    {
+        AVL<int> left, right;
+        while(left.size() < items)
+            left.insert(int(generator() % MAX_KEY));
+        while(right.size() < rightSizes[run])
+            right.insert(int(generator() % MAX_KEY));
+
+        vector<int> a, b;
+        left.range(INT_MIN, INT_MAX, [&a](const int& key) { a.push_back(key); });
+        right.range(INT_MIN, INT_MAX, [&b](const int& key) { b.push_back(key); });
+
+        cout << names[run] << ": " << a.size() << " and " << b.size() << " keys" << endl;
+        for(int op = 0; op < 3; op++)
+        {
+            AVL<int> result(left);
+            vector<int> want;
+            auto start = chrono::steady_clock::now();
+            if(op == 0)
+                result.unite(right, depths[run]);
+            else if(op == 1)
+                result.intersect(right, depths[run]);
+            else
+                result.subtract(right, depths[run]);
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+            if(op == 0)
+                set_union(a.begin(), a.end(), b.begin(), b.end(), back_inserter(want));
+            else if(op == 1)
+                set_intersection(a.begin(), a.end(), b.begin(), b.end(), back_inserter(want));
+            else
+                set_difference(a.begin(), a.end(), b.begin(), b.end(), back_inserter(want));
+
+            vector<int> got;
+            result.range(INT_MIN, INT_MAX, [&got](const int& key) { got.push_back(key); });
+            bool correct = (got == want && result.size() == want.size() && result.isBalanced());
+            if(!correct)
+            {
+                cout << "Error: the " << ((op == 0) ? "union" : (op == 1) ? "intersection" : "difference")
+                     << " does not match the std algorithm." << endl;
+                errors++;
+            }
+            cout << "  " << ((op == 0) ? "unite    " : (op == 1) ? "intersect" : "subtract ") << ": "
+                 << seconds << " s, " << got.size() << " keys" << endl;
+        }
+
+        //the union one insert per node, as operator+= did before the set operations.
+        AVL<int> inserted(left);
+        auto start = chrono::steady_clock::now();
+        right.range(INT_MIN, INT_MAX, [&inserted](const int& key) { inserted.insert(key); });
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "  one insert per node: " << seconds << " s, " << inserted.size() << " keys" << endl;
+    }
+
+    cout << "Errors: " << errors << endl
+         << "------------------ END SET OPERATIONS TEST ----------------------" << endl;
+}
+
+template<typename Bucket>
+void testBucketPolicy(size_t capacity, size_t items, string str)
+{
+    string message = "Chained Hash (" + str + "): Table Size = " + to_string(capacity)
+            + " : Insertions = " + to_string(items);
+    ChainedHash<Record<int>, Bucket> randomTable(capacity);
+    testHashTableRandom(randomTable, items, message);
+
+    cout << "********************************************************************************" << endl
+         << "                  B U C K E T   P O L I C Y   T E S T:                          " << endl
+         << "********************************************************************************" << endl;
+    cout << message << endl;
+
+    //keys are distinct multiples of 2, odd keys are missing.
+    vector<int> keys(items);
+    for(size_t i = 0; i < items; i++)
+        keys[i] = int(2 * i);
+    shuffle(keys.begin(), keys.end(), mt19937(33));
+
+    ChainedHash<Record<int>, Bucket> table(capacity);
+    size_t errors = 0;
+    auto start = chrono::steady_clock::now();
+    for(size_t i = 0; i < items; i++)
+        if(!table.insert(Record<int>(keys[i], int(i))))
+            errors++;
+    double insertSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double poolBytes = double(table.pool_bytes()) / double(items);
+    double bucketBytes = double(sizeof(Bucket) * table.capacity()) / double(items);
+
+    start = chrono::steady_clock::now();
+    for(size_t i = 0; i < items; i++)
+        if(!table.is_present(keys[i]) || table.is_present(keys[i] + 1))
+            errors++;
+    double findSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    for(size_t i = 0; i < items; i++)
+        if(!table.remove(keys[i]))
+            errors++;
+    double removeSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if(table.size())
+        errors++;
+
+    cout << "Insert: " << insertSeconds << " s, find " << 2 * items << " keys: " << findSeconds
+         << " s, remove: " << removeSeconds << " s" << endl
+         << "Bytes per record: " << poolBytes << " in the pool, " << bucketBytes << " in the buckets ("
+         << sizeof(Bucket) << " bytes per bucket)" << endl
+         << "Errors: " << errors << endl
+         << "------------------ END BUCKET POLICY TEST ----------------------" << endl;
+}
+
+void testCompactAVL(size_t items)
+{
+    cout << "********************************************************************************" << endl
+         << "                     C O M P A C T   A V L   T E S T:                           " << endl
+         << "********************************************************************************" << endl;
+    cout << "Compact AVL: Insertions = " << items << endl;
+
+    mt19937 generator(28);
+    const int MAX_KEY = int(items * 4);
+    CompactAVL<Record<int> > tree;
+    set<int> expected;
+    size_t errors = 0;
+    for(size_t i = 0; i < items; i++)
+    {
+        int key = int(generator() % MAX_KEY);
+        if(tree.insert(Record<int>(key, key)) != expected.insert(key).second)
+            errors++;
+        if(i % 3 == 2)
+        {
+            key = int(generator() % MAX_KEY);
+            if(tree.erase(Record<int>(key)) != (expected.erase(key) > 0))
+                errors++;
+        }
+    }
+
+    //the copy loses the even keys, the assigned tree gains new ones, the source must not change.
+    CompactAVL<Record<int> > copied(tree);
+    CompactAVL<Record<int> > assigned;
+    assigned.insert(Record<int>(-1));
+    assigned = tree;
+    set<int> copiedExpected(expected), assignedExpected(expected);
+    for(set<int>::iterator it = expected.begin(); it != expected.end(); ++it)
+        if(*it % 2 == 0)
+        {
+            copied.erase(Record<int>(*it));
+            copiedExpected.erase(*it);
+        }
+    for(int key = MAX_KEY; key < MAX_KEY + int(items / 10); key++)
+    {
+        assigned.insert(Record<int>(key, key));
+        assignedExpected.insert(key);
+    }
+
+    CompactAVL<Record<int> >* trees[] = {&tree, &copied, &assigned};
+    set<int>* contents[] = {&expected, &copiedExpected, &assignedExpected};
+    for(int t = 0; t < 3; t++)
+    {
+        if(trees[t]->size() != contents[t]->size() || !trees[t]->isBalanced())
+            errors++;
+        for(int key = -1; key < MAX_KEY + int(items / 10); key++)
+        {
+            Record<int>* found;
+            bool present = trees[t]->search(Record<int>(key), found);
+            if(present != (contents[t]->count(key) > 0) || (present && found->data != key))
+                errors++;
+        }
+    }
+
+    cout << "Records: " << tree.size() << ", copy: " << copied.size() << ", assigned: " << assigned.size() << endl
+         << "Errors: " << errors << endl
+         << "------------------ END COMPACT AVL TEST ----------------------" << endl;
+}
+
+void testFrozen(size_t capacity, size_t items)
+{
+    cout << "********************************************************************************" << endl
+         << "                         F R O Z E N   T E S T:                                 " << endl
+         << "********************************************************************************" << endl;
+    cout << "Frozen AVL and Chained Hash: Table Size = " << capacity << " : Insertions = " << items << endl;
+
+    //keys are distinct multiples of 2, odd keys are missing.
+    vector<int> keys(items);
+    for(size_t i = 0; i < items; i++)
+        keys[i] = int(2 * i);
+    shuffle(keys.begin(), keys.end(), mt19937(34));
+
+    AVL<int> tree;
+    ChainedHash<Record<int> > table(capacity);
+    for(size_t i = 0; i < items; i++)
+    {
+        tree.insert(keys[i]);
+        table.insert(Record<int>(keys[i], keys[i]));
+    }
+    FrozenTree<int> frozenTree = tree.freeze();
+    ChainedHash<Record<int>, FrozenBucket<Record<int> > > frozenTable = table.freeze();
+
+    size_t errors = 0;
+    if(frozenTree.size() != items || frozenTable.size() != items)
+        errors++;
+    if(frozenTable.insert(Record<int>(-1)) || frozenTable.remove(keys[0]))
+        errors++;
+
+    //every key and its missing neighbour, one at a time.
+    for(size_t i = 0; i < items; i++)
+    {
+        const int* item = frozenTree.search(keys[i]);
+        if(item == nullptr || *item != keys[i] || frozenTree.search(keys[i] + 1) != nullptr)
+            errors++;
+        bool found;
+        Record<int> result;
+        frozenTable.find(keys[i], found, result);
+        if(!found || result.data != keys[i] || frozenTable.is_present(keys[i] + 1))
+            errors++;
+    }
+
+    //the same keys in one batch.
+    vector<int> batch(2 * items);
+    for(size_t i = 0; i < items; i++)
+    {
+        batch[2 * i] = keys[i];
+        batch[2 * i + 1] = keys[i] + 1;
+    }
+    bool* present = new bool[2 * items];
+    frozenTable.is_present(batch.data(), batch.size(), present);
+    for(size_t i = 0; i < batch.size(); i++)
+        if(present[i] != (i % 2 == 0))
+            errors++;
+
+    //time the same lookups in the source and in the frozen copy.
+    size_t hits = 0;
+    auto start = chrono::steady_clock::now();
+    for(size_t i = 0; i < items; i++)
+    {
+        tree_node<int>* node;
+        hits += tree.search(keys[i], node);
+        hits += tree.search(keys[i] + 1, node);
+    }
+    double treeSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    for(size_t i = 0; i < items; i++)
+    {
+        hits += frozenTree.search(keys[i]) != nullptr;
+        hits += frozenTree.search(keys[i] + 1) != nullptr;
+    }
+    double frozenTreeSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    table.is_present(batch.data(), batch.size(), present);
+    for(size_t i = 0; i < batch.size(); i++)
+        hits += present[i];
+    double tableSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    frozenTable.is_present(batch.data(), batch.size(), present);
+    for(size_t i = 0; i < batch.size(); i++)
+        hits += present[i];
+    double frozenTableSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    delete [] present;
+
+    if(hits != 4 * items)
+        errors++;
+
+    cout << "AVL: " << treeSeconds << " s, frozen AVL: " << frozenTreeSeconds << " s" << endl
+         << "Chained hash: " << tableSeconds << " s, frozen chained hash: " << frozenTableSeconds << " s" << endl
+         << "Errors: " << errors << endl
+         << "------------------ END FROZEN TEST ----------------------" << endl;
+}
+
+void testPersistentAVL(size_t readers, size_t operations)
+{
+    const int MAX_KEY = 10000;
+
+    cout << "********************************************************************************" << endl
+         << "                 P E R S I S T E N T   A V L   T E S T:                         " << endl
+         << "********************************************************************************" << endl;
+    cout << "1 writer, " << readers << " readers, " << operations << " writes." << endl;
+
+    PersistentAVL<int> tree;
+    set<int> expected;
+    atomic<bool> done(false);
+    atomic<bool> failed(false);
+    atomic<size_t> snapshots(0);
+
+    thread writer([&]()
+    {
+        mt19937 generator(35);
+        for(size_t i = 0; i < operations; i++)
+        {
+            int key = int(generator() % MAX_KEY);
+            if(generator() % 3 == 0)
+            {
+                if(tree.erase(key) != (expected.erase(key) > 0))
+                    failed = true;
+            }
+            else if(tree.insert(key) != expected.insert(key).second)
+                failed = true;
+        }
+        done = true;
+    });
+
+    vector<thread> workers;
+    for(size_t t = 0; t < readers; t++)
+    {
+        workers.push_back(thread([&]()
+        {
+            //each snapshot is held until the next one is taken, then read again.
+            PersistentAVL<int>::Snapshot held;
+            vector<int> heldItems;
+            while(!done)
+            {
+                PersistentAVL<int>::Snapshot snapshot = tree.snapshot();
+                vector<int> items;
+                snapshot.range(INT_MIN, INT_MAX, [&](const int& item){ items.push_back(item); });
+                if(items.size() != snapshot.size() || adjacent_find(items.begin(), items.end(),
+                        [](int a, int b){ return a >= b; }) != items.end())
+                    failed = true;
+
+                vector<int> again;
+                held.range(INT_MIN, INT_MAX, [&](const int& item){ again.push_back(item); });
+                if(again != heldItems || held.size() != heldItems.size())
+                    failed = true;
+
+                held = snapshot;
+                heldItems.swap(items);
+                snapshots++;
+            }
+            for(size_t i = 0; i < heldItems.size(); i++)
+                if(held.search(heldItems[i]) == nullptr)
+                    failed = true;
+        }));
+    }
+    writer.join();
+    for(size_t t = 0; t < readers; t++)
+        workers[t].join();
+
+    vector<int> last;
+    tree.snapshot().range(INT_MIN, INT_MAX, [&](const int& item){ last.push_back(item); });
+    if(failed || last.size() != expected.size() || !equal(last.begin(), last.end(), expected.begin()))
+        cout << "Error: a snapshot of the persistent avl was not consistent." << endl;
+    else
+        cout << "SNAPSHOTS: VERIFIED. SNAPSHOTS: " << snapshots << ", RECORDS: " << last.size() << endl;
+    cout << "------------------ END PERSISTENT TEST ----------------------" << endl;
+}
+
+void testTwoChoices(size_t capacity)
+{
+    cout << "********************************************************************************" << endl
+         << "                    T W O   C H O I C E S   T E S T:                            " << endl
+         << "********************************************************************************" << endl;
+    cout << "Chained Hash: Table Size = " << capacity << " : Insertions = " << capacity << endl;
+
+    mt19937 generator(38);
+    set<int> keys;
+    while(keys.size() < capacity)
+        keys.insert(int(generator() & INT_MAX));
+
+    size_t errors = 0;
+    for(int choices = 1; choices <= 2; choices++)
+    {
+        ChainedHash<Record<int> > table(capacity, choices == 2);
+        for(set<int>::iterator it = keys.begin(); it != keys.end(); ++it)
+            if(!table.insert(Record<int>(*it, *it)))
+                errors++;
+        if(table.size() != capacity || table.two_choices() != (choices == 2))
+            errors++;
+        size_t longest = table.longest_bucket();
+
+        for(set<int>::iterator it = keys.begin(); it != keys.end(); ++it)
+        {
+            bool found;
+            Record<int> result;
+            table.find(*it, found, result);
+            if(!found || result.data != *it || (keys.count(*it + 1) == 0 && table.is_present(*it + 1)))
+                errors++;
+        }
+        for(set<int>::iterator it = keys.begin(); it != keys.end(); ++it)
+            if(!table.remove(*it) || table.is_present(*it))
+                errors++;
+        if(table.size() != 0)
+            errors++;
+
+        cout << ((choices == 1) ? "One choice : " : "Two choices: ") << "deepest bucket = " << longest << endl;
+    }
+    cout << "Errors: " << errors << endl
+         << "------------------ END TWO CHOICES TEST ----------------------" << endl;
+}
+
+void testLinearHashing(size_t capacity, size_t items, double maxLoad, bool twoChoices)
+{
+    cout << "********************************************************************************" << endl
+         << "                 L I N E A R   H A S H I N G   T E S T:                         " << endl
+         << "********************************************************************************" << endl;
+    cout << "Chained Hash (" << ((twoChoices) ? "two choices" : "one choice") << "): Table Size = " << capacity
+         << " : Insertions = " << items << " : Max load = " << maxLoad << endl;
+
+    mt19937 generator(40);
+    ChainedHash<Record<int> > table(capacity, twoChoices);
+    table.enable_linear_hashing(maxLoad);
+    set<int> expected;
+    vector<int> inserted;
+    size_t errors = 0;
+    size_t report = 10;
+    cout << "Buckets:";
+    for(size_t i = 1; i <= items; i++)
+    {
+        size_t before = table.capacity();
+        int key = int(generator() & INT_MAX);
+        if(table.insert(Record<int>(key, key)) != expected.insert(key).second)
+            errors++;
+        inserted.push_back(key);
+        if(table.capacity() > before + 1 || table.size() > maxLoad * table.capacity())
+            errors++;
+
+        if(i % 4 == 0)
+        {
+            key = inserted[generator() % inserted.size()];
+            if(table.remove(key) != (expected.erase(key) > 0))
+                errors++;
+        }
+        if(i == report)
+        {
+            cout << " " << table.capacity() << " (" << i << ")";
+            report *= 10;
+        }
+    }
+    cout << endl;
+
+    if(table.size() != expected.size())
+        errors++;
+    for(size_t i = 0; i < inserted.size(); i++)
+    {
+        bool found;
+        Record<int> result;
+        table.find(inserted[i], found, result);
+        if(found != (expected.count(inserted[i]) > 0) || (found && result.data != inserted[i]))
+            errors++;
+    }
+
+    cout << "Records: " << table.size() << ", buckets: " << table.capacity()
+         << ", deepest bucket: " << table.longest_bucket() << endl
+         << "Errors: " << errors << endl
+         << "------------------ END LINEAR HASHING TEST ----------------------" << endl;
+}
+
+//preconditions: threads > 0.
+//postconditions: the ConcurrentAVL is stress tested, then both trees are timed on the same workload.
+void testConcurrentAVL(size_t threads, size_t operations)
+{
+    const int MAX_KEY = 100000;
+    size_t perThread = operations / threads;
+
+    cout << "********************************************************************************" << endl
+         << "                 C O N C U R R E N T   A V L   T E S T:                         " << endl
+         << "********************************************************************************" << endl;
+    cout << threads << " threads, " << perThread << " operations per thread." << endl;
+
+    //stress: thread t owns the keys equal to t modulo threads, so its own std::set is exact.
+    ConcurrentAVL<Record<int> > stress;
+    vector<set<int> > expected(threads);
+    vector<thread> workers;
+    atomic<bool> failed(false);
+    for(size_t t = 0; t < threads; t++)
+    {
+        workers.push_back(thread([&, t]()
+        {
+            unsigned seed = unsigned(t) * 7919 + 1;
+            for(size_t i = 0; i < perThread; i++)
+            {
+                seed = seed * 1103515245 + 12345;
+                int key = int(((seed >> 8) % (MAX_KEY / threads)) * threads + t);
+                Record<int> result;
+                switch((seed >> 4) % 3)
+                {
+                case 0:
+                    if(stress.insert(Record<int>(key, key)) != expected[t].insert(key).second)
+                        failed = true;
+                    break;
+                case 1:
+                    if(stress.erase(Record<int>(key)) != (expected[t].erase(key) > 0))
+                        failed = true;
+                    break;
+                default:
+                    if(stress.search(Record<int>(key), result) != (expected[t].count(key) > 0))
+                        failed = true;
+                }
+            }
+        }));
+    }
+    for(size_t t = 0; t < threads; t++)
+        workers[t].join();
+
+    size_t total = 0;
+    for(size_t t = 0; t < threads; t++)
+        total += expected[t].size();
+    if(failed || total != stress.size() || !stress.isBalanced())
+        cout << "Error: the concurrent avl does not match the expected contents." << endl;
+    else
+        cout << "STRESS TEST: VERIFIED. RECORDS: " << total << endl;
+
+    //throughput: 80% search, 10% insert, 10% erase over one shared key range.
+    ConcurrentAVL<int> concurrent;
+    AVL<int> locked;
+    mutex lock;
+    for(int key = 0; key < MAX_KEY; key += 2)
+    {
+        concurrent.insert(key);
+        locked.insert(key);
+    }
+
+    for(int run = 0; run < 2; run++)
+    {
+        auto start = chrono::steady_clock::now();
+        workers.clear();
+        for(size_t t = 0; t < threads; t++)
+        {
+            workers.push_back(thread([&, t]()
+            {
+                unsigned seed = unsigned(t) * 104729 + 7;
+                for(size_t i = 0; i < perThread; i++)
+                {
+                    seed = seed * 1103515245 + 12345;
+                    int key = int((seed >> 8) % MAX_KEY);
+                    unsigned op = (seed >> 4) % 10;
+                    if(run == 0)
+                    {
+                        int result;
+                        if(op == 0)
+                            concurrent.insert(key);
+                        else if(op == 1)
+                            concurrent.erase(key);
+                        else
+                            concurrent.search(key, result);
+                    }
+                    else
+                    {
+                        lock_guard<mutex> guard(lock);
+                        tree_node<int>* found_ptr;
+                        if(op == 0)
+                            locked.insert(key);
+                        else if(op == 1)
+                            locked.erase(key);
+                        else
+                            locked.search(key, found_ptr);
+                    }
+                }
+            }));
+        }
+        for(size_t t = 0; t < threads; t++)
+            workers[t].join();
+
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << ((run == 0) ? "ConcurrentAVL     : " : "AVL + one mutex   : ")
+             << size_t(perThread * threads / seconds) << " operations / second" << endl;
+    }
+    cout << "------------------ END CONCURRENT TEST ----------------------" << endl;
+}
+
 //preconditions: none
 //postconditions: a number between min and max is obtained from cin and returned.
 int getNumberInRange(int min, int max)
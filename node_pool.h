@@ -0,0 +1,145 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <cstdlib>
+#include <cassert>
+#include <new>
+
+using namespace std;
+
+//A slab allocator for fixed size nodes. Storage is carved out of slabs of
+// _slabSize nodes, freed nodes are kept on a free list and handed out again
+// before a new slab is requested. Every slab is released at once when the pool
+// is destroyed (or release() is called), destructors of live nodes are NOT run.
+template <typename N>
+class NodePool
+{
+public:
+    NodePool(size_t slabSize = 256);    //nodes per slab, no memory is reserved until the first allocate().
+    ~NodePool();                        //release every slab in bulk.
+
+    void* allocate();                   //returns uninitialized storage for one N.
+    void deallocate(void* node);        //return the storage of one N to the free list.
+    void release();                     //release every slab in bulk, all nodes become invalid.
+
+    //preconditions: none
+    //postconditions: returns the number of nodes currently handed out.
+    inline size_t live() const
+    {
+        return _live;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of bytes reserved by the slabs.
+    inline size_t reserved() const
+    {
+        return _slabs * (_slabSize + 1) * sizeof(slot);
+    }
+
+private:
+    //A free slot holds the link to the next free slot, an allocated slot holds an N.
+    union slot
+    {
+        slot* next;
+        alignas(N) unsigned char storage[sizeof(N)];
+    };
+
+    slot* _freeList;    //singly linked list of available slots.
+    slot* _slabList;    //singly linked list of slabs, the first slot of each slab is the link.
+    size_t _slabSize;
+    size_t _slabs;
+    size_t _live;
+
+    void grow();        //allocate a new slab and push its slots onto the free list.
+
+    //not copyable, nodes can not be shared between two pools.
+    NodePool(const NodePool<N>& other);
+    NodePool<N>& operator=(const NodePool<N>& other);
+};
+
+//preconditions: slabSize > 0
+//postconditions: constructs an empty pool, no slab is allocated yet.
+template <typename N>
+NodePool<N>::NodePool(size_t slabSize)
+{
+    assert(slabSize > 0);
+    _freeList = nullptr;
+    _slabList = nullptr;
+    _slabSize = slabSize;
+    _slabs = 0;
+    _live = 0;
+}
+
+//preconditions: none
+//postconditions: deallocate every slab.
+template <typename N>
+NodePool<N>::~NodePool()
+{
+    release();
+}
+
+//preconditions: none
+//postconditions: a free slot is popped from the free list (a new slab is allocated
+// when the free list is empty), the storage is returned uninitialized.
+template <typename N>
+void* NodePool<N>::allocate()
+{
+    if(!_freeList)
+        grow();
+
+    slot* s = _freeList;
+    _freeList = s->next;
+    _live++;
+    return s->storage;
+}
+
+//preconditions: node was returned by allocate() of this pool and its object was destroyed.
+//postconditions: the slot is pushed onto the free list.
+template <typename N>
+void NodePool<N>::deallocate(void* node)
+{
+    if(node)
+    {
+        slot* s = static_cast<slot*>(node);
+        s->next = _freeList;
+        _freeList = s;
+        _live--;
+    }
+}
+
+//preconditions: none
+//postconditions: every slab is deallocated, the pool is empty but still usable.
+template <typename N>
+void NodePool<N>::release()
+{
+    while(_slabList)
+    {
+        slot* next = _slabList->next;
+        delete [] _slabList;
+        _slabList = next;
+    }
+    _freeList = nullptr;
+    _slabs = 0;
+    _live = 0;
+}
+
+//preconditions: none
+//postconditions: a slab of _slabSize slots (plus one link slot) is allocated,
+// the slots are pushed onto the free list in address order so consecutive
+// allocations are adjacent in memory.
+template <typename N>
+void NodePool<N>::grow()
+{
+    slot* slab = new slot[_slabSize + 1];
+    slab[0].next = _slabList;
+    _slabList = slab;
+    _slabs++;
+
+    for(size_t i = _slabSize; i >= 1; i--)
+    {
+        slab[i].next = _freeList;
+        _freeList = &slab[i];
+    }
+}
+
+#endif // NODE_POOL_H
@@ -2,10 +2,17 @@
 #define OPENHASH_H
 
 #include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
 #include <iostream>
 #include <iomanip>
 #include <cassert>
 #include <record.h>
+#include "prefetch.h"
+#include "hash_functions.h"
+#include "timing_wheel.h"
+#include "perfecthash.h"
 
 using namespace std;
 
@@ -26,9 +33,15 @@ public:
     OpenHash(const OpenHash<T>& other);
 
     bool insert(const T& entry);                       //returns true if the record inserted, otherwise false.
+    bool insert(const T& entry, uint64_t expires);     //insert a record that expires at tick expires.
     bool remove(int key);                              //returns true if the record with the key was removed, otherwise false.
     bool is_present(int key) const;                    //returns true if the key exists, otherwise false.
+    void is_present(const int* keys, size_t count, bool* present) const;  //look up a batch of keys, interleaving their probes.
     void find(int key, bool& found, T& result) const;  //returns found = true, result = record with key if the key exists.
+    void enable_cache(size_t budget);                  //become a cache of budget records, evicting by CLOCK.
+    void advance(uint64_t now);                        //move the clock to tick now, expiring the records due.
+    size_t flatten(T* out) const;                      //copy the records that have not expired to out.
+    PerfectHash<T> freeze() const;                     //a read-only copy over a minimal perfect hash.
 
     //preconditions: none
     //postconditions: returns the current _size.
@@ -44,22 +57,175 @@ public:
         return _capacity;
     }
 
+    //preconditions: none
+    //postconditions: returns the first slot a lookup of the key probes, so operations can be
+    // ordered by the part of the table they touch.
+    inline size_t home(int key) const
+    {
+        return hash(key);
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of new keys the table accepts before an insert fails on
+    // a full table or, in a cache, evicts, so a caller knows when the order of inserts matters.
+    inline size_t room() const
+    {
+        size_t limit = _referenced ? _budget : _capacity;
+        return (_size < limit) ? limit - _size : 0;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of times flooding was detected and the table reseeded.
+    inline size_t reseeds() const
+    {
+        return _reseeds;
+    }
+
+    //preconditions: none
+    //postconditions: returns the current tick of the expiry clock.
+    inline uint64_t now() const
+    {
+        return _wheel.now();
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of records that expired and were removed.
+    inline size_t expirations() const
+    {
+        return _expirations;
+    }
+
+    //preconditions: none
+    //postconditions: returns true if the table is a cache.
+    inline bool is_cache() const
+    {
+        return _referenced != nullptr;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of lookups that found their key since the table became a cache.
+    inline size_t hits() const
+    {
+        return _hits;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of lookups that missed since the table became a cache.
+    inline size_t misses() const
+    {
+        return _misses;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of records the cache evicted to make room.
+    inline size_t evictions() const
+    {
+        return _evictions;
+    }
+
 private:
     static const int NEVER_USED = -1;
     static const int PREVIOUSLY_USED = -2;
+    static const size_t MIGRATE_STEP = 16;     //slots of _old moved by every insert and remove.
+    static const uint64_t NEVER_EXPIRES = ~uint64_t(0);
+    static const size_t IN_FLIGHT = 16;        //lookups of a batch whose probes are interleaved.
 
     size_t _capacity;
     T *_data;
-    size_t _size;
-
-    void find_index(int key, bool &found, size_t &index) const;
+    size_t _size;               //records in _data and _old.
+    table_hash _hash;           //the hash of _data.
+
+    T *_old;                    //the array being rehashed after a reseed, null otherwise.
+    table_hash _oldHash;        //the hash of _old.
+    size_t _migrated;           //slots of _old already moved to _data.
+    size_t _reseeds;
+    size_t _tombstones;         //PREVIOUSLY_USED slots of _data, the table is rebuilt past a quarter of _capacity.
+
+    uint64_t *_referenced;      //the CLOCK reference bit of every slot of _data in a cache, null otherwise.
+    uint64_t *_oldReferenced;   //the reference bits of _old while a cache is rehashing.
+    size_t _budget;             //the most records a cache holds.
+    size_t _hand;               //the next slot of _data the CLOCK hand examines.
+    size_t _stride;             //the step of the hand, coprime to _capacity.
+    size_t _oldHand;            //the slots of _old below it have not been examined for eviction.
+    mutable size_t _hits;
+    mutable size_t _misses;
+    size_t _evictions;
+
+    uint64_t *_expiry;          //the expiry tick of every slot of _data once a record has one, null otherwise.
+    uint64_t *_oldExpiry;       //the expiry ticks of _old while rehashing.
+    TimingWheel _wheel;         //a timer for every record with an expiry.
+    size_t _expirations;
+
+    void find_index(const T* data, const table_hash& h, int key, bool &found, size_t &index) const;
     void copyArray(const T * copyFrom, T *& copyTo, const size_t & copyFromSize);
+    void copyState(const OpenHash<T>& other);
+    void find_slot(int key, bool& found, bool& inOld, size_t& index) const; //search _data, then _old.
+    bool finish_lookup(bool found, bool inOld, size_t index) const; //apply expiry and cache bookkeeping to a lookup.
+
+    //a lookup of a batch, waiting for the slot it prefetched.
+    struct in_flight
+    {
+        size_t _at;         //the position of the key in the batch.
+        size_t _index;      //the slot visited next.
+        size_t _count;      //slots visited in the array so far.
+        bool _inOld;        //probing _old after missing in _data.
+    };
+    void start_lookup(in_flight& l, int key, bool inOld) const;    //prefetch the first slot of the key.
+    bool visit(in_flight& l, int key, bool* present) const;        //one probe, returns true once the lookup is over.
+    size_t place(const T& entry, size_t& probes);   //store a record that is not present, returns its slot.
+    void erase_slot(bool inOld, size_t index);      //flag a slot of _data or _old PREVIOUSLY_USED.
+    void reseed();                          //switch to a new seeded hash and start rehashing.
+    void rehash(const table_hash& h);       //start moving the records to a new array hashed by h.
+    void evict();                           //remove the record chosen by CLOCK.
+    void allocate_expiry();                 //give every slot an expiry tick, NEVER_EXPIRES.
+    void expire(int key, uint64_t expires); //remove the record if its expiry is still expires.
+
+    //preconditions: index holds a record of _old if inOld, otherwise of _data.
+    //postconditions: returns true if the record has an expiry and the clock has reached it.
+    inline bool expired(bool inOld, size_t index) const
+    {
+        const uint64_t* expiry = (inOld) ? _oldExpiry : _expiry;
+        return expiry && expiry[index] <= _wheel.now();
+    }
+    void migrate_step();                    //move the next MIGRATE_STEP slots of _old.
+
+    //preconditions: none
+    //postconditions: applies the first hash function of h to the key, key % _capacity
+    // until the table is seeded.
+    inline size_t hash(const table_hash& h, int key) const
+    {
+        return (h.seeded()) ? hash_reduce(uint32_t(h.keyed(key)), _capacity) : (key % _capacity);
+    }
 
     //preconditions: none
-    //postconditions: applies the first hash function to the key.
+    //postconditions: returns the number of 64 bit words holding one reference bit per slot.
+    inline size_t reference_words() const
+    {
+        return (_capacity + 63) / 64;
+    }
+
+    //preconditions: index < _capacity
+    //postconditions: returns the reference bit of slot index.
+    inline static bool referenced(const uint64_t* bits, size_t index)
+    {
+        return (bits[index / 64] >> (index % 64)) & 1;
+    }
+
+    //preconditions: index < _capacity
+    //postconditions: the reference bit of slot index is set to value.
+    inline static void reference(uint64_t* bits, size_t index, bool value)
+    {
+        if(value)
+            bits[index / 64] |= uint64_t(1) << (index % 64);
+        else
+            bits[index / 64] &= ~(uint64_t(1) << (index % 64));
+    }
+
+    //preconditions: none
+    //postconditions: applies the current hash function to the key.
     inline size_t hash(int key) const
     {
-        return (key % _capacity);
+        return hash(_hash, key);
     }
 
     //preconditions: index must be in range.
@@ -122,6 +288,16 @@ ostream& operator<<(ostream& outs, const OpenHash<TT>& table)
         cout << endl;
     }
 
+    //records still waiting in the array being rehashed.
+    if(table._old)
+    {
+        outs << "rehashing:" << endl;
+        for(size_t i = table._migrated; i < table._capacity; i++)
+            if(table._old[i].key != table.NEVER_USED && table._old[i].key != table.PREVIOUSLY_USED)
+                outs << setfill('0') << setw(5) << table._old[i].key << ":"
+                     << setfill('0') << setw(4) << table._old[i].data << endl;
+    }
+
     return outs;
 }
 
@@ -134,6 +310,22 @@ OpenHash<T>::OpenHash()
     _size = 0;
     _capacity = 811;
     _data = new T[_capacity];
+    _old = nullptr;
+    _migrated = 0;
+    _reseeds = 0;
+    _tombstones = 0;
+    _referenced = nullptr;
+    _oldReferenced = nullptr;
+    _budget = _capacity;
+    _hand = 0;
+    _stride = 1;
+    _oldHand = 0;
+    _hits = 0;
+    _misses = 0;
+    _evictions = 0;
+    _expiry = nullptr;
+    _oldExpiry = nullptr;
+    _expirations = 0;
 
     for(size_t i = 0; i < _capacity; i++)
         _data[i].key = NEVER_USED;
@@ -148,6 +340,22 @@ OpenHash<T>::OpenHash(size_t maxCapacity)
     _size = 0;
     _capacity = maxCapacity;
     _data = new T[_capacity];
+    _old = nullptr;
+    _migrated = 0;
+    _reseeds = 0;
+    _tombstones = 0;
+    _referenced = nullptr;
+    _oldReferenced = nullptr;
+    _budget = _capacity;
+    _hand = 0;
+    _stride = 1;
+    _oldHand = 0;
+    _hits = 0;
+    _misses = 0;
+    _evictions = 0;
+    _expiry = nullptr;
+    _oldExpiry = nullptr;
+    _expirations = 0;
 
     for(size_t i = 0; i < _capacity; i++)
         _data[i].key = NEVER_USED;
@@ -159,6 +367,11 @@ template<typename T>
 OpenHash<T>::~OpenHash()
 {
     delete [] _data;
+    delete [] _old;
+    delete [] _referenced;
+    delete [] _oldReferenced;
+    delete [] _expiry;
+    delete [] _oldExpiry;
 }
 
 //preconditions: none
@@ -167,11 +380,17 @@ OpenHash<T>::~OpenHash()
 template<typename T>
 OpenHash<T>& OpenHash<T>::operator=(const OpenHash<T>& other)
 {
-    _capacity() = other._capacity;
-    _size = other._size;
+    if(&other == this)
+        return *this;
+
     delete [] _data;
-    _data = new T[_capacity];
-    copyArray(other._data,_data,_capacity);
+    delete [] _old;
+    delete [] _referenced;
+    delete [] _oldReferenced;
+    delete [] _expiry;
+    delete [] _oldExpiry;
+    copyState(other);
+    return *this;
 }
 
 //preconditions: none
@@ -179,10 +398,7 @@ OpenHash<T>& OpenHash<T>::operator=(const OpenHash<T>& other)
 template<typename T>
 OpenHash<T>::OpenHash(const OpenHash& other)
 {
-    _capacity = other.capacity;
-    _size = other._size;
-    _data = new T[_capacity];
-    copyArray(other._data,_data,_capacity);
+    copyState(other);
 }
 
 //preconditions: copyFrom and copyTo must be initialized.
@@ -195,27 +411,118 @@ void OpenHash<T>::copyArray(const T * copyFrom, T *& copyTo, const size_t & copy
         copyTo[i] = copyFrom[i];
 }
 
+//preconditions: _data and _old are not allocated.
+//postconditions: the arrays, hashes and rehashing progress of other are copied.
+template<typename T>
+void OpenHash<T>::copyState(const OpenHash<T>& other)
+{
+    _capacity = other._capacity;
+    _size = other._size;
+    _hash = other._hash;
+    _data = new T[_capacity];
+    copyArray(other._data,_data,_capacity);
+
+    _oldHash = other._oldHash;
+    _migrated = other._migrated;
+    _reseeds = other._reseeds;
+    _old = nullptr;
+    if(other._old)
+    {
+        _old = new T[_capacity];
+        copyArray(other._old,_old,_capacity);
+    }
+
+    _tombstones = other._tombstones;
+    _budget = other._budget;
+    _hand = other._hand;
+    _stride = other._stride;
+    _oldHand = other._oldHand;
+    _hits = other._hits;
+    _misses = other._misses;
+    _evictions = other._evictions;
+    _referenced = nullptr;
+    _oldReferenced = nullptr;
+    if(other._referenced)
+    {
+        _referenced = new uint64_t[reference_words()];
+        memcpy(_referenced, other._referenced, reference_words() * sizeof(uint64_t));
+    }
+    if(other._oldReferenced)
+    {
+        _oldReferenced = new uint64_t[reference_words()];
+        memcpy(_oldReferenced, other._oldReferenced, reference_words() * sizeof(uint64_t));
+    }
+
+    _wheel = other._wheel;
+    _expirations = other._expirations;
+    _expiry = nullptr;
+    _oldExpiry = nullptr;
+    if(other._expiry)
+    {
+        _expiry = new uint64_t[_capacity];
+        memcpy(_expiry, other._expiry, _capacity * sizeof(uint64_t));
+    }
+    if(other._oldExpiry)
+    {
+        _oldExpiry = new uint64_t[_capacity];
+        memcpy(_oldExpiry, other._oldExpiry, _capacity * sizeof(uint64_t));
+    }
+}
+
 //preconditions: none
 //postconditions: the entry will be inserted into the table at the hash of its key,
 // if that position is already taken, the second hash function will be applied
 // to the key until an index is found that is available. If the entry was inserted return true,
 // otherwise if an entry with the same key already exists in the table, or the table is full, return false.
+// An insert whose probe sequence is far longer than the load explains reseeds the table.
+// A cache at its budget evicts a record first, so the insert of a new key never fails.
 template<typename T>
 bool OpenHash<T>::insert(const T &entry)
 {
-    bool alreadyPresent = false;
-    T tempItem;
-    find(entry.key, alreadyPresent, tempItem); //ensure the entry is not already in the hashtable
+    return insert(entry, NEVER_EXPIRES);
+}
+
+//preconditions: none
+//postconditions: inserts the entry as above, it expires once the clock reaches the tick expires:
+// lookups stop finding it and the timing wheel removes it. An expired record with the same key
+// is replaced.
+template<typename T>
+bool OpenHash<T>::insert(const T &entry, uint64_t expires)
+{
+    migrate_step();
+
+    bool alreadyPresent, inOld;
     size_t index;
+    find_slot(entry.key, alreadyPresent, inOld, index); //ensure the entry is not already in the hashtable
 
-    if(!alreadyPresent && _size < _capacity)
+    if(alreadyPresent && expired(inOld, index))
     {
-        index = hash(entry.key);
-        while (!is_vacant(index))
-            index = next_index(index);
+        erase_slot(inOld, index);
+        _expirations++;
+        alreadyPresent = false;
+    }
 
-        _data[index] = entry;
+    if(!alreadyPresent && _referenced && _size >= _budget)
+        evict();
+
+    if(!alreadyPresent && _size < _capacity)
+    {
+        size_t probes;
+        index = place(entry, probes);
         _size++;
+        if(_referenced)
+            reference(_referenced, index, true);
+        if(expires != NEVER_EXPIRES && !_expiry)
+            allocate_expiry();
+        if(_expiry)
+            _expiry[index] = expires;
+        if(expires != NEVER_EXPIRES)
+            _wheel.schedule(entry.key, expires);
+
+        if(!_old && probe_flooded(probes, _size, _capacity))
+            reseed();
+        else if(!_old && _tombstones > _capacity / 4)
+            rehash(_hash);
         return true;
     }
     else
@@ -231,16 +538,25 @@ template<typename T>
 bool OpenHash<T>::remove(int key)
 {
     assert(key >= 0);
+    migrate_step();
 
-    bool found;
+    bool found, inOld;
     size_t index;
+    find_slot(key, found, inOld, index);
 
-    find_index(key, found, index);
+    if(found && expired(inOld, index))
+    {
+        //it was already gone for lookups, its slot is reclaimed now.
+        erase_slot(inOld, index);
+        _expirations++;
+        found = false;
+    }
 
     if(found)
     {
-        _data[index].key = PREVIOUSLY_USED;
-        --_size;
+        erase_slot(inOld, index);
+        if(!_old && _tombstones > _capacity / 4)
+            rehash(_hash);
         return true;
     }
     else
@@ -250,22 +566,313 @@ bool OpenHash<T>::remove(int key)
 }
 
 //preconditions: key must be a non-negative integer.
-//postconditions: the index of the item with the recieved key is located
-// using next_index to apply the second hash if the item is not stored at its first hash.
+//postconditions: the index of the item with the recieved key in data, which is hashed by h,
+// is located using next_index to apply the second hash if the item is not stored at its first hash.
 // return true if the item was found along with the index, otherwise return false.
 template<typename T>
-void OpenHash<T>::find_index(int key, bool &found, size_t &index) const
+void OpenHash<T>::find_index(const T* data, const table_hash& h, int key, bool &found, size_t &index) const
 {
     assert(key >= 0);
     size_t count = 0;
-    index = hash(key);
+    index = hash(h, key);
 
-    while(count < _capacity && !never_used(index) && _data[index].key != key)
+    while(count < _capacity && data[index].key != NEVER_USED && data[index].key != key)
     {
         ++count;
         index = next_index(index);
     }
-    found = (_data[index].key == key);
+    found = (data[index].key == key);
+}
+
+//preconditions: key must be a non-negative integer.
+//postconditions: searches _data and then the array being rehashed, returns found = true,
+// the array holding the record (inOld) and its index by ref if the key exists.
+template<typename T>
+void OpenHash<T>::find_slot(int key, bool& found, bool& inOld, size_t& index) const
+{
+    find_index(_data, _hash, key, found, index);
+    inOld = false;
+    if(!found && _old)
+    {
+        find_index(_old, _oldHash, key, found, index);
+        inOld = found;
+    }
+}
+
+//preconditions: the key of entry is not in the table, _data has a vacant slot.
+//postconditions: the entry is stored in the first vacant slot of its probe sequence in _data,
+// returns its slot and the number of occupied slots that were stepped over by ref.
+template<typename T>
+size_t OpenHash<T>::place(const T& entry, size_t& probes)
+{
+    probes = 0;
+    size_t index = hash(entry.key);
+    while (!is_vacant(index))
+    {
+        index = next_index(index);
+        ++probes;
+    }
+
+    if(previously_used(index))
+        _tombstones--;
+    _data[index] = entry;
+    return index;
+}
+
+//preconditions: index holds a record of _old if inOld, otherwise of _data.
+//postconditions: the record is flagged PREVIOUSLY_USED so the probe sequences through it stay
+// intact, a flag left in _data is counted toward rebuilding the table.
+template<typename T>
+void OpenHash<T>::erase_slot(bool inOld, size_t index)
+{
+    if(inOld)
+        _old[index].key = PREVIOUSLY_USED;
+    else
+    {
+        _data[index].key = PREVIOUSLY_USED;
+        _tombstones++;
+    }
+    --_size;
+}
+
+//preconditions: the table is not rehashing.
+//postconditions: the table is rehashed with a fresh random seed.
+template<typename T>
+void OpenHash<T>::reseed()
+{
+    rehash(table_hash::random());
+    _reseeds++;
+}
+
+//preconditions: the table is not rehashing.
+//postconditions: _data becomes _old and a new empty _data is hashed by h, which also drops
+// every PREVIOUSLY_USED flag when h is the current hash. The records move over a few slots at
+// a time in migrate_step, lookups search both arrays until then, so no single operation pays
+// for the whole rehash. The reference bits and expiry ticks move along with the records.
+template<typename T>
+void OpenHash<T>::rehash(const table_hash& h)
+{
+    assert(!_old);
+    _old = _data;
+    _oldHash = _hash;
+    _migrated = 0;
+
+    _data = new T[_capacity];
+    for(size_t i = 0; i < _capacity; i++)
+        _data[i].key = NEVER_USED;
+    _hash = h;
+    _tombstones = 0;
+
+    if(_referenced)
+    {
+        _oldReferenced = _referenced;
+        _referenced = new uint64_t[reference_words()];
+        memset(_referenced, 0, reference_words() * sizeof(uint64_t));
+        _oldHand = _capacity;
+    }
+
+    if(_expiry)
+    {
+        _oldExpiry = _expiry;
+        _expiry = nullptr;
+        allocate_expiry();
+    }
+}
+
+//preconditions: none
+//postconditions: the next MIGRATE_STEP slots of _old are moved into _data and left as
+// PREVIOUSLY_USED so the probe sequences of the records behind them stay intact.
+// _old is released once every slot has been moved.
+template<typename T>
+void OpenHash<T>::migrate_step()
+{
+    if(!_old)
+        return;
+
+    for(size_t i = 0; i < MIGRATE_STEP && _migrated < _capacity; i++, _migrated++)
+    {
+        T& slot = _old[_migrated];
+        if(slot.key != NEVER_USED && slot.key != PREVIOUSLY_USED)
+        {
+            size_t probes;
+            size_t index = place(slot, probes);
+            if(_referenced)
+                reference(_referenced, index, referenced(_oldReferenced, _migrated));
+            if(_expiry)
+                _expiry[index] = _oldExpiry[_migrated];
+            slot.key = PREVIOUSLY_USED;
+        }
+    }
+
+    if(_migrated == _capacity)
+    {
+        delete [] _old;
+        _old = nullptr;
+        delete [] _oldReferenced;
+        _oldReferenced = nullptr;
+        delete [] _oldExpiry;
+        _oldExpiry = nullptr;
+    }
+}
+
+//preconditions: 0 < budget <= _capacity
+//postconditions: the table becomes a cache holding at most budget records. The memory stays
+// fixed: one reference bit per slot beside the records, no allocation per record. A lookup that
+// finds a record sets its bit, an insert over the budget evicts a record first. Records over a
+// smaller budget are evicted now.
+template<typename T>
+void OpenHash<T>::enable_cache(size_t budget)
+{
+    assert(budget > 0 && budget <= _capacity);
+    if(!_referenced)
+    {
+        _referenced = new uint64_t[reference_words()];
+        memset(_referenced, 0, reference_words() * sizeof(uint64_t));
+        if(_old)
+        {
+            _oldReferenced = new uint64_t[reference_words()];
+            memset(_oldReferenced, 0, reference_words() * sizeof(uint64_t));
+        }
+        _hand = 0;
+        _oldHand = _capacity;
+
+        //stepping to the next slot would evict in slot order, leaving the slots just ahead of
+        // the hand nearly full and their probe sequences long. A stride coprime to _capacity
+        // still visits every slot once per sweep, in an order unrelated to their position.
+        _stride = size_t(_capacity * 0.618) | 1;
+        while(gcd(_stride, _capacity) != 1)
+            _stride += 2;
+    }
+
+    _budget = budget;
+    while(_size > _budget)
+        evict();
+}
+
+//preconditions: the table is a cache, _size > 0
+//postconditions: one record is removed by CLOCK, a referenced record gets a second chance (its
+// bit is cleared) and the first record without the bit is evicted. While rehashing the records
+// still waiting in _old are swept first, from the top down so the sweep never meets migrate_step.
+template<typename T>
+void OpenHash<T>::evict()
+{
+    assert(_referenced && _size > 0);
+    while(true)
+    {
+        while(_old && _oldHand > _migrated)
+        {
+            size_t index = --_oldHand;
+            if(_old[index].key == NEVER_USED || _old[index].key == PREVIOUSLY_USED)
+                continue;
+            if(referenced(_oldReferenced, index))
+            {
+                reference(_oldReferenced, index, false);
+                continue;
+            }
+
+            erase_slot(true, index);
+            _evictions++;
+            return;
+        }
+
+        //two sweeps find a record in _data, unless every record still waits in _old.
+        for(size_t sweep = 0; sweep < 2 * _capacity; sweep++)
+        {
+            size_t index = _hand;
+            _hand = (_hand + _stride) % _capacity;
+            if(is_vacant(index))
+                continue;
+            if(referenced(_referenced, index))
+            {
+                reference(_referenced, index, false);
+                continue;
+            }
+
+            erase_slot(false, index);
+            _evictions++;
+            return;
+        }
+
+        //the records passed over in _old have lost their bits, sweep them again.
+        _oldHand = _capacity;
+    }
+}
+
+//preconditions: out has room for size() records.
+//postconditions: the records that have not expired are copied to out in slot order, from both
+// arrays while rehashing. Returns the number of records copied.
+template<typename T>
+size_t OpenHash<T>::flatten(T* out) const
+{
+    size_t count = 0;
+    for(size_t i = 0; i < _capacity; i++)
+    {
+        if(!is_vacant(i) && !expired(false, i))
+            out[count++] = _data[i];
+        if(_old && i >= _migrated && _old[i].key != NEVER_USED && _old[i].key != PREVIOUSLY_USED
+           && !expired(true, i))
+            out[count++] = _old[i];
+    }
+    return count;
+}
+
+//preconditions: the keys are non-negative.
+//postconditions: returns a read-only PerfectHash of the records flatten copies. Every lookup in
+// it reads one pilot and one slot.
+template<typename T>
+PerfectHash<T> OpenHash<T>::freeze() const
+{
+    T* records = new T[_size];
+    size_t count = flatten(records);
+    PerfectHash<T> frozen(records, count);
+    delete [] records;
+    return frozen;
+}
+
+//preconditions: now >= now()
+//postconditions: the clock moves to tick now and the timing wheel removes every record whose expiry
+// it passed, in O(1) amortized per tick and record instead of a scan of the table. Their slots
+// become PREVIOUSLY_USED, a table full of them is rebuilt.
+template<typename T>
+void OpenHash<T>::advance(uint64_t now)
+{
+    _wheel.advance(now, [this](int key, uint64_t expires) { expire(key, expires); });
+    if(!_old && _tombstones > _capacity / 4)
+        rehash(_hash);
+}
+
+//preconditions: _expiry is not allocated.
+//postconditions: _expiry holds NEVER_EXPIRES for every slot of _data, and _oldExpiry for every
+// slot of _old while rehashing.
+template<typename T>
+void OpenHash<T>::allocate_expiry()
+{
+    _expiry = new uint64_t[_capacity];
+    for(size_t i = 0; i < _capacity; i++)
+        _expiry[i] = NEVER_EXPIRES;
+
+    if(_old && !_oldExpiry)
+    {
+        _oldExpiry = new uint64_t[_capacity];
+        for(size_t i = 0; i < _capacity; i++)
+            _oldExpiry[i] = NEVER_EXPIRES;
+    }
+}
+
+//preconditions: the timer of the key came due at expires.
+//postconditions: the record is removed if it still expires at expires. A record that was removed,
+// or removed and inserted again, left its timer behind, the timer then changes nothing.
+template<typename T>
+void OpenHash<T>::expire(int key, uint64_t expires)
+{
+    bool found, inOld;
+    size_t index;
+    find_slot(key, found, inOld, index);
+    if(found && ((inOld) ? _oldExpiry : _expiry)[index] == expires)
+    {
+        erase_slot(inOld, index);
+        _expirations++;
+    }
 }
 
 //preconditions: none
@@ -275,22 +882,126 @@ template<typename T>
 bool OpenHash<T>::is_present(int key) const
 {
     bool found;
-    size_t index;
-    find_index(key,found,index);
+    T result;
+    find(key,found,result);
     return found;
 }
 
 //preconditions: none
 //postconditions: if the record with the recieved key exists in the table,
-// found will be true and the record will be returned by ref.
+// found will be true and the record will be returned by ref. While rehashing,
+// the array being rehashed is searched after the new one. An expired record is not found.
+// A cache marks the record referenced and counts the hit or miss.
 template<typename T>
 void OpenHash<T>::find(int key, bool& found, T& result) const
 {
+    bool inOld;
     size_t index;
-    find_index(key,found,index);
-
+    find_slot(key, found, inOld, index);
+    found = finish_lookup(found, inOld, index);
     if(found)
-        result = _data[index];
+        result = (inOld) ? _old[index] : _data[index];
+}
+
+//preconditions: keys are non-negative integers, present has room for count results.
+//postconditions: present[i] = is_present(keys[i]) for every key, with the same expiry and cache
+// bookkeeping. Up to IN_FLIGHT lookups are in flight at once: a visit reads the slot its lookup
+// prefetched on the previous round, then prefetches the next slot and yields to the next lookup,
+// so the cache misses of the batch overlap instead of being paid one probe after another.
+template<typename T>
+void OpenHash<T>::is_present(const int* keys, size_t count, bool* present) const
+{
+    in_flight flight[IN_FLIGHT];
+    size_t active = 0;
+    size_t next = 0;
+    while(active < IN_FLIGHT && next < count)
+    {
+        flight[active]._at = next;
+        start_lookup(flight[active++], keys[next++], false);
+    }
+
+    while(active > 0)
+        for(size_t i = 0; i < active; )
+        {
+            in_flight& l = flight[i];
+            if(!visit(l, keys[l._at], present))
+                i++;
+            else if(next < count)
+            {
+                l._at = next;
+                start_lookup(l, keys[next++], false);
+                i++;
+            }
+            else
+                l = flight[--active];   //the last lookup takes the place and is visited next.
+        }
+}
+
+//preconditions: found is the result of find_slot, inOld and index locate the record if found.
+//postconditions: returns found, or false if the record expired. A cache marks the record
+// referenced and counts the hit or miss.
+template<typename T>
+bool OpenHash<T>::finish_lookup(bool found, bool inOld, size_t index) const
+{
+    //an expired record stays in its slot until the wheel or an insert or remove of its key reclaims it.
+    if(found && expired(inOld, index))
+        found = false;
+
+    if(_referenced && found)
+    {
+        reference((inOld) ? _oldReferenced : _referenced, index, true);
+        _hits++;
+    }
+    else if(_referenced)
+        _misses++;
+    return found;
+}
+
+//preconditions: key must be a non-negative integer, _old is not null if inOld.
+//postconditions: the lookup is at the first slot of the key in _old if inOld, otherwise in
+// _data, and that slot is prefetched.
+template<typename T>
+void OpenHash<T>::start_lookup(in_flight& l, int key, bool inOld) const
+{
+    assert(key >= 0);
+    const table_hash& h = (inOld) ? _oldHash : _hash;
+    l._index = hash(h, key);
+    l._count = 0;
+    l._inOld = inOld;
+    PREFETCH((inOld) ? &_old[l._index] : &_data[l._index]);
+}
+
+//preconditions: the slot of the lookup was prefetched.
+//postconditions: the slot is compared with the key as in find_index. Returns true once the
+// lookup is over, with present[l._at] set as find would set found. Otherwise the lookup moves to
+// its next slot, or to _old after missing in _data, prefetches it and returns false.
+template<typename T>
+bool OpenHash<T>::visit(in_flight& l, int key, bool* present) const
+{
+    const T* data = (l._inOld) ? _old : _data;
+    int at = data[l._index].key;
+    if(at == key)
+    {
+        present[l._at] = finish_lookup(true, l._inOld, l._index);
+        return true;
+    }
+
+    if(at != NEVER_USED && l._count < _capacity)
+    {
+        ++l._count;
+        l._index = next_index(l._index);
+        PREFETCH(&data[l._index]);
+        return false;
+    }
+
+    if(!l._inOld && _old)
+    {
+        start_lookup(l, key, true);
+        return false;
+    }
+
+    present[l._at] = finish_lookup(false, false, 0);
+    return true;
 }
 
 #endif // OPENHASH_H
@@ -0,0 +1,378 @@
+#ifndef PARTITIONEDHASH_H
+#define PARTITIONEDHASH_H
+
+#include <cstdlib>
+#include <cstdint>
+#include <cassert>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <record.h>
+#include "hash_functions.h"
+#include "openhash.h"
+#include "spsc_queue.h"
+
+using namespace std;
+
+//A shared-nothing front end over one table per worker thread. A key belongs to the shard picked
+// by its mixed hash and only that shard's worker ever touches the shard's table, so the tables
+// need no locks. A fixed number of producer threads, numbered 0 to producers - 1, send requests:
+// every producer has its own SpscQueue to every shard and every shard one back to every
+// producer, so a queue has one writer and one reader and the hot path has no atomic
+// read-modify-write at all. Requests are gathered per shard into batches of BATCH and replies
+// come back in batches too. Every request carries a tag chosen by the producer, the reply to it
+// is handed to poll with the same tag. Each producer must poll until its requests are answered.
+template <typename T, typename Table = OpenHash<T> >
+class PartitionedHash
+{
+public:
+    static const int INSERT = 1;
+    static const int REMOVE = 2;
+    static const int FIND = 3;
+
+    //the answer to one request.
+    struct reply
+    {
+        uint64_t tag;       //the tag of the request.
+        int op;             //INSERT, REMOVE or FIND.
+        bool ok;            //the result of insert, remove or is_present.
+        T record;           //the record found by FIND.
+    };
+
+    PartitionedHash(size_t shards, size_t producers, size_t capacity); //start one worker per shard of capacity slots.
+    ~PartitionedHash();                                 //stop the workers, unanswered requests are dropped.
+
+    //the workers own the tables.
+    PartitionedHash(const PartitionedHash<T, Table>&) = delete;
+    PartitionedHash<T, Table>& operator=(const PartitionedHash<T, Table>&) = delete;
+
+    void insert(size_t producer, const T& entry, uint64_t tag);    //request an insert.
+    void remove(size_t producer, int key, uint64_t tag);            //request a remove.
+    void find(size_t producer, int key, uint64_t tag);              //request a find.
+    void flush(size_t producer);                                    //send the batches that are not full yet.
+    template <typename F>
+    size_t poll(size_t producer, F done);               //done(const reply&) every reply that arrived.
+    size_t size() const;                                //the records of every shard, once every request is answered.
+
+    //preconditions: producer < producers()
+    //postconditions: returns the number of requests of the producer that were not answered yet.
+    inline size_t outstanding(size_t producer) const
+    {
+        return _producers[producer]._outstanding;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of shards.
+    inline size_t shards() const
+    {
+        return _shardCount;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of producers.
+    inline size_t producers() const
+    {
+        return _producerCount;
+    }
+
+    //preconditions: none
+    //postconditions: returns the shard that owns the key.
+    inline size_t shard_of(int key) const
+    {
+        return size_t(hash_mix(key) >> 32) % _shardCount;
+    }
+
+private:
+    static const size_t BATCH = 32;     //requests sent to a shard at once.
+
+    struct request
+    {
+        uint64_t tag;
+        int op;
+        T record;           //only the key is used by REMOVE and FIND.
+    };
+
+    typedef SpscQueue<request> request_queue;
+    typedef SpscQueue<reply> reply_queue;
+
+    //the state of one producer, only touched by its own thread.
+    struct alignas(64) producer_state
+    {
+        vector<request>* _batches;  //the batch being gathered for every shard.
+        vector<reply> _ready;       //replies taken off the queues while waiting for room.
+        size_t _outstanding;
+    };
+
+    //a shard, only touched by its worker once the worker runs.
+    struct alignas(64) shard
+    {
+        Table _table;
+        vector<reply>* _outbox;     //replies waiting for room in the queue of every producer.
+        thread _worker;
+    };
+
+    size_t _shardCount;
+    size_t _producerCount;
+    shard* _shards;
+    producer_state* _producers;
+    request_queue* _requests;       //producer p to shard s is _requests[p * _shardCount + s].
+    reply_queue* _replies;          //shard s to producer p is _replies[s * _producerCount + p].
+    atomic<bool> _stop;
+
+    void submit(size_t producer, const request& r); //add a request to the batch of its shard.
+    void send(size_t producer, size_t s);           //push the batch of shard s, waiting for room.
+    void collect(size_t producer);                  //move the replies on the queues to _ready.
+    void work(size_t s);                            //the loop of the worker of shard s.
+    reply apply(Table& table, const request& r);    //run one request on the table.
+
+    //preconditions: producer < _producerCount, s < _shardCount
+    //postconditions: returns the queue from the producer to shard s.
+    inline request_queue& requests(size_t producer, size_t s) const
+    {
+        return _requests[producer * _shardCount + s];
+    }
+
+    //preconditions: s < _shardCount, producer < _producerCount
+    //postconditions: returns the queue from shard s back to the producer.
+    inline reply_queue& replies(size_t s, size_t producer) const
+    {
+        return _replies[s * _producerCount + producer];
+    }
+};
+
+//preconditions: shards > 0, producers > 0.
+//postconditions: every shard holds an empty table of capacity slots and runs its worker.
+template <typename T, typename Table>
+PartitionedHash<T, Table>::PartitionedHash(size_t shards, size_t producers, size_t capacity): _stop(false)
+{
+    assert(shards > 0 && producers > 0);
+    _shardCount = shards;
+    _producerCount = producers;
+    _requests = new request_queue[producers * shards];
+    _replies = new reply_queue[shards * producers];
+
+    _producers = new producer_state[producers];
+    for(size_t p = 0; p < producers; p++)
+    {
+        _producers[p]._batches = new vector<request>[shards];
+        _producers[p]._outstanding = 0;
+    }
+
+    _shards = new shard[shards];
+    for(size_t s = 0; s < shards; s++)
+    {
+        _shards[s]._table = Table(capacity);
+        _shards[s]._outbox = new vector<reply>[producers];
+    }
+    for(size_t s = 0; s < shards; s++)
+        _shards[s]._worker = thread(&PartitionedHash<T, Table>::work, this, s);
+}
+
+//preconditions: no producer is using the table.
+//postconditions: every worker stops once it has nothing left it can do, everything is released.
+template <typename T, typename Table>
+PartitionedHash<T, Table>::~PartitionedHash()
+{
+    _stop.store(true, memory_order_release);
+    for(size_t s = 0; s < _shardCount; s++)
+        _shards[s]._worker.join();
+
+    for(size_t s = 0; s < _shardCount; s++)
+        delete[] _shards[s]._outbox;
+    for(size_t p = 0; p < _producerCount; p++)
+        delete[] _producers[p]._batches;
+    delete[] _shards;
+    delete[] _producers;
+    delete[] _requests;
+    delete[] _replies;
+}
+
+//preconditions: producer < producers(), called only from the thread of the producer.
+//postconditions: the insert is added to the batch of the shard of the key, which is sent once full.
+template <typename T, typename Table>
+void PartitionedHash<T, Table>::insert(size_t producer, const T& entry, uint64_t tag)
+{
+    request r;
+    r.tag = tag;
+    r.op = INSERT;
+    r.record = entry;
+    submit(producer, r);
+}
+
+//preconditions: producer < producers(), called only from the thread of the producer,
+// key must be a non-negative integer.
+//postconditions: the remove is added to the batch of the shard of the key, which is sent once full.
+template <typename T, typename Table>
+void PartitionedHash<T, Table>::remove(size_t producer, int key, uint64_t tag)
+{
+    assert(key >= 0);
+    request r;
+    r.tag = tag;
+    r.op = REMOVE;
+    r.record.key = key;
+    submit(producer, r);
+}
+
+//preconditions: producer < producers(), called only from the thread of the producer.
+//postconditions: the find is added to the batch of the shard of the key, which is sent once full.
+template <typename T, typename Table>
+void PartitionedHash<T, Table>::find(size_t producer, int key, uint64_t tag)
+{
+    request r;
+    r.tag = tag;
+    r.op = FIND;
+    r.record.key = key;
+    submit(producer, r);
+}
+
+//preconditions: producer < producers(), called only from the thread of the producer.
+//postconditions: every batch of the producer is sent, even if it is not full.
+template <typename T, typename Table>
+void PartitionedHash<T, Table>::flush(size_t producer)
+{
+    for(size_t s = 0; s < _shardCount; s++)
+        send(producer, s);
+}
+
+//preconditions: producer < producers(), called only from the thread of the producer.
+//postconditions: done(const reply&) is called on every reply to the producer that arrived, in the
+// order each shard answered. Returns the number of replies.
+template <typename T, typename Table>
+template <typename F>
+size_t PartitionedHash<T, Table>::poll(size_t producer, F done)
+{
+    producer_state& state = _producers[producer];
+    collect(producer);
+    size_t count = state._ready.size();
+    for(size_t i = 0; i < count; i++)
+        done(static_cast<const reply&>(state._ready[i]));
+    state._ready.clear();
+    state._outstanding -= count;
+    return count;
+}
+
+//preconditions: every request of every producer was answered.
+//postconditions: returns the number of records in every shard. The replies made the work of
+// the workers visible, so the tables may be read from the calling thread.
+template <typename T, typename Table>
+size_t PartitionedHash<T, Table>::size() const
+{
+    size_t total = 0;
+    for(size_t s = 0; s < _shardCount; s++)
+        total += _shards[s]._table.size();
+    return total;
+}
+
+//preconditions: called only from the thread of the producer.
+//postconditions: the request is in the batch of the shard of its key, the batch is sent once it
+// holds BATCH requests.
+template <typename T, typename Table>
+void PartitionedHash<T, Table>::submit(size_t producer, const request& r)
+{
+    size_t s = shard_of(r.record.key);
+    vector<request>& batch = _producers[producer]._batches[s];
+    batch.push_back(r);
+    _producers[producer]._outstanding++;
+    if(batch.size() >= BATCH)
+        send(producer, s);
+}
+
+//preconditions: called only from the thread of the producer.
+//postconditions: the batch of shard s is pushed to its queue and emptied. While the queue is
+// full, the replies to the producer are collected, so a worker waiting for room to reply can
+// always go on and drain the requests.
+template <typename T, typename Table>
+void PartitionedHash<T, Table>::send(size_t producer, size_t s)
+{
+    vector<request>& batch = _producers[producer]._batches[s];
+    size_t sent = 0;
+    while(sent < batch.size())
+    {
+        size_t n = requests(producer, s).push(batch.data() + sent, batch.size() - sent);
+        sent += n;
+        if(n == 0)
+        {
+            collect(producer);
+            this_thread::yield();
+        }
+    }
+    batch.clear();
+}
+
+//preconditions: called only from the thread of the producer.
+//postconditions: the replies waiting on the queues of every shard are moved to _ready.
+template <typename T, typename Table>
+void PartitionedHash<T, Table>::collect(size_t producer)
+{
+    vector<reply>& ready = _producers[producer]._ready;
+    for(size_t s = 0; s < _shardCount; s++)
+        while(true)
+        {
+            size_t at = ready.size();
+            ready.resize(at + BATCH);
+            size_t n = replies(s, producer).pop(ready.data() + at, BATCH);
+            ready.resize(at + n);
+            if(n < BATCH)
+                break;
+        }
+}
+
+//preconditions: runs on the worker thread of shard s.
+//postconditions: the worker visits every producer in turn. Replies still waiting in the outbox
+// of a producer are pushed first, and only a producer whose outbox is empty gets a batch of its
+// requests popped, applied and answered, so a producer that does not poll never blocks the
+// others. An idle worker yields, and stops once it is idle after the table is destroyed.
+template <typename T, typename Table>
+void PartitionedHash<T, Table>::work(size_t s)
+{
+    shard& owned = _shards[s];
+    request batch[BATCH];
+    while(true)
+    {
+        bool idle = true;
+        for(size_t p = 0; p < _producerCount; p++)
+        {
+            vector<reply>& outbox = owned._outbox[p];
+            if(outbox.empty())
+            {
+                size_t n = requests(p, s).pop(batch, BATCH);
+                for(size_t i = 0; i < n; i++)
+                    outbox.push_back(apply(owned._table, batch[i]));
+                idle = idle && n == 0;
+            }
+
+            if(!outbox.empty())
+            {
+                size_t n = replies(s, p).push(outbox.data(), outbox.size());
+                outbox.erase(outbox.begin(), outbox.begin() + n);
+                idle = idle && n == 0;
+            }
+        }
+
+        if(idle)
+        {
+            if(_stop.load(memory_order_acquire))
+                return;
+            this_thread::yield();
+        }
+    }
+}
+
+//preconditions: runs on the worker thread of the shard that owns the table.
+//postconditions: the request is run on the table and its reply returned.
+template <typename T, typename Table>
+typename PartitionedHash<T, Table>::reply PartitionedHash<T, Table>::apply(Table& table, const request& r)
+{
+    reply answer;
+    answer.tag = r.tag;
+    answer.op = r.op;
+    if(r.op == INSERT)
+        answer.ok = table.insert(r.record);
+    else if(r.op == REMOVE)
+        answer.ok = table.remove(r.record.key);
+    else
+        table.find(r.record.key, answer.ok, answer.record);
+    return answer;
+}
+
+#endif // PARTITIONEDHASH_H
@@ -0,0 +1,438 @@
+#ifndef PERFECTHASH_H
+#define PERFECTHASH_H
+
+#include <cstdlib>
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <cassert>
+#include <vector>
+#include <record.h>
+#include "hash_functions.h"
+
+using namespace std;
+
+//A read-only table over a minimal perfect hash of its keys, built in the style of PTHash. The
+// keys are split into buckets of a few keys each, and every bucket gets a pilot: the first
+// number that sends all of its keys to free slots. The pilots are bit packed at the width of
+// the largest, around 3 to 4 bits per key. A few slots beyond the records are left spare so
+// the last buckets find a pilot quickly, the keys that land on them are remapped to the free
+// slots below. A lookup reads one pilot and one slot of the dense key array, which rejects
+// every key that is not in the table, then the record beside it. Produced by the freeze of the
+// hash tables, insert and remove always fail.
+template <typename T>
+class PerfectHash
+{
+    //note: this typename is different so that the definition and implementation can be seperated.
+    template <typename TT>
+    friend ostream& operator<<(ostream& outs, const PerfectHash<TT>& table);
+
+public:
+    PerfectHash();                                      //an empty table.
+    PerfectHash(const T* records, size_t count);        //the keys of the records must be distinct.
+
+    //big 3
+    ~PerfectHash();
+    PerfectHash<T>& operator=(const PerfectHash<T>& other);
+    PerfectHash(const PerfectHash<T>& other);
+
+    bool insert(const T& entry);                        //always false, the table is read-only.
+    bool remove(int key);                               //always false, the table is read-only.
+    bool is_present(int key) const;                     //returns true if the key exists, otherwise false.
+    void find(int key, bool& found, T& result) const;   //returns found = true, result = record with key if the key exists.
+
+    //preconditions: none
+    //postconditions: returns the number of records.
+    inline size_t size() const
+    {
+        return _size;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of records, every slot is used.
+    inline size_t capacity() const
+    {
+        return _size;
+    }
+
+    //preconditions: none
+    //postconditions: returns the bits of pilots and remapped slots per record.
+    inline double bits_per_key() const
+    {
+        return (_size) ? double(_buckets * _pilotBits + 32 * (_slots - _size)) / double(_size) : 0.0;
+    }
+
+private:
+    static const size_t BUCKET_FACTOR = 5;          //a bucket per log2(n) / 5 keys.
+    static const size_t SPARE = 64;                 //a spare slot per 64 records.
+    static const uint32_t DENSE_KEYS = 2576980377u; //60% of the 32 bit hashes...
+    static const size_t DENSE_BUCKETS = 30;         //...go to the first 30% of the buckets.
+    static const uint32_t MAX_PILOT = 1u << 20;     //past it a bucket gives up and the build reseeds.
+    static const size_t MAX_SEEDS = 16;
+
+    int* _keys;             //the key of every slot, the record with the key is beside it in _records.
+    T* _records;
+    size_t _size;
+    size_t _slots;          //_size plus the spare slots the pilots may pick.
+    size_t _buckets;
+    size_t _dense;          //the first buckets, which hold most of the keys.
+    uint32_t _seed;
+    uint64_t* _pilots;      //_buckets pilots of _pilotBits each.
+    size_t _pilotBits;
+    uint32_t* _remap;       //the free slot below _size of every spare slot a key landed on.
+
+    bool build(const T* records, vector<uint32_t>& pilots, vector<size_t>& slots) const;
+    void copy(const PerfectHash<T>& other);
+
+    //preconditions: none
+    //postconditions: returns the 64 bit hash of the key under the current seed.
+    inline uint64_t key_hash(int key) const
+    {
+        return hash_mix(int(uint32_t(key) ^ _seed));
+    }
+
+    //preconditions: _buckets >= 2
+    //postconditions: returns the bucket of the hash. The skew puts most keys in a few large
+    // buckets, which are placed first while the table is still empty.
+    inline size_t bucket_of(uint64_t h) const
+    {
+        uint32_t high = uint32_t(h >> 32);
+        return (uint32_t(h) < DENSE_KEYS) ? hash_reduce(high, _dense)
+                                          : _dense + hash_reduce(high, _buckets - _dense);
+    }
+
+    //preconditions: _slots > 0
+    //postconditions: returns the slot the pilot sends the hash to, before remapping.
+    inline size_t slot_of(uint64_t h, uint32_t pilot) const
+    {
+        return size_t((h ^ hash_mix(int(pilot))) % _slots);
+    }
+
+    //preconditions: b < _buckets
+    //postconditions: returns the pilot of bucket b.
+    inline uint32_t pilot(size_t b) const
+    {
+        size_t bit = b * _pilotBits;
+        size_t word = bit / 64;
+        size_t shift = bit % 64;
+        uint64_t value = _pilots[word] >> shift;
+        if(shift + _pilotBits > 64)
+            value |= _pilots[word + 1] << (64 - shift);
+        return uint32_t(value & ((uint64_t(1) << _pilotBits) - 1));
+    }
+
+    //preconditions: _size > 0
+    //postconditions: returns the slot of the key, where it is if it is in the table.
+    inline size_t position(int key) const
+    {
+        uint64_t h = key_hash(key);
+        size_t slot = slot_of(h, pilot(bucket_of(h)));
+        return (slot < _size) ? slot : _remap[slot - _size];
+    }
+};
+
+//preconditions: none
+//postconditions: print every slot and its record.
+template <typename TT>
+ostream& operator<<(ostream& outs, const PerfectHash<TT>& table)
+{
+    for(size_t i = 0; i < table._size; i++)
+        outs << "[" << setfill('0') << setw(3) << i << "] "
+             << setfill('0') << setw(5) << table._keys[i] << ":"
+             << setfill('0') << setw(4) << table._records[i].data << endl;
+    outs.fill(' ');
+    return outs;
+}
+
+//preconditions: none
+//postconditions: constructs an empty table, every lookup fails.
+template <typename T>
+PerfectHash<T>::PerfectHash()
+{
+    _keys = nullptr;
+    _records = nullptr;
+    _size = 0;
+    _slots = 0;
+    _buckets = 0;
+    _dense = 0;
+    _seed = 0;
+    _pilots = nullptr;
+    _pilotBits = 0;
+    _remap = nullptr;
+}
+
+//preconditions: the keys of records[0, count) are distinct.
+//postconditions: the table holds the records, in the slot the minimal perfect hash gives each key.
+// A seed whose keys cannot all be placed within MAX_PILOT tries is replaced by the next.
+template <typename T>
+PerfectHash<T>::PerfectHash(const T* records, size_t count)
+{
+    _size = count;
+    _slots = count + count / SPARE + 1;
+    _keys = nullptr;
+    _records = nullptr;
+    _pilots = nullptr;
+    _pilotBits = 0;
+    _remap = nullptr;
+    _seed = 0;
+
+    size_t log2 = 1;
+    while((size_t(1) << log2) < count)
+        log2++;
+    _buckets = (BUCKET_FACTOR * count + log2 - 1) / log2;
+    if(_buckets < 2)
+        _buckets = 2;
+    _dense = _buckets * DENSE_BUCKETS / 100;
+    if(_dense < 1)
+        _dense = 1;
+
+    if(count == 0)
+        return;
+
+    vector<uint32_t> pilots(_buckets);
+    vector<size_t> slots(count);
+    size_t seeds = 0;
+    while(!build(records, pilots, slots))
+    {
+        seeds++;
+        assert(seeds < MAX_SEEDS && "the keys of a perfect hash must be distinct");
+        _seed += 0x9E3779B9u;
+    }
+
+    //pack the pilots at the width of the largest.
+    uint32_t largest = 1;
+    for(size_t b = 0; b < _buckets; b++)
+        if(pilots[b] > largest)
+            largest = pilots[b];
+    while((uint64_t(1) << _pilotBits) <= largest)
+        _pilotBits++;
+
+    size_t words = (_buckets * _pilotBits + 63) / 64;
+    _pilots = new uint64_t[words];
+    for(size_t w = 0; w < words; w++)
+        _pilots[w] = 0;
+    for(size_t b = 0; b < _buckets; b++)
+    {
+        size_t bit = b * _pilotBits;
+        _pilots[bit / 64] |= uint64_t(pilots[b]) << (bit % 64);
+        if(bit % 64 + _pilotBits > 64)
+            _pilots[bit / 64 + 1] |= uint64_t(pilots[b]) >> (64 - bit % 64);
+    }
+
+    //the spare slots that were taken are remapped, in order, to the slots below _size left free.
+    vector<bool> taken(_slots, false);
+    for(size_t i = 0; i < count; i++)
+        taken[slots[i]] = true;
+    _remap = new uint32_t[_slots - _size];
+    size_t hole = 0;
+    for(size_t s = _size; s < _slots; s++)
+    {
+        _remap[s - _size] = 0;
+        if(!taken[s])
+            continue;
+        while(taken[hole])
+            hole++;
+        _remap[s - _size] = uint32_t(hole++);
+    }
+
+    _keys = new int[_size];
+    _records = new T[_size];
+    for(size_t i = 0; i < count; i++)
+    {
+        size_t slot = (slots[i] < _size) ? slots[i] : _remap[slots[i] - _size];
+        _keys[slot] = records[i].key;
+        _records[slot] = records[i];
+    }
+}
+
+//preconditions: none
+//postconditions: deallocate dynamic memory.
+template <typename T>
+PerfectHash<T>::~PerfectHash()
+{
+    delete [] _keys;
+    delete [] _records;
+    delete [] _pilots;
+    delete [] _remap;
+}
+
+//preconditions: none
+//postconditions: deallocate this table and reassign it the contents of other.
+template <typename T>
+PerfectHash<T>& PerfectHash<T>::operator=(const PerfectHash<T>& other)
+{
+    if(&other == this)
+        return *this;
+
+    delete [] _keys;
+    delete [] _records;
+    delete [] _pilots;
+    delete [] _remap;
+    copy(other);
+    return *this;
+}
+
+//preconditions: none
+//postconditions: construct this table with the contents of other.
+template <typename T>
+PerfectHash<T>::PerfectHash(const PerfectHash<T>& other)
+{
+    copy(other);
+}
+
+//preconditions: none
+//postconditions: returns false, a perfect hash cannot take a new key.
+template <typename T>
+bool PerfectHash<T>::insert(const T&)
+{
+    return false;
+}
+
+//preconditions: none
+//postconditions: returns false, a perfect hash cannot lose a key.
+template <typename T>
+bool PerfectHash<T>::remove(int)
+{
+    return false;
+}
+
+//preconditions: none
+//postconditions: if the record with the recieved key exists in the table,
+// returns true, otherwise returns false.
+template <typename T>
+bool PerfectHash<T>::is_present(int key) const
+{
+    return _size && _keys[position(key)] == key;
+}
+
+//preconditions: none
+//postconditions: if the record with the recieved key exists in the table,
+// found will be true and the record will be returned by ref.
+template <typename T>
+void PerfectHash<T>::find(int key, bool& found, T& result) const
+{
+    found = false;
+    if(!_size)
+        return;
+
+    size_t slot = position(key);
+    if(_keys[slot] == key)
+    {
+        found = true;
+        result = _records[slot];
+    }
+}
+
+//preconditions: _size, _slots, _buckets, _dense and _seed are set.
+//postconditions: the buckets are placed from the largest down, each with the first pilot that
+// sends all of its keys to distinct free slots in [0, _slots). The pilot of every bucket and the
+// slot of every record are returned by ref, an empty bucket keeps pilot 0 whatever an earlier
+// attempt left in pilots. Returns false if a bucket needed MAX_PILOT tries.
+template <typename T>
+bool PerfectHash<T>::build(const T* records, vector<uint32_t>& pilots, vector<size_t>& slots) const
+{
+    vector<uint64_t> hashes(_size);
+    vector<size_t> start(_buckets + 1, 0);
+    for(size_t i = 0; i < _size; i++)
+    {
+        hashes[i] = key_hash(records[i].key);
+        start[bucket_of(hashes[i]) + 1]++;
+    }
+
+    //group the records by bucket, then order the buckets by size, largest first.
+    size_t largest = 0;
+    for(size_t b = 0; b < _buckets; b++)
+    {
+        if(start[b + 1] > largest)
+            largest = start[b + 1];
+        start[b + 1] += start[b];
+    }
+    vector<size_t> members(_size);
+    vector<size_t> fill(start.begin(), start.end() - 1);
+    for(size_t i = 0; i < _size; i++)
+        members[fill[bucket_of(hashes[i])]++] = i;
+
+    vector<size_t> bySize(largest + 2, 0);
+    for(size_t b = 0; b < _buckets; b++)
+        bySize[largest - (start[b + 1] - start[b]) + 1]++;
+    for(size_t s = 0; s <= largest; s++)
+        bySize[s + 1] += bySize[s];
+    vector<size_t> order(_buckets);
+    for(size_t b = 0; b < _buckets; b++)
+        order[bySize[largest - (start[b + 1] - start[b])]++] = b;
+
+    pilots.assign(_buckets, 0);
+    vector<bool> taken(_slots, false);
+    vector<size_t> tried;
+    for(size_t k = 0; k < _buckets; k++)
+    {
+        size_t b = order[k];
+        if(start[b] == start[b + 1])
+            break;
+
+        uint32_t p = 0;
+        for(; p < MAX_PILOT; p++)
+        {
+            tried.clear();
+            bool fits = true;
+            for(size_t m = start[b]; m < start[b + 1] && fits; m++)
+            {
+                size_t slot = slot_of(hashes[members[m]], p);
+                fits = !taken[slot];
+                for(size_t t = 0; t < tried.size() && fits; t++)
+                    fits = (tried[t] != slot);
+                tried.push_back(slot);
+            }
+            if(fits)
+                break;
+        }
+        if(p == MAX_PILOT)
+            return false;
+
+        pilots[b] = p;
+        for(size_t m = start[b]; m < start[b + 1]; m++)
+        {
+            slots[members[m]] = tried[m - start[b]];
+            taken[tried[m - start[b]]] = true;
+        }
+    }
+    return true;
+}
+
+//preconditions: the arrays of this table are not allocated.
+//postconditions: the records, pilots and remapped slots of other are copied.
+template <typename T>
+void PerfectHash<T>::copy(const PerfectHash<T>& other)
+{
+    _size = other._size;
+    _slots = other._slots;
+    _buckets = other._buckets;
+    _dense = other._dense;
+    _seed = other._seed;
+    _pilotBits = other._pilotBits;
+    _keys = nullptr;
+    _records = nullptr;
+    _pilots = nullptr;
+    _remap = nullptr;
+    if(!_size)
+        return;
+
+    _keys = new int[_size];
+    _records = new T[_size];
+    for(size_t i = 0; i < _size; i++)
+    {
+        _keys[i] = other._keys[i];
+        _records[i] = other._records[i];
+    }
+
+    size_t words = (_buckets * _pilotBits + 63) / 64;
+    _pilots = new uint64_t[words];
+    for(size_t w = 0; w < words; w++)
+        _pilots[w] = other._pilots[w];
+
+    _remap = new uint32_t[_slots - _size];
+    for(size_t s = 0; s < _slots - _size; s++)
+        _remap[s] = other._remap[s];
+}
+
+#endif // PERFECTHASH_H
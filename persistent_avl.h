@@ -0,0 +1,137 @@
+#ifndef PERSISTENT_AVL_H
+#define PERSISTENT_AVL_H
+
+#include <memory>
+#include <mutex>
+#include "bst_functions.h"
+
+using namespace std;
+
+//An AVL tree whose versions are immutable. insert and erase copy only the nodes on the
+// modified path (tree_persistent_insert / tree_persistent_erase) and publish the new root
+// atomically, so readers take an O(1) snapshot and keep reading a consistent version while
+// writers go on. Writers are serialized by a mutex, readers never take it. Nodes are
+// reference counted and freed when the last version holding them is released.
+template <typename T>
+class PersistentAVL
+{
+public:
+    typedef typename persistent_node<T>::ptr node_ptr;
+
+    //A point-in-time view of the tree, it holds its root so none of its nodes are freed.
+    class Snapshot
+    {
+    public:
+        Snapshot(const node_ptr& root = node_ptr()): _root(root) {}
+
+        //preconditions: none
+        //postconditions: returns the item equal to target in this version, or null.
+        const T* search(const T& target) const
+        {
+            return tree_persistent_search(_root.get(), target);
+        }
+
+        //preconditions: none
+        //postconditions: visit(item) is called on the items of this version in [lo, hi] in order.
+        template <typename Visitor>
+        void range(const T& lo, const T& hi, Visitor visit) const
+        {
+            tree_persistent_range(_root.get(), lo, hi, visit);
+        }
+
+        //preconditions: none
+        //postconditions: returns the number of items in this version.
+        size_t size() const
+        {
+            return (_root) ? _root->_size : 0;
+        }
+
+    private:
+        node_ptr _root;
+    };
+
+    PersistentAVL();
+    PersistentAVL(const PersistentAVL<T>& other);               //O(1), every node is shared.
+    PersistentAVL<T>& operator=(const PersistentAVL<T>& rhs);   //O(1), every node is shared.
+
+    bool insert(const T& insert_me);    //publish a version holding the value, false if it is a duplicate.
+    bool erase(const T& target);        //publish a version without the value, false if it is not found.
+    Snapshot snapshot() const;          //the current version, O(1).
+
+    //preconditions: none
+    //postconditions: returns the number of items in the current version.
+    size_t size() const
+    {
+        return snapshot().size();
+    }
+
+private:
+    node_ptr _root;         //the current version, only read and written with atomic_load / atomic_store.
+    mutable mutex _writer;  //held by insert and erase.
+};
+
+//preconditions: none
+//postconditions: a new, empty tree is constructed.
+template <typename T>
+PersistentAVL<T>::PersistentAVL()
+{
+}
+
+//preconditions: none
+//postconditions: this tree starts from the current version of other, no node is copied.
+template <typename T>
+PersistentAVL<T>::PersistentAVL(const PersistentAVL<T>& other)
+{
+    atomic_store(&_root, atomic_load(&other._root));
+}
+
+//preconditions: none
+//postconditions: the current version of rhs is published as the current version of this tree.
+template <typename T>
+PersistentAVL<T>& PersistentAVL<T>::operator=(const PersistentAVL<T>& rhs)
+{
+    if(&rhs == this)
+        return *this;
+
+    lock_guard<mutex> lock(_writer);
+    atomic_store(&_root, atomic_load(&rhs._root));
+    return *this;
+}
+
+//preconditions: none
+//postconditions: a new version holding insert_me is built by path copying and published,
+// returns false (and publishes nothing) if the value is already in the tree.
+template <typename T>
+bool PersistentAVL<T>::insert(const T& insert_me)
+{
+    lock_guard<mutex> lock(_writer);
+    bool inserted = false;
+    node_ptr root = tree_persistent_insert(atomic_load(&_root), insert_me, inserted);
+    if(inserted)
+        atomic_store(&_root, root);
+    return inserted;
+}
+
+//preconditions: none
+//postconditions: a new version without target is built by path copying and published,
+// returns false (and publishes nothing) if the value is not in the tree.
+template <typename T>
+bool PersistentAVL<T>::erase(const T& target)
+{
+    lock_guard<mutex> lock(_writer);
+    bool erased = false;
+    node_ptr root = tree_persistent_erase(atomic_load(&_root), target, erased);
+    if(erased)
+        atomic_store(&_root, root);
+    return erased;
+}
+
+//preconditions: none
+//postconditions: returns a snapshot of the current version, it is unaffected by later writes.
+template <typename T>
+typename PersistentAVL<T>::Snapshot PersistentAVL<T>::snapshot() const
+{
+    return Snapshot(atomic_load(&_root));
+}
+
+#endif // PERSISTENT_AVL_H
@@ -0,0 +1,13 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+//hint the cache to fetch an address that will be read soon, a no-op where it is not supported.
+// Issuing the prefetches of several independent addresses before reading any of them lets
+// their cache misses overlap instead of being paid one after another.
+#if defined(__GNUC__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address)
+#endif
+
+#endif // PREFETCH_H
@@ -0,0 +1,84 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <cstdlib>
+#include <cassert>
+#include <atomic>
+
+using namespace std;
+
+//A bounded lock-free queue between exactly one producer thread and one consumer thread. The
+// producer owns the tail and the consumer the head, each index is only stored by its owner with
+// a release store and read by the other side with an acquire load, so there is no read-modify-write
+// and no lock. Each side keeps a cached copy of the other index and only reloads it when the
+// queue looks full (or empty), and pushing or popping a batch publishes the whole batch with one
+// store, so the shared cache lines move once per batch rather than once per item.
+template <typename T, size_t CAPACITY = 1024>
+class SpscQueue
+{
+public:
+    SpscQueue(): _head(0), _cachedTail(0), _tail(0), _cachedHead(0) {}
+
+    //the items live inside the queue.
+    SpscQueue(const SpscQueue<T, CAPACITY>&) = delete;
+    SpscQueue<T, CAPACITY>& operator=(const SpscQueue<T, CAPACITY>&) = delete;
+
+    size_t push(const T* items, size_t count);      //producer only: append up to count items, returns how many.
+    size_t pop(T* out, size_t count);               //consumer only: remove up to count items, returns how many.
+
+private:
+    static_assert(CAPACITY && !(CAPACITY & (CAPACITY - 1)), "SpscQueue capacity must be a power of two");
+    static const size_t MASK = CAPACITY - 1;
+
+    alignas(64) atomic<size_t> _head;   //the next item to pop, stored by the consumer.
+    size_t _cachedTail;                 //the consumer's copy of _tail.
+    alignas(64) atomic<size_t> _tail;   //the next free slot, stored by the producer.
+    size_t _cachedHead;                 //the producer's copy of _head.
+    alignas(64) T _items[CAPACITY];
+};
+
+//preconditions: only one thread ever pushes.
+//postconditions: as many of the items as there is room for are copied to the queue and made
+// visible to the consumer with a single release store, their number is returned.
+template <typename T, size_t CAPACITY>
+size_t SpscQueue<T, CAPACITY>::push(const T* items, size_t count)
+{
+    size_t tail = _tail.load(memory_order_relaxed);
+    size_t room = CAPACITY - (tail - _cachedHead);
+    if(room < count)
+    {
+        _cachedHead = _head.load(memory_order_acquire);
+        room = CAPACITY - (tail - _cachedHead);
+    }
+
+    size_t n = (count < room) ? count : room;
+    for(size_t i = 0; i < n; i++)
+        _items[(tail + i) & MASK] = items[i];
+    if(n)
+        _tail.store(tail + n, memory_order_release);
+    return n;
+}
+
+//preconditions: only one thread ever pops, out has room for count items.
+//postconditions: up to count items are moved to out in the order they were pushed and their
+// slots are handed back to the producer with a single release store, their number is returned.
+template <typename T, size_t CAPACITY>
+size_t SpscQueue<T, CAPACITY>::pop(T* out, size_t count)
+{
+    size_t head = _head.load(memory_order_relaxed);
+    size_t ready = _cachedTail - head;
+    if(ready < count)
+    {
+        _cachedTail = _tail.load(memory_order_acquire);
+        ready = _cachedTail - head;
+    }
+
+    size_t n = (count < ready) ? count : ready;
+    for(size_t i = 0; i < n; i++)
+        out[i] = _items[(head + i) & MASK];
+    if(n)
+        _head.store(head + n, memory_order_release);
+    return n;
+}
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,142 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <cstdlib>
+#include <cstdint>
+#include <cassert>
+#include <vector>
+
+using namespace std;
+
+//A hierarchical timing wheel of key timers. Level l has SLOTS buckets that are SLOTS^l ticks wide,
+// a timer is filed in the level whose range covers the time left and in the bucket of its expiry.
+// Every tick expires the level 0 bucket of the new time, and whenever a level wraps around, the
+// next bucket of the level above is emptied into the levels below it. A timer is moved at most
+// once per level, so advancing costs O(1) amortized per tick and timer instead of a scan of the
+// table. Timers are never cancelled: the owner checks that a due key still carries the expiry.
+class TimingWheel
+{
+public:
+    TimingWheel(uint64_t now = 0);                      //an empty wheel at time now.
+
+    void schedule(int key, uint64_t expires);           //file a timer, a time already past is due next tick.
+
+    //preconditions: now >= this->now(), expire(int key, uint64_t expires) must not schedule.
+    //postconditions: the wheel moves one tick at a time to now and calls expire for every timer
+    // that comes due, in order of expiry. An empty wheel jumps straight to now.
+    template <typename F>
+    void advance(uint64_t now, F expire);
+
+    //preconditions: none
+    //postconditions: returns the current time of the wheel.
+    inline uint64_t now() const
+    {
+        return _now;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of timers that have not come due.
+    inline size_t size() const
+    {
+        return _size;
+    }
+
+private:
+    struct timer
+    {
+        int _key;
+        uint64_t _expires;
+    };
+
+    static const size_t LEVEL_BITS = 6;
+    static const size_t SLOTS = size_t(1) << LEVEL_BITS;
+    static const size_t LEVELS = 4;                     //2^24 ticks ahead, later timers are refiled.
+
+    vector<timer> _buckets[LEVELS][SLOTS];
+    uint64_t _now;
+    size_t _size;
+
+    void file(const timer& t);                          //place a timer by the time it has left.
+
+    //preconditions: level < LEVELS
+    //postconditions: returns the bucket of the time in the level.
+    inline static size_t bucket(uint64_t time, size_t level)
+    {
+        return size_t(time >> (level * LEVEL_BITS)) & (SLOTS - 1);
+    }
+};
+
+//preconditions: none
+//postconditions: every bucket is empty and the time is now.
+inline TimingWheel::TimingWheel(uint64_t now)
+{
+    _now = now;
+    _size = 0;
+}
+
+//preconditions: none
+//postconditions: the timer is filed, it comes due when the wheel reaches expires, or on the next
+// tick if expires is not after now().
+inline void TimingWheel::schedule(int key, uint64_t expires)
+{
+    timer t;
+    t._key = key;
+    t._expires = (expires > _now) ? expires : _now + 1;
+    file(t);
+    _size++;
+}
+
+template <typename F>
+void TimingWheel::advance(uint64_t now, F expire)
+{
+    assert(now >= _now);
+    if(_size == 0)
+    {
+        _now = now;
+        return;
+    }
+
+    while(_now < now && _size > 0)
+    {
+        _now++;
+
+        //a level wraps when the digits below it are all zero, the highest level cascades first
+        // so its timers can land in a bucket of a lower level that cascades this same tick.
+        size_t wrapped = 0;
+        while(wrapped + 1 < LEVELS && bucket(_now, wrapped) == 0)
+            wrapped++;
+        for(size_t level = wrapped; level > 0; level--)
+        {
+            vector<timer> moving;
+            moving.swap(_buckets[level][bucket(_now, level)]);
+            for(size_t i = 0; i < moving.size(); i++)
+                file(moving[i]);
+        }
+
+        vector<timer>& due = _buckets[0][bucket(_now, 0)];
+        for(size_t i = 0; i < due.size(); i++)
+            expire(due[i]._key, due[i]._expires);
+        _size -= due.size();
+        due.clear();
+    }
+    _now = now;
+}
+
+//preconditions: t._expires > _now
+//postconditions: the timer is in the lowest level whose range covers the ticks it has left, in the
+// bucket of its expiry. A timer beyond the top level waits in the top bucket that is emptied last
+// and is filed again from there.
+inline void TimingWheel::file(const timer& t)
+{
+    uint64_t left = t._expires - _now;
+    for(size_t level = 0; level < LEVELS; level++)
+        if(left < (uint64_t(1) << ((level + 1) * LEVEL_BITS)))
+        {
+            _buckets[level][bucket(t._expires, level)].push_back(t);
+            return;
+        }
+
+    _buckets[LEVELS - 1][bucket(_now, LEVELS - 1)].push_back(t);
+}
+
+#endif // TIMING_WHEEL_H
@@ -0,0 +1,300 @@
+#ifndef WRITE_AHEAD_LOG_H
+#define WRITE_AHEAD_LOG_H
+
+#include <cstdlib>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+//preconditions: none
+//postconditions: returns the 32 bit FNV-1a hash of the bytes, the checksum of a log frame.
+inline uint32_t log_checksum(const char* bytes, size_t length)
+{
+    uint32_t h = 2166136261u;
+    for(size_t i = 0; i < length; i++)
+        h = (h ^ uint8_t(bytes[i])) * 16777619u;
+    return h;
+}
+
+//preconditions: none
+//postconditions: the failed call, the file and the error are printed and the process is aborted.
+// Used where the disk refused a write or a sync that callers were promised, the state on disk is
+// unknown from then on and going on would report data as durable that is not.
+inline void io_failure(const char* call, const string& path)
+{
+    cerr << "Error: " << call << " of " << path << " failed: " << strerror(errno) << endl;
+    abort();
+}
+
+//preconditions: fd is open for writing.
+//postconditions: the bytes are written at the file offset (the end with O_APPEND), retrying short
+// and interrupted writes. Returns false, with errno set, if a write failed.
+inline bool write_fully(int fd, const char* bytes, size_t length)
+{
+    while(length > 0)
+    {
+        ssize_t written = ::write(fd, bytes, length);
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written <= 0)
+            return false;
+        bytes += written;
+        length -= size_t(written);
+    }
+    return true;
+}
+
+//preconditions: fd is open for reading.
+//postconditions: length bytes are read from offset, retrying short and interrupted reads. Returns
+// false, with errno set (0 at the end of the file), if the file ended or a read failed first.
+inline bool read_fully(int fd, char* bytes, size_t length, off_t offset)
+{
+    while(length > 0)
+    {
+        ssize_t count = ::pread(fd, bytes, length, offset);
+        if(count < 0 && errno == EINTR)
+            continue;
+        if(count <= 0)
+        {
+            if(count == 0)
+                errno = 0;
+            return false;
+        }
+        bytes += count;
+        length -= size_t(count);
+        offset += off_t(count);
+    }
+    return true;
+}
+
+//preconditions: fd is open.
+//postconditions: the file is synced, only its data and size if dataOnly, retrying interrupted
+// calls. Returns false, with errno set, if the sync failed.
+inline bool sync_fully(int fd, bool dataOnly)
+{
+    int result;
+    do
+        result = dataOnly ? ::fdatasync(fd) : ::fsync(fd);
+    while(result != 0 && errno == EINTR);
+    return result == 0;
+}
+
+//An append-only log file of frames (length, checksum, bytes) with group commit. Appending only
+// copies the frame to a buffer and returns its log sequence number, the log offset just past
+// it. A commit waits until its frame is on disk: the first waiter becomes the leader, writes the
+// whole buffer and syncs the file once, and every frame appended meanwhile waits for the next
+// leader, so concurrent callers share the cost of one fsync. Replay stops at the first frame
+// that is torn or corrupt, the tail a crash left behind, and cuts it off. A failed open, write,
+// read, sync or truncate aborts through io_failure, a commit never returns unless its frame
+// is on disk.
+class WriteAheadLog
+{
+public:
+    WriteAheadLog(const string& path);                  //the file is created if missing, never truncated.
+    ~WriteAheadLog();                                   //commit everything appended and close the file.
+
+    //the log owns its file.
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    uint64_t append(const void* bytes, uint32_t length);   //buffer a frame, returns its sequence number.
+    void commit(uint64_t lsn);                              //wait until every frame up to lsn is on disk.
+    void truncate();                                        //drop every frame, the state is saved elsewhere.
+    template <typename F>
+    size_t replay(F visit);                                 //visit(bytes, length) every intact frame in order.
+
+    //preconditions: none
+    //postconditions: returns the number of bytes in the file.
+    inline uint64_t bytes() const
+    {
+        lock_guard<mutex> guard(_mutex);
+        return _fileBytes;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of frames appended since the log was opened.
+    inline size_t appends() const
+    {
+        lock_guard<mutex> guard(_mutex);
+        return _appends;
+    }
+
+    //preconditions: none
+    //postconditions: returns the number of times the file was synced since the log was opened.
+    inline size_t syncs() const
+    {
+        lock_guard<mutex> guard(_mutex);
+        return _syncs;
+    }
+
+private:
+    static const uint32_t FRAME_HEADER = 8;     //the length and the checksum.
+
+    int _fd;
+    string _path;
+    mutable mutex _mutex;
+    condition_variable _synced;
+    vector<char> _buffer;       //frames appended and not written yet.
+    uint64_t _appended;         //the sequence number of the last frame appended.
+    uint64_t _durable;          //every frame up to this sequence number is on disk.
+    bool _syncing;              //a leader is writing and syncing outside the lock.
+    uint64_t _fileBytes;
+    size_t _appends;
+    size_t _syncs;
+};
+
+//preconditions: the file can be created or opened, the process aborts otherwise.
+//postconditions: the file is opened for appending, its frames are kept for replay.
+inline WriteAheadLog::WriteAheadLog(const string& path): _path(path)
+{
+    do
+        _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    while(_fd < 0 && errno == EINTR);
+    if(_fd < 0)
+        io_failure("open", _path);
+    off_t end = ::lseek(_fd, 0, SEEK_END);
+    if(end < 0)
+        io_failure("lseek", _path);
+    _fileBytes = uint64_t(end);
+    _appended = 0;
+    _durable = 0;
+    _syncing = false;
+    _appends = 0;
+    _syncs = 0;
+}
+
+//preconditions: no commit is waiting.
+//postconditions: the frames still buffered are committed, the file is closed.
+inline WriteAheadLog::~WriteAheadLog()
+{
+    commit(_appended);
+    ::close(_fd);
+}
+
+//preconditions: none
+//postconditions: the frame is added to the buffer, it reaches the disk with the next commit of
+// any caller. Returns its sequence number, frames are numbered in the order they are appended.
+inline uint64_t WriteAheadLog::append(const void* bytes, uint32_t length)
+{
+    uint32_t checksum = log_checksum(static_cast<const char*>(bytes), length);
+
+    lock_guard<mutex> guard(_mutex);
+    size_t at = _buffer.size();
+    _buffer.resize(at + FRAME_HEADER + length);
+    memcpy(&_buffer[at], &length, 4);
+    memcpy(&_buffer[at + 4], &checksum, 4);
+    memcpy(&_buffer[at + FRAME_HEADER], bytes, length);
+    _appends++;
+    return _appended += FRAME_HEADER + length;
+}
+
+//preconditions: lsn was returned by append.
+//postconditions: returns once the frame numbered lsn and every frame before it are on disk. A
+// caller that finds no leader becomes one: it takes the whole buffer, writes and syncs it
+// without holding the lock, then wakes every caller its sync covered. A failed write or sync
+// aborts, the frames are never counted as durable.
+inline void WriteAheadLog::commit(uint64_t lsn)
+{
+    unique_lock<mutex> lock(_mutex);
+    while(_durable < lsn)
+    {
+        if(_syncing)
+        {
+            _synced.wait(lock);
+            continue;
+        }
+
+        _syncing = true;
+        vector<char> batch;
+        batch.swap(_buffer);
+        uint64_t target = _appended;
+        lock.unlock();
+
+        if(!write_fully(_fd, batch.data(), batch.size()))
+            io_failure("write", _path);
+        if(!sync_fully(_fd, true))
+            io_failure("fdatasync", _path);
+
+        lock.lock();
+        _fileBytes += batch.size();
+        _durable = target;
+        _syncing = false;
+        _syncs++;
+        _synced.notify_all();
+    }
+}
+
+//preconditions: every frame appended is saved by the owner of the log, no frame is appended
+// until truncate returns.
+//postconditions: the buffer is dropped and the file is cut to zero bytes. The frames waiting in
+// a commit count as durable, the state they describe was saved.
+inline void WriteAheadLog::truncate()
+{
+    unique_lock<mutex> lock(_mutex);
+    while(_syncing)
+        _synced.wait(lock);
+
+    _buffer.clear();
+    if(::ftruncate(_fd, 0) != 0)
+        io_failure("ftruncate", _path);
+    if(!sync_fully(_fd, true))
+        io_failure("fdatasync", _path);
+    _fileBytes = 0;
+    _durable = _appended;
+    _synced.notify_all();
+}
+
+//preconditions: nothing was appended yet.
+//postconditions: visit(const char* bytes, uint32_t length) is called on every frame of the file
+// in order, up to the first frame that is cut short or fails its checksum. The file is cut at
+// that frame, so later appends follow the last intact one. Returns the number of frames visited.
+// A failed read aborts rather than cut intact frames off.
+template <typename F>
+size_t WriteAheadLog::replay(F visit)
+{
+    lock_guard<mutex> guard(_mutex);
+    assert(_appended == 0);
+
+    vector<char> file(_fileBytes);
+    if(!read_fully(_fd, file.data(), file.size(), 0))
+        io_failure("read", _path);
+    size_t read = file.size();
+
+    size_t at = 0;
+    size_t frames = 0;
+    while(at + FRAME_HEADER <= read)
+    {
+        uint32_t length, checksum;
+        memcpy(&length, &file[at], 4);
+        memcpy(&checksum, &file[at + 4], 4);
+        if(length > read - at - FRAME_HEADER
+           || log_checksum(&file[at + FRAME_HEADER], length) != checksum)
+            break;
+
+        visit(static_cast<const char*>(&file[at + FRAME_HEADER]), length);
+        at += FRAME_HEADER + length;
+        frames++;
+    }
+
+    if(at < _fileBytes)
+    {
+        if(::ftruncate(_fd, off_t(at)) != 0)
+            io_failure("ftruncate", _path);
+        if(!sync_fully(_fd, true))
+            io_failure("fdatasync", _path);
+        _fileBytes = at;
+    }
+    return frames;
+}
+
+#endif // WRITE_AHEAD_LOG_H